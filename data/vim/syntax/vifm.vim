@@ -107,12 +107,14 @@ syntax case match
 
 " Options
 syntax keyword vifmOption contained aproposprg autochpos cdpath cd classify
-		\ columns co confirm cf cpoptions cpo dotdirs fastrun fillchars fcs findprg
-		\ followlinks fusehome gdefault grepprg history hi hlsearch hls iec
-		\ ignorecase ic incsearch is laststatus lines locateprg ls lsview number nu
+		\ columns co confirm cf cpoptions cpo dirsizecache dotdirs fastrun
+		\ fillchars fcs findprg followlinks fusehome gdefault grepprg history hi
+		\ hlsearch hls iec ignorecase ic incsearch is laststatus lines locateprg ls
+		\ lsview number nu
 		\ numberwidth nuw relativenumber rnu rulerformat ruf runexec scrollbind scb
 		\ scrolloff so sort sortorder shell sh shortmess shm slowfs smartcase scs
-		\ sortnumbers statusline stl syscalls tabstop timefmt timeoutlen trash
+		\ sortnumbers statusline stl statworkers syscalls tabstop timefmt
+		\ timeoutlen trash trashrate
 		\ trashdir ts tuioptions to undolevels ul vicmd viewcolumns vifminfo vimhelp
 		\ vixcmd wildmenu wmnu wrap wrapscan ws
 
@@ -55,6 +55,9 @@
 /* Size of error message reading buffer. */
 #define ERR_MSG_LEN 1025
 
+/* How often paused tasks check whether they were resumed (in milliseconds). */
+#define PAUSE_POLL_INTERVAL 100
+
 /* Value of job communication mean for internal jobs. */
 #ifndef _WIN32
 #define NO_JOB_ID (-1)
@@ -662,6 +665,51 @@ inner_bg_next(void)
 	}
 }
 
+job_t *
+bg_get_current_job(void)
+{
+	pthread_once(&current_job_once, &make_current_job_key);
+	return pthread_getspecific(current_job);
+}
+
+void
+bg_set_current_job(job_t *job)
+{
+	set_current_job(job);
+}
+
+void
+bg_enable_pausing(void)
+{
+	job_t *const job = bg_get_current_job();
+	if(job != NULL)
+	{
+		job->can_pause = 1;
+	}
+}
+
+void
+bg_wait_while_paused(void)
+{
+	const job_t *const job = bg_get_current_job();
+	while(job != NULL && job->paused)
+	{
+		sleep_ms(PAUSE_POLL_INTERVAL);
+	}
+}
+
+int
+bg_job_toggle_pause(job_t *job)
+{
+	if(!job->can_pause)
+	{
+		return 1;
+	}
+
+	job->paused = !job->paused;
+	return 0;
+}
+
 int
 bg_execute(const char desc[], int total, int important, bg_task_func task_func,
 		void *args)
@@ -728,6 +776,8 @@ add_background_job(pid_t pid, const char cmd[], HANDLE hprocess, BgJobType type)
 
 	new->total = 0;
 	new->done = 0;
+	new->can_pause = 0;
+	new->paused = 0;
 
 	jobs = new;
 	return new;
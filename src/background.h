@@ -55,6 +55,8 @@ typedef struct job_t
 	/* For background operations and tasks. */
 	int total;
 	int done;
+	int can_pause; /* Whether the task checks paused flag. */
+	int paused;    /* Whether the task should suspend its work. */
 
 #ifndef _WIN32
 	int fd;
@@ -97,6 +99,25 @@ void check_background_jobs(void);
 
 void inner_bg_next(void);
 
+/* Retrieves background job of the calling thread.  Returns NULL if the thread
+ * doesn't belong to any job. */
+job_t * bg_get_current_job(void);
+
+/* Makes the calling thread (e.g. a helper thread started by a background task)
+ * part of the job, so that inner_bg_next() can be used in it. */
+void bg_set_current_job(job_t *job);
+
+/* Marks job of the calling thread as the one that can be paused, which means
+ * that it calls bg_wait_while_paused() periodically. */
+void bg_enable_pausing(void);
+
+/* Blocks the calling thread while its job is paused. */
+void bg_wait_while_paused(void);
+
+/* Pauses running job or resumes paused one.  Returns zero on success and
+ * non-zero if the job doesn't support pausing. */
+int bg_job_toggle_pause(job_t *job);
+
 /* Start new background task, executed in a separate thread.  Returns zero on
  * success, otherwise non-zero is returned. */
 int bg_execute(const char desc[], int total, int important,
@@ -130,6 +130,7 @@ init_config(void)
 	cfg.vi_x_command = strdup("");
 	cfg.vi_x_cmd_bg = 0;
 	cfg.use_trash = 1;
+	cfg.trash_rate = 0;
 
 	{
 		char fuse_home[PATH_MAX];
@@ -150,6 +151,8 @@ init_config(void)
 	cfg.timeout_len = 1000;
 	cfg.scroll_off = 0;
 	cfg.gdefault = 0;
+	cfg.dir_size_cache = 10000;
+	cfg.stat_workers = 4;
 #ifndef _WIN32
 	cfg.slow_fs_list = strdup("");
 #endif
@@ -58,6 +58,9 @@ typedef struct config_t
 	char *vi_x_command;
 	int vi_x_cmd_bg;
 	int use_trash;
+	/* Maximum number of files removed per second on emptying trash, zero means
+	 * no limit. */
+	int trash_rate;
 
 	/* Whether support of terminal multiplexers is enabled. */
 	int use_term_multiplexer;
@@ -98,6 +101,10 @@ typedef struct config_t
 	int timeout_len;
 	int scroll_off;
 	int gdefault;
+	/* Maximum number of directories whose sizes are kept between sessions. */
+	int dir_size_cache;
+	/* Number of threads that query information about files of a directory. */
+	int stat_workers;
 #ifndef _WIN32
 	char *slow_fs_list;
 #endif
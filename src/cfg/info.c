@@ -42,6 +42,7 @@
 #include "../bookmarks.h"
 #include "../commands.h"
 #include "../dir_stack.h"
+#include "../fileops.h"
 #include "../filelist.h"
 #include "../filetype.h"
 #include "../opt_handlers.h"
@@ -60,6 +61,7 @@ static void ensure_history_not_full(hist_t *hist);
 static void get_history(FileView *view, int reread, const char *dir,
 		const char *file, int pos);
 static void set_view_property(FileView *view, char type, const char value[]);
+static int get_dir_sizes_file(char buf[], size_t buf_len);
 static int copy_file(const char src[], const char dst[]);
 static int copy_file_internal(FILE *const src, FILE *const dst);
 static void update_info_file(const char filename[]);
@@ -98,6 +100,15 @@ read_info_file(int reread)
 
 	snprintf(info_file, sizeof(info_file), "%s/vifminfo", cfg.config_dir);
 
+	if(!reread)
+	{
+		char dir_sizes_file[PATH_MAX];
+		if(get_dir_sizes_file(dir_sizes_file, sizeof(dir_sizes_file)) == 0)
+		{
+			load_dir_sizes(dir_sizes_file);
+		}
+	}
+
 	if((fp = fopen(info_file, "r")) == NULL)
 		return;
 
@@ -425,6 +436,25 @@ write_info_file(void)
 	}
 }
 
+void
+write_dir_sizes_file(void)
+{
+	char dir_sizes_file[PATH_MAX];
+	if(get_dir_sizes_file(dir_sizes_file, sizeof(dir_sizes_file)) == 0)
+	{
+		save_dir_sizes(dir_sizes_file);
+	}
+}
+
+/* Formats path to the file with directory sizes in the buf.  Returns zero on
+ * success, otherwise non-zero is returned. */
+static int
+get_dir_sizes_file(char buf[], size_t buf_len)
+{
+	const int len = snprintf(buf, buf_len, "%s/dirsizes", cfg.config_dir);
+	return len < 0 || (size_t)len >= buf_len;
+}
+
 /* Copies the src file to the dst location.  Returns zero on success. */
 static int
 copy_file(const char src[], const char dst[])
@@ -870,6 +900,7 @@ write_options(FILE *const fp)
 			cfg.filter_inverted_by_default ? "f" : "",
 			cfg.selection_is_primary ? "s" : "",
 			cfg.tab_switches_pane ? "t" : "");
+	fprintf(fp, "=dirsizecache=%d\n", cfg.dir_size_cache);
 	fprintf(fp, "=%sfastrun\n", cfg.fast_run ? "" : "no");
 	if(strcmp(cfg.border_filler, " ") != 0)
 	{
@@ -900,10 +931,12 @@ write_options(FILE *const fp)
 	fprintf(fp, "=%ssmartcase\n", cfg.smart_case ? "" : "no");
 	fprintf(fp, "=%ssortnumbers\n", cfg.sort_numbers ? "" : "no");
 	fprintf(fp, "=statusline=%s\n", escape_spaces(cfg.status_line));
+	fprintf(fp, "=statworkers=%d\n", cfg.stat_workers);
 	fprintf(fp, "=tabstop=%d\n", cfg.tab_stop);
 	fprintf(fp, "=timefmt=%s\n", escape_spaces(cfg.time_format + 1));
 	fprintf(fp, "=timeoutlen=%d\n", cfg.timeout_len);
 	fprintf(fp, "=%strash\n", cfg.use_trash ? "" : "no");
+	fprintf(fp, "=trashrate=%d\n", cfg.trash_rate);
 	fprintf(fp, "=tuioptions=%s%s\n",
 			cfg.filelist_col_padding ? "p" : "",
 			cfg.side_borders_visible ? "s" : "");
@@ -1177,7 +1210,11 @@ write_trash(FILE *const fp, char *trash[], int ntrash)
 	fputs("\n# Trash content:\n", fp);
 	for(i = 0; i < nentries; i++)
 	{
-		fprintf(fp, "t%s\n\t%s\n", trash_list[i].trash_name, trash_list[i].path);
+		if(trash_list[i].trash_name != NULL)
+		{
+			fprintf(fp, "t%s\n\t%s\n", trash_list[i].trash_name,
+					trash_list[i].path);
+		}
 	}
 	for(i = 0; i < ntrash; i += 2)
 	{
@@ -28,6 +28,11 @@ void read_info_file(int reread);
 /* Writes vifminfo file updating it with state of the current instance. */
 void write_info_file(void);
 
+/* Writes sizes of directories calculated by ga/gA for the use by future
+ * sessions.  Waits for locks, so unlike write_info_file() it isn't meant to be
+ * called from signal handlers. */
+void write_dir_sizes_file(void);
+
 #endif /* VIFM__CFG__INFO_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
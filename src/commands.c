@@ -916,6 +916,9 @@ execute_command(FileView *view, const char command[], int menu)
 
 	if(!menu)
 	{
+		/* Ranges and commands operate on the whole list of files. */
+		finish_dir_list_loading(view);
+
 		init_cmds(1, &cmds_conf);
 		cmds_conf.begin = 0;
 		cmds_conf.current = view->list_pos;
@@ -3904,6 +3907,7 @@ static int
 write_cmd(const cmd_info_t *cmd_info)
 {
 	write_info_file();
+	write_dir_sizes_file();
 	return 0;
 }
 
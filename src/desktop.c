@@ -23,17 +23,55 @@
 #ifndef _WIN32
 #include <sys/dir.h>
 #endif
+#include <sys/stat.h> /* stat */
 #include <dirent.h> /* DIR */
+#include <pthread.h>
 
+#include <stddef.h> /* NULL */
+#include <stdint.h> /* uintptr_t */
 #include <stdio.h> /* snprintf() */
-#include <string.h> /* strstr() strchr() strlen() strcpy() */
+#include <stdlib.h> /* calloc() free() realloc() */
+#include <string.h> /* strcpy() strdup() strlen() strtok_r() */
+#include <time.h> /* time_t */
 
 #include "utils/fs_limits.h"
 #include "utils/path.h"
 #include "utils/str.h"
+#include "utils/trie.h"
 #include "utils/utils.h"
+#include "background.h"
 #include "filetype.h"
 
+/* Directory that was scanned during indexing. */
+typedef struct
+{
+	char *path;   /* Full path to the directory. */
+	int exists;   /* Whether the directory existed at the moment of scanning. */
+	time_t mtime; /* Modification time of the directory. */
+}
+indexed_dir_t;
+
+/* Applications that handle particular mime type. */
+typedef struct
+{
+	int *apps;  /* Indexes of applications in the list of all applications. */
+	int count;  /* Number of elements in apps. */
+}
+mime_apps_t;
+
+/* Index of .desktop files. */
+typedef struct
+{
+	assoc_records_t apps; /* All applications in order of discovery. */
+	mime_apps_t *mimes;   /* Handlers of each known mime type. */
+	int nmimes;           /* Number of elements in mimes. */
+	trie_t mime_index;    /* Maps mime type onto its position in mimes plus
+	                         one. */
+	indexed_dir_t *dirs;  /* Directories that were scanned. */
+	int ndirs;            /* Number of elements in dirs. */
+}
+desktop_index_t;
+
 static const char EXEC_KEY[] = "Exec=";
 static const char MIMETYPE_KEY[] = "MimeType=";
 static const char NAME_KEY[] = "Name=";
@@ -41,29 +79,168 @@ static const char NAME_KEY[] = "Name=";
 static const char CAPTION_MACRO = 'c';
 static const char FILE_MACROS[] = "Uuf";
 
-static void parse_desktop_files_internal(const char *path,
-		const char *mime_type, assoc_records_t *result);
-static void process_file(const char *path, const char *file_mime_type,
-		assoc_records_t *result);
+static void build_index_in_bg(void *arg);
+static desktop_index_t * build_index(const char *const dirs[]);
+static assoc_records_t get_handlers(const desktop_index_t *index,
+		const char mime_type[]);
+static void index_dir(desktop_index_t *index, const char path[]);
+static int add_indexed_dir(desktop_index_t *index, const char path[]);
+static void process_file(desktop_index_t *index, const char path[]);
+static void add_app(desktop_index_t *index, char mime_types[],
+		const char command[], const char description[]);
+static void add_mime_app(desktop_index_t *index, const char mime_type[],
+		int app);
+static int index_is_stale(const desktop_index_t *index);
+static void free_index(desktop_index_t *index);
 static void expand_desktop(const char *str, char *buf);
 
+/* Protects all variables below. */
+static pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when background indexing is over. */
+static pthread_cond_t index_cond = PTHREAD_COND_INITIALIZER;
+/* NULL terminated list of directories to index. */
+static const char *const *index_dirs;
+/* Current index or NULL if it's not built yet. */
+static desktop_index_t *current_index;
+/* Whether index is being built in background at the moment. */
+static int building_index;
+
+void
+desktop_index_init(const char *const dirs[], int in_background)
+{
+	pthread_mutex_lock(&index_mutex);
+
+	while(building_index)
+	{
+		pthread_cond_wait(&index_cond, &index_mutex);
+	}
+
+	index_dirs = dirs;
+	free_index(current_index);
+	current_index = NULL;
+
+	if(in_background)
+	{
+		building_index = (bg_execute("Indexing .desktop files", BG_UNDEFINED_TOTAL,
+					0, &build_index_in_bg, NULL) == 0);
+	}
+
+	pthread_mutex_unlock(&index_mutex);
+}
+
+/* Entry point of background task that builds index of .desktop files. */
+static void
+build_index_in_bg(void *arg)
+{
+	desktop_index_t *index;
+
+	/* Wait for desktop_index_init() to finish, otherwise it can overwrite
+	 * building_index flag after this function resets it. */
+	pthread_mutex_lock(&index_mutex);
+	pthread_mutex_unlock(&index_mutex);
+
+	index = build_index(index_dirs);
+
+	pthread_mutex_lock(&index_mutex);
+	current_index = index;
+	building_index = 0;
+	pthread_cond_broadcast(&index_cond);
+	pthread_mutex_unlock(&index_mutex);
+}
+
 assoc_records_t
-parse_desktop_files(const char *path, const char *mime_type)
+desktop_index_get(const char mime_type[])
+{
+	assoc_records_t result;
+
+	pthread_mutex_lock(&index_mutex);
+
+	/* Don't wait for background indexing, scan directories directly instead as
+	 * it was done before there was an index. */
+	if(building_index)
+	{
+		const char *const *const dirs = index_dirs;
+		desktop_index_t *index;
+
+		pthread_mutex_unlock(&index_mutex);
+
+		index = build_index(dirs);
+		result = get_handlers(index, mime_type);
+		free_index(index);
+		return result;
+	}
+
+	if(current_index == NULL || index_is_stale(current_index))
+	{
+		free_index(current_index);
+		current_index = build_index(index_dirs);
+	}
+
+	result = get_handlers(current_index, mime_type);
+
+	pthread_mutex_unlock(&index_mutex);
+
+	return result;
+}
+
+/* Looks up handlers of the mime type in the index, which can be NULL.  Returns
+ * list of handlers. */
+static assoc_records_t
+get_handlers(const desktop_index_t *index, const char mime_type[])
 {
 	assoc_records_t result = {};
-	parse_desktop_files_internal(path, mime_type, &result);
+	void *data;
+
+	if(index != NULL && index->mime_index != NULL_TRIE &&
+			trie_get(index->mime_index, mime_type, &data) == 0 && data != NULL)
+	{
+		const mime_apps_t *const mime_apps = &index->mimes[(uintptr_t)data - 1];
+		int i;
+		for(i = 0; i < mime_apps->count; ++i)
+		{
+			const assoc_record_t *const app = &index->apps.list[mime_apps->apps[i]];
+			add_assoc_record(&result, app->command, app->description);
+		}
+	}
+
 	return result;
 }
 
+/* Scans NULL terminated list of directories for .desktop files.  Returns newly
+ * allocated index or NULL on error. */
+static desktop_index_t *
+build_index(const char *const dirs[])
+{
+	desktop_index_t *const index = calloc(1, sizeof(*index));
+	int i;
+
+	if(index == NULL)
+	{
+		return NULL;
+	}
+
+	index->mime_index = trie_create();
+
+	for(i = 0; dirs != NULL && dirs[i] != NULL; ++i)
+	{
+		index_dir(index, dirs[i]);
+	}
+
+	return index;
+}
+
+/* Adds .desktop files of the directory and all its subdirectories to the
+ * index. */
 static void
-parse_desktop_files_internal(const char *path, const char *mime_type,
-		assoc_records_t *result)
+index_dir(desktop_index_t *index, const char path[])
 {
 	DIR *dir;
 	struct dirent *dentry;
 	const char *slash;
 
-	if((dir = opendir(path)) == NULL)
+	/* Directory is remembered even if it doesn't exist, so that its appearance
+	 * is noticed. */
+	if(add_indexed_dir(index, path) != 0 || (dir = opendir(path)) == NULL)
 	{
 		return;
 	}
@@ -82,20 +259,44 @@ parse_desktop_files_internal(const char *path, const char *mime_type,
 		snprintf(buf, sizeof (buf), "%s%s%s", path, slash, dentry->d_name);
 		if(dentry->d_type == DT_DIR)
 		{
-			parse_desktop_files(buf, mime_type);
+			index_dir(index, buf);
 		}
 		else
 		{
-			process_file(buf, mime_type, result);
+			process_file(index, buf);
 		}
 	}
 
 	closedir(dir);
 }
 
+/* Remembers state of the directory to be able to detect its changes later.
+ * Returns zero on success, otherwise non-zero is returned. */
+static int
+add_indexed_dir(desktop_index_t *index, const char path[])
+{
+	struct stat st;
+	indexed_dir_t *const dirs = realloc(index->dirs,
+			sizeof(*dirs)*(index->ndirs + 1));
+	if(dirs == NULL)
+	{
+		return 1;
+	}
+	index->dirs = dirs;
+
+	if((dirs[index->ndirs].path = strdup(path)) == NULL)
+	{
+		return 1;
+	}
+	dirs[index->ndirs].exists = (stat(path, &st) == 0);
+	dirs[index->ndirs].mtime = dirs[index->ndirs].exists ? st.st_mtime : 0;
+	++index->ndirs;
+	return 0;
+}
+
+/* Parses .desktop file and adds application it describes to the index. */
 static void
-process_file(const char *path, const char *file_mime_type,
-		assoc_records_t *result)
+process_file(desktop_index_t *index, const char path[])
 {
 	FILE *f;
 	char exec[1024] = "", mime_type[2048] = "", name[2048] = "";
@@ -112,28 +313,151 @@ process_file(const char *path, const char *file_mime_type,
 
 		if(starts_with(buf, EXEC_KEY))
 		{
-			snprintf(exec, sizeof(exec), "%s", buf + (ARRAY_LEN(EXEC_KEY) - 1));
+			copy_str(exec, sizeof(exec), buf + (ARRAY_LEN(EXEC_KEY) - 1));
 		}
 		else if(starts_with(buf, MIMETYPE_KEY))
 		{
-			snprintf(mime_type, sizeof(mime_type), "%s",
+			copy_str(mime_type, sizeof(mime_type),
 					buf + (ARRAY_LEN(MIMETYPE_KEY) - 1));
 		}
 		else if(starts_with(buf, NAME_KEY))
 		{
-			snprintf(name, sizeof(name), "%s", buf + (ARRAY_LEN(NAME_KEY) - 1));
+			copy_str(name, sizeof(name), buf + (ARRAY_LEN(NAME_KEY) - 1));
 		}
 	}
 
 	fclose(f);
 
-	if(strstr(mime_type, file_mime_type) == NULL || exec[0] == '\0')
+	if(mime_type[0] == '\0' || exec[0] == '\0')
 	{
 		return;
 	}
 
 	expand_desktop(exec, buf);
-	add_assoc_record(result, buf, name);
+	add_app(index, mime_type, buf, name);
+}
+
+/* Adds application to the index and registers it as a handler of each mime
+ * type in semicolon separated list of mime types, which is modified in
+ * place. */
+static void
+add_app(desktop_index_t *index, char mime_types[], const char command[],
+		const char description[])
+{
+	const int app = index->apps.count;
+	char *mime_type;
+	char *saveptr;
+
+	add_assoc_record(&index->apps, command, description);
+	if(index->apps.count == app)
+	{
+		return;
+	}
+
+	for(mime_type = mime_types; (mime_type = strtok_r(mime_type, ";", &saveptr));
+			mime_type = NULL)
+	{
+		add_mime_app(index, mime_type, app);
+	}
+}
+
+/* Registers application as a handler of the mime type. */
+static void
+add_mime_app(desktop_index_t *index, const char mime_type[], int app)
+{
+	mime_apps_t *mime_apps;
+	int *apps;
+	void *data;
+
+	if(index->mime_index == NULL_TRIE)
+	{
+		return;
+	}
+
+	if(trie_get(index->mime_index, mime_type, &data) == 0 && data != NULL)
+	{
+		mime_apps = &index->mimes[(uintptr_t)data - 1];
+	}
+	else
+	{
+		mime_apps_t *const mimes = realloc(index->mimes,
+				sizeof(*mimes)*(index->nmimes + 1));
+		if(mimes == NULL)
+		{
+			return;
+		}
+		index->mimes = mimes;
+
+		if(trie_set(index->mime_index, mime_type,
+					(void *)(uintptr_t)(index->nmimes + 1)) != 0)
+		{
+			return;
+		}
+
+		mime_apps = &mimes[index->nmimes++];
+		mime_apps->apps = NULL;
+		mime_apps->count = 0;
+	}
+
+	/* Mime type might be listed more than once. */
+	if(mime_apps->count != 0 && mime_apps->apps[mime_apps->count - 1] == app)
+	{
+		return;
+	}
+
+	apps = realloc(mime_apps->apps, sizeof(*apps)*(mime_apps->count + 1));
+	if(apps != NULL)
+	{
+		mime_apps->apps = apps;
+		mime_apps->apps[mime_apps->count++] = app;
+	}
+}
+
+/* Checks whether any of indexed directories has changed since it was scanned.
+ * Returns non-zero if so, otherwise zero is returned. */
+static int
+index_is_stale(const desktop_index_t *index)
+{
+	int i;
+	for(i = 0; i < index->ndirs; ++i)
+	{
+		const indexed_dir_t *const dir = &index->dirs[i];
+		struct stat st;
+		const int exists = (stat(dir->path, &st) == 0);
+		if(exists != dir->exists || (exists && st.st_mtime != dir->mtime))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Frees index and all its data.  The index can be NULL. */
+static void
+free_index(desktop_index_t *index)
+{
+	int i;
+
+	if(index == NULL)
+	{
+		return;
+	}
+
+	for(i = 0; i < index->nmimes; ++i)
+	{
+		free(index->mimes[i].apps);
+	}
+	free(index->mimes);
+	trie_free(index->mime_index);
+
+	for(i = 0; i < index->ndirs; ++i)
+	{
+		free(index->dirs[i].path);
+	}
+	free(index->dirs);
+
+	free_assoc_records(&index->apps);
+	free(index);
 }
 
 static void
@@ -21,7 +21,16 @@
 
 #include "filetype.h"
 
-assoc_records_t parse_desktop_files(const char *path, const char *mime_type);
+/* Sets NULL terminated list of directories with .desktop files (the list is
+ * not copied) and drops current index.  Index is then either built in
+ * background or on first lookup. */
+void desktop_index_init(const char *const dirs[], int in_background);
+
+/* Retrieves handlers of the mime type.  Index is rebuilt if any of indexed
+ * directories has changed.  While index is being built in background,
+ * directories are scanned directly.  Returns list of handlers, which should be
+ * freed by the caller. */
+assoc_records_t desktop_index_get(const char mime_type[]);
 
 #endif /* VIFM__DESKTOP_H__ */
 
@@ -28,25 +28,92 @@
 #include <magic.h>
 #endif
 
+#include <sys/stat.h> /* lstat() stat */
+#include <pthread.h>
+
 #include <stddef.h> /* size_t */
-#include <stdio.h> /* popen() */
-#include <string.h> /* strcpy() */
+#include <stdint.h> /* uintptr_t */
+#include <stdio.h> /* popen() snprintf() */
+#include <stdlib.h> /* free() malloc() realloc() */
+#include <string.h> /* strcmp() strdup() */
+#include <time.h> /* time_t */
 
+#include "utils/fs_limits.h"
+#include "utils/path.h"
 #include "utils/str.h"
+#include "utils/trie.h"
+#include "background.h"
 #include "desktop.h"
 #include "filetype.h"
 #include "status.h"
 
+/* Maximum number of mime types to remember, cache is reset when it's
+ * exceeded. */
+#define MAX_MIME_CACHE_SIZE 16384
+
+/* Mime type of a file, which is identified by device and inode numbers. */
+typedef struct
+{
+	time_t mtime;       /* Modification time of the file at the moment of
+	                       detection. */
+	char mimetype[128]; /* Mime type of the file. */
+}
+mime_cache_entry_t;
+
+/* Arguments of background task that determines mime types of files. */
+typedef struct
+{
+	char *dir;    /* Directory of files. */
+	char **names; /* Names of files. */
+	int count;    /* Number of elements in names. */
+}
+prefetch_args_t;
+
 static assoc_records_t handlers;
 
-static int get_gtk_mimetype(const char *filename, char *buf);
-static int get_magic_mimetype(const char *filename, char *buf);
+/* Protects mime types cache. */
+static pthread_mutex_t mime_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Protects libmagic handle, which can't be used by several threads at once. */
+static pthread_mutex_t magic_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Maps "device:inode" strings onto position in mime_cache plus one. */
+static trie_t mime_cache_index = NULL_TRIE;
+/* Mime types of files whose type was already determined. */
+static mime_cache_entry_t *mime_cache;
+/* Number of elements in mime_cache. */
+static int mime_cache_size;
+/* Directory whose files were last passed to prefetch_mimetypes(). */
+static char last_prefetched_dir[PATH_MAX];
+
+#if !defined(_WIN32) && defined(ENABLE_DESKTOP_FILES)
+/* Directories that contain .desktop files. */
+static const char *const APP_DIRS[] = {
+	"/usr/share/applications",
+	"/usr/local/share/applications",
+	NULL
+};
+#endif
+
+static int get_cached_mimetype(const char file[], char buf[], size_t buf_sz);
+static int get_key(const char file[], char key[], size_t key_sz,
+		time_t *mtime);
+static void cache_mimetype(const char key[], time_t mtime,
+		const char mimetype[]);
+static void reset_mime_cache(void);
+static void prefetch_in_bg(void *arg);
+static void free_prefetch_args(prefetch_args_t *args);
+static int detect_mimetype(const char file[], char buf[], size_t buf_sz);
+static int get_gtk_mimetype(const char *filename, char *buf, size_t buf_sz);
+static int get_magic_mimetype(const char *filename, char *buf, size_t buf_sz);
 static int get_file_mimetype(const char *filename, char *buf, size_t buf_sz);
 static assoc_records_t get_handlers(const char *mime_type);
+
+void
+init_magic_handlers(void)
+{
 #if !defined(_WIN32) && defined(ENABLE_DESKTOP_FILES)
-static void parse_app_dir(const char *directory, const char *mime_type,
-		assoc_records_t *result);
+	desktop_index_init(APP_DIRS, 1);
 #endif
+}
 
 assoc_records_t
 get_magic_handlers(const char *file)
@@ -60,20 +127,234 @@ get_mimetype(const char *file)
 {
 	static char mimetype[128];
 
-	if(get_gtk_mimetype(file, mimetype) == -1)
+	if(get_cached_mimetype(file, mimetype, sizeof(mimetype)) != 0)
+	{
+		return NULL;
+	}
+
+	return mimetype;
+}
+
+/* Determines mime type of the file either by looking it up in the cache or by
+ * examining the file.  Returns zero on success, otherwise -1 is returned. */
+static int
+get_cached_mimetype(const char file[], char buf[], size_t buf_sz)
+{
+	char key[64];
+	time_t mtime;
+	void *data;
+
+	if(get_key(file, key, sizeof(key), &mtime) != 0)
+	{
+		return detect_mimetype(file, buf, buf_sz);
+	}
+
+	pthread_mutex_lock(&mime_mutex);
+	if(mime_cache_index != NULL_TRIE &&
+			trie_get(mime_cache_index, key, &data) == 0 && data != NULL &&
+			mime_cache[(uintptr_t)data - 1].mtime == mtime)
+	{
+		copy_str(buf, buf_sz, mime_cache[(uintptr_t)data - 1].mimetype);
+		pthread_mutex_unlock(&mime_mutex);
+		return 0;
+	}
+	pthread_mutex_unlock(&mime_mutex);
+
+	if(detect_mimetype(file, buf, buf_sz) != 0)
+	{
+		return -1;
+	}
+
+	cache_mimetype(key, mtime, buf);
+	return 0;
+}
+
+/* Forms key of the file for the cache of mime types.  Only regular files are
+ * cached as type of other entries can change without changing their
+ * modification time (e.g. target of a symbolic link).  Returns zero on success
+ * and non-zero if the file shouldn't be cached. */
+static int
+get_key(const char file[], char key[], size_t key_sz, time_t *mtime)
+{
+	struct stat st;
+	if(lstat(file, &st) != 0 || !S_ISREG(st.st_mode))
 	{
-		if(get_magic_mimetype(file, mimetype) == -1)
+		return 1;
+	}
+
+	snprintf(key, key_sz, "%llx:%llx", (unsigned long long)st.st_dev,
+			(unsigned long long)st.st_ino);
+	*mtime = st.st_mtime;
+	return 0;
+}
+
+/* Remembers mime type of a file. */
+static void
+cache_mimetype(const char key[], time_t mtime, const char mimetype[])
+{
+	mime_cache_entry_t *entry;
+	void *data;
+
+	pthread_mutex_lock(&mime_mutex);
+
+	if(mime_cache_size >= MAX_MIME_CACHE_SIZE)
+	{
+		reset_mime_cache();
+	}
+
+	if(mime_cache_index == NULL_TRIE &&
+			(mime_cache_index = trie_create()) == NULL_TRIE)
+	{
+		pthread_mutex_unlock(&mime_mutex);
+		return;
+	}
+
+	if(trie_get(mime_cache_index, key, &data) == 0 && data != NULL)
+	{
+		entry = &mime_cache[(uintptr_t)data - 1];
+	}
+	else
+	{
+		entry = realloc(mime_cache, sizeof(*entry)*(mime_cache_size + 1));
+		if(entry == NULL)
+		{
+			pthread_mutex_unlock(&mime_mutex);
+			return;
+		}
+		mime_cache = entry;
+
+		if(trie_set(mime_cache_index, key,
+					(void *)(uintptr_t)(mime_cache_size + 1)) != 0)
 		{
-			if(get_file_mimetype(file, mimetype, sizeof(mimetype)) == -1)
-				return NULL;
+			pthread_mutex_unlock(&mime_mutex);
+			return;
 		}
+		entry = &mime_cache[mime_cache_size++];
 	}
 
-	return mimetype;
+	entry->mtime = mtime;
+	copy_str(entry->mimetype, sizeof(entry->mimetype), mimetype);
+
+	pthread_mutex_unlock(&mime_mutex);
+}
+
+/* Forgets all cached mime types.  Should be called with mime_mutex locked. */
+static void
+reset_mime_cache(void)
+{
+	trie_free(mime_cache_index);
+	mime_cache_index = NULL_TRIE;
+
+	free(mime_cache);
+	mime_cache = NULL;
+	mime_cache_size = 0;
+}
+
+int
+prefetch_mimetypes(const char dir[], char *const names[], int count)
+{
+	prefetch_args_t *args;
+	int i;
+
+	if(strcmp(last_prefetched_dir, dir) == 0)
+	{
+		return 0;
+	}
+
+	args = malloc(sizeof(*args));
+	if(args == NULL)
+	{
+		return 1;
+	}
+
+	args->dir = strdup(dir);
+	args->names = malloc(sizeof(*args->names)*count);
+	args->count = 0;
+	if(args->dir == NULL || args->names == NULL)
+	{
+		free_prefetch_args(args);
+		return 1;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		if((args->names[args->count] = strdup(names[i])) != NULL)
+		{
+			++args->count;
+		}
+	}
+
+	if(bg_execute("Detecting mime types", args->count, 0, &prefetch_in_bg,
+				args) != 0)
+	{
+		free_prefetch_args(args);
+		return 1;
+	}
+
+	copy_str(last_prefetched_dir, sizeof(last_prefetched_dir), dir);
+	return 0;
+}
+
+/* Entry point of background task that determines mime types of files to put
+ * them in the cache.  Only regular files are examined as mime types of other
+ * entries aren't cached anyway. */
+static void
+prefetch_in_bg(void *arg)
+{
+	prefetch_args_t *const args = arg;
+	const char *const slash = ends_with_slash(args->dir) ? "" : "/";
+	int i;
+
+	for(i = 0; i < args->count; ++i)
+	{
+		char path[PATH_MAX];
+		char mimetype[128];
+		struct stat st;
+
+		snprintf(path, sizeof(path), "%s%s%s", args->dir, slash, args->names[i]);
+		if(lstat(path, &st) == 0 && S_ISREG(st.st_mode))
+		{
+			(void)get_cached_mimetype(path, mimetype, sizeof(mimetype));
+		}
+		inner_bg_next();
+	}
+
+	free_prefetch_args(args);
+}
+
+/* Frees arguments of prefetching task. */
+static void
+free_prefetch_args(prefetch_args_t *args)
+{
+	int i;
+	for(i = 0; i < args->count; ++i)
+	{
+		free(args->names[i]);
+	}
+	free(args->names);
+	free(args->dir);
+	free(args);
+}
+
+/* Examines the file to determine its mime type.  Returns zero on success,
+ * otherwise -1 is returned. */
+static int
+detect_mimetype(const char file[], char buf[], size_t buf_sz)
+{
+	if(get_gtk_mimetype(file, buf, buf_sz) == -1)
+	{
+		if(get_magic_mimetype(file, buf, buf_sz) == -1)
+		{
+			if(get_file_mimetype(file, buf, buf_sz) == -1)
+				return -1;
+		}
+	}
+
+	return 0;
 }
 
 static int
-get_gtk_mimetype(const char *filename, char *buf)
+get_gtk_mimetype(const char *filename, char *buf, size_t buf_sz)
 {
 #ifdef HAVE_LIBGTK
 	GFile *file;
@@ -93,7 +374,7 @@ get_gtk_mimetype(const char *filename, char *buf)
 		return -1;
 	}
 
-	strcpy(buf, g_file_info_get_content_type(info));
+	copy_str(buf, buf_sz, g_file_info_get_content_type(info));
 	g_object_unref(info);
 	g_object_unref(file);
 	return 0;
@@ -102,30 +383,45 @@ get_gtk_mimetype(const char *filename, char *buf)
 #endif /* #ifdef HAVE_LIBGTK */
 }
 
+/* Libmagic handle is opened once and is used until the end of the process,
+ * because loading magic database is expensive. */
 static int
-get_magic_mimetype(const char *filename, char *buf)
+get_magic_mimetype(const char *filename, char *buf, size_t buf_sz)
 {
 #ifdef HAVE_LIBMAGIC
-	magic_t magic;
+	static magic_t magic;
+	static int magic_failed;
+	const char *mimetype;
+
+	pthread_mutex_lock(&magic_mutex);
 
+	if(magic == NULL && !magic_failed)
+	{
 #if HAVE_DECL_MAGIC_MIME_TYPE
-	magic = magic_open(MAGIC_MIME_TYPE);
+		magic = magic_open(MAGIC_MIME_TYPE);
 #else
-	magic = magic_open(MAGIC_MIME);
+		magic = magic_open(MAGIC_MIME);
 #endif
-	if(magic == NULL)
+		if(magic != NULL)
+		{
+			magic_load(magic, NULL);
+		}
+		magic_failed = (magic == NULL);
+	}
+
+	mimetype = (magic == NULL) ? NULL : magic_file(magic, filename);
+	if(mimetype == NULL)
 	{
+		pthread_mutex_unlock(&magic_mutex);
 		return -1;
 	}
 
-	magic_load(magic, NULL);
-
-	strcpy(buf, magic_file(magic, filename));
+	copy_str(buf, buf_sz, mimetype);
 #if !HAVE_DECL_MAGIC_MIME_TYPE
 	break_atr(buf, ';');
 #endif
 
-	magic_close(magic);
+	pthread_mutex_unlock(&magic_mutex);
 	return 0;
 #else /* #ifdef HAVE_LIBMAGIC */
 	return -1;
@@ -168,23 +464,14 @@ get_handlers(const char *mime_type)
 	free_assoc_records(&handlers);
 
 #if !defined(_WIN32) && defined(ENABLE_DESKTOP_FILES)
-	parse_app_dir("/usr/share/applications", mime_type, &handlers);
-	parse_app_dir("/usr/local/share/applications", mime_type, &handlers);
+	if(mime_type != NULL)
+	{
+		handlers = desktop_index_get(mime_type);
+	}
 #endif
 
 	return handlers;
 }
 
-#if !defined(_WIN32) && defined(ENABLE_DESKTOP_FILES)
-static void
-parse_app_dir(const char *directory, const char *mime_type,
-		assoc_records_t *result)
-{
-	assoc_records_t desktop_assocs = parse_desktop_files(directory, mime_type);
-	add_assoc_records(result, &desktop_assocs);
-	free_assoc_records(&desktop_assocs);
-}
-#endif
-
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 : */
@@ -21,8 +21,16 @@
 
 #include "filetype.h"
 
+/* Starts collecting information about handlers of mime types in
+ * background. */
+void init_magic_handlers(void);
 /* Returns pointer to a statically allocated buffer. */
 const char * get_mimetype(const char *file);
+/* Determines mime types of files of the directory in background, so that
+ * subsequent calls of get_mimetype() for them don't need to examine the files.
+ * Does nothing for the directory passed in previous call.  Returns zero on
+ * success, otherwise non-zero is returned. */
+int prefetch_mimetypes(const char dir[], char *const names[], int count);
 /* Caller shouldn't free anything. */
 assoc_records_t get_magic_handlers(const char *file);
 
@@ -28,8 +28,12 @@
 #endif
 
 #include <curses.h>
+#include <pthread.h>
 
 #include <dirent.h> /* DIR */
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h> /* IN_* inotify_add_watch() inotify_init1() */
+#endif
 #include <sys/stat.h> /* stat */
 #ifndef _WIN32
 #include <pwd.h>
@@ -42,8 +46,9 @@
 #include <stddef.h> /* NULL size_t */
 #include <stdint.h> /* uint64_t */
 #include <stdio.h> /* snprintf() */
-#include <stdlib.h> /* abs() calloc() free() malloc() */
-#include <string.h> /* memset() strcat() strcmp() strcpy() strdup() strlen() */
+#include <stdlib.h> /* abs() bsearch() calloc() free() malloc() qsort() */
+#include <string.h> /* memcpy() memmove() memset() strcat() strcmp() strcpy()
+                       strdup() strlen() strncmp() strspn() */
 #include <time.h> /* localtime() */
 
 #include "cfg/config.h"
@@ -78,6 +83,48 @@
 /* Mark for a cursor position of inactive pane. */
 #define INACTIVE_CURSOR_MARK "*"
 
+/* Initial number of entries to allocate room for on loading a directory. */
+#define DIR_ENTRIES_MIN_CAPACITY 64
+
+/* Maximum number of threads that query information about files. */
+#define MAX_STAT_WORKERS 64
+
+/* Minimal number of entries in a directory to query information about them in
+ * parallel.  For smaller directories starting threads isn't worth it. */
+#define MIN_PARALLEL_STAT_ENTRIES 256
+
+/* Number of entries a stat worker takes from the pool at a time. */
+#define STAT_BATCH_SIZE 32
+
+/* Number of entries read between updates of progress of directory loading. */
+#define LOAD_PROGRESS_STEP 8192
+
+/* Number of entries of a large directory read at once, the rest is read from
+ * the main loop. */
+#define LOAD_PORTION_SIZE 2048
+
+/* Maximum number of threads that match file names against local filter. */
+#define MAX_FILTER_WORKERS 16
+
+/* Minimal number of entries to match against local filter in parallel. */
+#define MIN_PARALLEL_FILTER_ENTRIES 16384
+
+#ifdef HAVE_SYS_INOTIFY_H
+/* Events of directory and its files, which are of interest for views. */
+#define WATCHED_EVENTS (IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE \
+                      | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF \
+                      | IN_MOVE_SELF)
+
+/* Number of changed files up to which entries are looked up one by one. */
+#define FEW_DIR_CHANGES 16
+
+/* Events after which the watch becomes useless. */
+#define WATCH_END_EVENTS (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_UNMOUNT)
+
+/* Size of buffer for reading change notifications. */
+#define EVENTS_BUF_SIZE 4096
+#endif
+
 /* Packet set of parameters to pass as user data for processing columns. */
 typedef struct
 {
@@ -90,6 +137,33 @@ typedef struct
 }
 column_data_t;
 
+#ifndef _WIN32
+/* Shared state of threads that query information about files. */
+typedef struct
+{
+	dir_entry_t *entries; /* List of entries to process. */
+	int *errors;          /* Per entry errno of failed lstat() or zero. */
+	size_t count;         /* Number of entries in the list. */
+	size_t next;          /* Index of the first entry not taken by a worker. */
+	pthread_mutex_t lock; /* Protects the next field. */
+}
+stat_pool_t;
+#endif
+
+/* Part of the list of candidates for local filter handled by one thread. */
+typedef struct
+{
+	const dir_entry_t *entries; /* Unfiltered list of entries. */
+	size_t *positions;          /* Positions of candidates in the entries.
+	                               Matching ones are moved to the front. */
+	size_t count;               /* Number of candidates, updated to number of
+	                               matches. */
+	const regex_t *regex;       /* Expression to match names against or NULL to
+	                               accept all entries. */
+	int show_parent;            /* Whether parent directory entry is visible. */
+}
+filter_chunk_t;
+
 static void column_line_print(const void *data, int column_id, const char *buf,
 		size_t offset);
 static int prepare_primary_col_color(FileView *view, int line_color,
@@ -140,21 +214,58 @@ TSTATIC int file_is_visible(FileView *view, const char filename[], int is_dir);
 static size_t get_filetype_decoration_width(FileType type);
 static void load_dir_list_internal(FileView *view, int reload, int draw_only);
 static int populate_dir_list_internal(FileView *view, int reload);
+#ifndef _WIN32
+static int read_dir_entries(FileView *view, DIR *dir, size_t *capacity,
+		int *with_parent_dir, int limit);
+static int stop_dir_list_loading(FileView *view);
+static void fill_entries_info(dir_entry_t entries[], size_t count);
+static void * stat_worker(void *arg);
+static void fill_entry_info(const char path[], dir_entry_t *entry);
+static int query_entry_info(const char path[], dir_entry_t *entry);
+static void finish_entry_info(const char path[], dir_entry_t *entry,
+		int error);
+#ifdef HAVE_SYS_INOTIFY_H
+static void watch_dir(FileView *view);
+static void unwatch_dir(FileView *view);
+static void clear_dir_changes(FileView *view);
+static int process_dir_events(FileView *view);
+static int read_dir_events(FileView *view);
+static int apply_dir_changes(FileView *view);
+static int name_ptr_cmp(const void *one, const void *two);
+static void remove_marked_entries(FileView *view, const char removed[]);
+static int add_new_entries(FileView *view, char *names[], int count);
+static int sorting_depends_on_attrs(const FileView *view);
+#endif
+static void update_max_filename_len(FileView *view, int from);
+#endif
+static void add_parent_dir_if_needed(FileView *view, int with_parent_dir);
 static int is_dir_big(const char path[]);
+static void merge_dir_lists(FileView *view, dir_entry_t *old, int old_count);
+static int entry_name_cmp(const void *one, const void *two);
 static void sort_dir_list(int msg, FileView *view);
 static void rescue_from_empty_filelist(FileView * view);
 static void add_parent_dir(FileView *view);
 static void append_slash(const char name[], char buf[], size_t buf_size);
 static void local_filter_finish(FileView *view);
 static void update_filtering_lists(FileView *view, int add, int clear);
+static void update_local_filter_matches(FileView *view);
+static int local_filter_is_refined(const FileView *view);
+#ifndef _WIN32
+static void match_candidates_in_parallel(filter_chunk_t *chunk,
+		const filter_t *filter);
+static void * filter_worker(void *arg);
+#endif
+static void match_chunk(filter_chunk_t *chunk);
+static int local_filter_matches(const dir_entry_t *entry, const regex_t *regex,
+		int show_parent);
 static int load_unfiltered_list(FileView *const view);
 static int get_unfiltered_pos(const FileView *const view, int pos);
 static void store_local_filter_position(FileView *const view, int pos);
 static int extract_previously_selected_pos(FileView *const view);
 static void clear_local_filter_hist_after(FileView *const view, int pos);
 static int find_nearest_neighour(const FileView *const view);
-static int add_dir_entry(dir_entry_t **list, size_t *list_size,
-		const dir_entry_t *entry);
+static int reserve_dir_entries(dir_entry_t **list, size_t *capacity,
+		size_t required);
 static int file_can_be_displayed(const char directory[], const char filename[]);
 static int parent_dir_is_visible(int in_root);
 static void find_dir_in_cdpath(const char base_dir[], const char dst[],
@@ -586,29 +697,7 @@ get_line_color(FileView* view, int pos)
 		case FIFO:
 			return FIFO_COLOR;
 		case LINK:
-			if(is_on_slow_fs(view->curr_dir))
-			{
-				return LINK_COLOR;
-			}
-			else
-			{
-				char full[PATH_MAX];
-				snprintf(full, sizeof(full), "%s/%s", view->curr_dir,
-						view->dir_entry[pos].name);
-				if(get_link_target_abs(full, view->curr_dir, full, sizeof(full)) != 0)
-				{
-					return BROKEN_LINK_COLOR;
-				}
-
-				/* Assume that targets on slow file system are not broken as actual
-				 * check might take long time. */
-				if(is_on_slow_fs(full))
-				{
-					return LINK_COLOR;
-				}
-
-				return path_exists(full) ? LINK_COLOR : BROKEN_LINK_COLOR;
-			}
+			return view->dir_entry[pos].link_broken ? BROKEN_LINK_COLOR : LINK_COLOR;
 #ifndef _WIN32
 		case SOCKET:
 			return SOCKET_COLOR;
@@ -2019,6 +2108,387 @@ check_dir_changed(FileView *view)
 }
 #endif
 
+#ifdef HAVE_SYS_INOTIFY_H
+/* Makes sure that current directory of the view is being watched for changes.
+ * Discards events reported so far, as they are accounted by a reload, which is
+ * expected to follow. */
+static void
+watch_dir(FileView *view)
+{
+	if(view->watched_dir[0] != '\0' &&
+			stroscmp(view->watched_dir, view->curr_dir) == 0)
+	{
+		char buf[EVENTS_BUF_SIZE];
+		while(read(view->dir_watcher, buf, sizeof(buf)) > 0);
+		clear_dir_changes(view);
+		return;
+	}
+
+	unwatch_dir(view);
+
+	view->dir_watcher = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(view->dir_watcher == -1)
+	{
+		LOG_SERROR_MSG(errno, "Can't initialize inotify");
+		return;
+	}
+
+	if(inotify_add_watch(view->dir_watcher, view->curr_dir, WATCHED_EVENTS) == -1)
+	{
+		LOG_SERROR_MSG(errno, "Can't watch \"%s\"", view->curr_dir);
+		close(view->dir_watcher);
+		view->dir_watcher = -1;
+		return;
+	}
+
+	copy_str(view->watched_dir, sizeof(view->watched_dir), view->curr_dir);
+}
+
+/* Stops watching directory of the view, if it's being watched. */
+static void
+unwatch_dir(FileView *view)
+{
+	if(view->watched_dir[0] != '\0')
+	{
+		close(view->dir_watcher);
+		view->dir_watcher = -1;
+		view->watched_dir[0] = '\0';
+	}
+	clear_dir_changes(view);
+}
+
+/* Forgets about changes of directory of the view that weren't applied. */
+static void
+clear_dir_changes(FileView *view)
+{
+	free_string_array(view->dir_changes.names, view->dir_changes.count);
+	view->dir_changes.names = NULL;
+	view->dir_changes.count = 0;
+	view->dir_changes.reload = 0;
+}
+
+/* Processes all pending change notifications of directory of the view.  Files
+ * are added, removed or updated in place.  While local filter is being edited,
+ * changes are only queued to be applied after it's done.  Returns positive
+ * number if list of files needs to be reloaded, zero if the view is up to date
+ * and negative number if directory isn't being watched. */
+static int
+process_dir_events(FileView *view)
+{
+	if(view->watched_dir[0] == '\0')
+	{
+		return -1;
+	}
+
+	if(read_dir_events(view) != 0)
+	{
+		unwatch_dir(view);
+		return -1;
+	}
+
+	/* Entries of filtered list are shallow copies of unfiltered ones. */
+	if(view->local_filter.in_progress)
+	{
+		return 0;
+	}
+
+	if(!view->dir_changes.reload && view->dir_changes.count != 0)
+	{
+		view->dir_changes.reload = apply_dir_changes(view);
+	}
+
+	if(view->dir_changes.reload)
+	{
+		clear_dir_changes(view);
+		return 1;
+	}
+
+	clear_dir_changes(view);
+	return 0;
+}
+
+/* Reads all pending change notifications of directory of the view and queues
+ * them.  Returns non-zero if the watch isn't valid anymore, otherwise zero is
+ * returned. */
+static int
+read_dir_events(FileView *view)
+{
+	char buf[EVENTS_BUF_SIZE]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+
+	while((len = read(view->dir_watcher, buf, sizeof(buf))) > 0)
+	{
+		const char *p = buf;
+		while(p < buf + len)
+		{
+			const struct inotify_event *const e = (const void *)p;
+			p += sizeof(*e) + e->len;
+
+			if(e->mask & WATCH_END_EVENTS)
+			{
+				return 1;
+			}
+
+			if(e->mask & IN_Q_OVERFLOW)
+			{
+				view->dir_changes.reload = 1;
+			}
+			else if(e->len != 0 && !view->dir_changes.reload)
+			{
+				const int count = add_to_string_array(&view->dir_changes.names,
+						view->dir_changes.count, 1, e->name);
+				if(count == view->dir_changes.count)
+				{
+					view->dir_changes.reload = 1;
+				}
+				view->dir_changes.count = count;
+			}
+		}
+	}
+
+	if(len < 0 && errno != EAGAIN)
+	{
+		LOG_SERROR_MSG(errno, "Can't read events of \"%s\"", view->watched_dir);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Applies queued changes of files to the list of the view: removes entries of
+ * files that don't exist anymore, adds entries for new files and updates the
+ * rest.  Schedules redraw of the view.  Returns non-zero if list of files needs
+ * to be reloaded instead, otherwise zero is returned. */
+static int
+apply_dir_changes(FileView *view)
+{
+	char **const names = view->dir_changes.names;
+	const int count = view->dir_changes.count;
+	const int old_rows = view->list_rows;
+	dir_entry_t **by_name = NULL;
+	char *removed;
+	char **added;
+	int nadded = 0;
+	int nremoved = 0;
+	int nupdated = 0;
+	int i;
+
+	removed = calloc(old_rows, 1);
+	added = malloc(sizeof(*added)*count);
+	if(removed == NULL || added == NULL)
+	{
+		free(removed);
+		free(added);
+		return 1;
+	}
+
+	/* Looking up many names one by one takes quadratic time. */
+	if(count > FEW_DIR_CHANGES)
+	{
+		by_name = malloc(sizeof(*by_name)*old_rows);
+		if(by_name == NULL)
+		{
+			free(removed);
+			free(added);
+			return 1;
+		}
+
+		for(i = 0; i < old_rows; ++i)
+		{
+			by_name[i] = &view->dir_entry[i];
+		}
+		qsort(by_name, old_rows, sizeof(*by_name), &entry_name_cmp);
+	}
+
+	/* Same file can be mentioned by several events. */
+	qsort(names, count, sizeof(*names), &name_ptr_cmp);
+
+	for(i = 0; i < count; ++i)
+	{
+		char full_path[PATH_MAX];
+		struct stat s;
+		int pos;
+
+		if(i > 0 && strcmp(names[i], names[i - 1]) == 0)
+		{
+			continue;
+		}
+
+		if(by_name == NULL)
+		{
+			pos = find_file_pos_in_list(view, names[i]);
+		}
+		else
+		{
+			const dir_entry_t key = { .name = names[i] };
+			const dir_entry_t *const key_ptr = &key;
+			dir_entry_t **const found = bsearch(&key_ptr, by_name, old_rows,
+					sizeof(*by_name), &entry_name_cmp);
+			pos = (found == NULL) ? -1 : (*found - view->dir_entry);
+		}
+
+		snprintf(full_path, sizeof(full_path), "%s/%s", view->curr_dir, names[i]);
+		if(lstat(full_path, &s) != 0)
+		{
+			if(pos >= 0)
+			{
+				removed[pos] = 1;
+				++nremoved;
+			}
+		}
+		else if(pos >= 0)
+		{
+			fill_entry_info(full_path, &view->dir_entry[pos]);
+			++nupdated;
+		}
+		else
+		{
+			added[nadded++] = names[i];
+		}
+	}
+
+	free(by_name);
+
+	if(nremoved != 0)
+	{
+		remove_marked_entries(view, removed);
+	}
+	free(removed);
+
+	if(nadded != 0)
+	{
+		nadded = add_new_entries(view, added, nadded);
+	}
+	free(added);
+
+	if(nadded < 0 || view->list_rows == 0)
+	{
+		return 1;
+	}
+
+	if(nadded != 0 || (nupdated != 0 && sorting_depends_on_attrs(view)))
+	{
+		resort_dir_list(0, view);
+	}
+
+	if(nadded != 0 || nremoved != 0 || nupdated != 0)
+	{
+		view->column_count = calculate_columns_count(view);
+		ui_view_schedule_redraw(view);
+	}
+	return 0;
+}
+
+/* Compares two strings specified by pointers to them for qsort(). */
+static int
+name_ptr_cmp(const void *one, const void *two)
+{
+	return strcmp(*(char *const *)one, *(char *const *)two);
+}
+
+/* Removes entries of the view marked in the removed array keeping cursor on the
+ * same file or on the next one if the current file was removed. */
+static void
+remove_marked_entries(FileView *view, const char removed[])
+{
+	int nbefore_cursor = 0;
+	int i, j;
+
+	for(i = 0, j = 0; i < view->list_rows; ++i)
+	{
+		if(removed[i])
+		{
+			view->selected_files -= (view->dir_entry[i].selected != 0);
+			nbefore_cursor += (i < view->list_pos);
+			free(view->dir_entry[i].name);
+			continue;
+		}
+		view->dir_entry[j++] = view->dir_entry[i];
+	}
+	view->list_rows = j;
+
+	view->list_pos -= nbefore_cursor;
+	if(view->list_pos >= view->list_rows)
+	{
+		view->list_pos = MAX(0, view->list_rows - 1);
+	}
+}
+
+/* Appends entries for files with specified names, which pass filters of the
+ * view, to the list.  The list is left unsorted.  Returns number of added
+ * entries or negative number on error. */
+static int
+add_new_entries(FileView *view, char *names[], int count)
+{
+	const int old_rows = view->list_rows;
+	dir_entry_t *const new_list = realloc(view->dir_entry,
+			sizeof(*new_list)*(old_rows + count));
+	int i;
+
+	if(new_list == NULL)
+	{
+		return -1;
+	}
+	view->dir_entry = new_list;
+
+	for(i = 0; i < count; ++i)
+	{
+		char full_path[PATH_MAX];
+		dir_entry_t *const entry = &view->dir_entry[view->list_rows];
+
+		entry->name = strdup(names[i]);
+		if(entry->name == NULL)
+		{
+			return -1;
+		}
+
+		entry->selected = 0;
+		entry->was_selected = 0;
+		entry->search_match = 0;
+		entry->type = UNKNOWN;
+
+		snprintf(full_path, sizeof(full_path), "%s/%s", view->curr_dir, names[i]);
+		fill_entry_info(full_path, entry);
+
+		if(!file_is_visible(view, entry->name, is_directory_entry(entry)) ||
+				(view->hide_dot && entry->name[0] == '.'))
+		{
+			free(entry->name);
+			view->filtered++;
+			continue;
+		}
+
+		view->list_rows++;
+	}
+
+	update_max_filename_len(view, old_rows);
+	return view->list_rows - old_rows;
+}
+
+/* Checks whether order of files in the view depends on their attributes (not
+ * only on names).  Returns non-zero if so, otherwise zero is returned. */
+static int
+sorting_depends_on_attrs(const FileView *view)
+{
+	int i;
+	for(i = 0; i < SK_COUNT && view->sort[i] != SK_NONE; ++i)
+	{
+		switch(abs(view->sort[i]))
+		{
+			case SK_BY_NAME:
+			case SK_BY_INAME:
+			case SK_BY_EXTENSION:
+				break;
+
+			default:
+				return 1;
+		}
+	}
+	return 0;
+}
+#endif
+
 static int
 update_dir_mtime(FileView *view)
 {
@@ -2031,6 +2501,9 @@ update_dir_mtime(FileView *view)
 	view->dir_mtime = s.st_mtim;
 #else
 	view->dir_mtime = s.st_mtime;
+#endif
+#ifdef HAVE_SYS_INOTIFY_H
+	watch_dir(view);
 #endif
 	return 0;
 #else
@@ -2395,6 +2868,8 @@ fill_with_shared(FileView *view)
 					dir_entry->ctime = 0;
 
 					dir_entry->type = DIRECTORY;
+					dir_entry->link_type = SLT_UNKNOWN;
+					dir_entry->link_broken = 0;
 					view->list_rows++;
 
 				p++;
@@ -2421,74 +2896,112 @@ win_to_unix_time(FILETIME ft)
 }
 #endif
 
+/* Reads list of files of current directory of the view.  When in_portions is
+ * non-zero, only first portion of files is read and the rest is left to
+ * load_dir_list_portion().  Returns zero on success, otherwise non-zero is
+ * returned. */
 static int
-fill_dir_list(FileView *view)
+fill_dir_list(FileView *view, int in_portions)
 {
 	int with_parent_dir = 0;
-	const int is_root = is_root_dir(view->curr_dir);
+	/* Number of entries view->dir_entry has room for. */
+	size_t capacity = 0U;
 
 	view->matches = 0;
 	view->max_filename_len = 0;
 
 #ifndef _WIN32
 	DIR *dir;
-	struct dirent *d;
+	int result;
 
 	if((dir = opendir(view->curr_dir)) == NULL)
 		return -1;
 
-	for(view->list_rows = 0; (d = readdir(dir)); view->list_rows++)
+	view->list_rows = 0;
+
+	/* Only first portion of a large directory is read here, the rest is read
+	 * from the main loop by load_dir_list_portion(). */
+	result = read_dir_entries(view, dir, &capacity, &with_parent_dir,
+			in_portions ? LOAD_PORTION_SIZE : -1);
+	if(result < 0)
 	{
-		dir_entry_t *dir_entry;
-		size_t name_len;
-		struct stat s;
+		closedir(dir);
+		return -1;
+	}
+	if(result == 0)
+	{
+		view->loading.dir = dir;
+		view->loading.capacity = capacity;
+		view->loading.with_parent = with_parent_dir;
+		return 0;
+	}
+	closedir(dir);
+#else
+	const int is_root = is_root_dir(view->curr_dir);
+	char buf[PATH_MAX];
+	HANDLE hfind;
+	WIN32_FIND_DATAA ffd;
 
-		/* Ignore the "." directory. */
-		if(stroscmp(d->d_name, ".") == 0)
-		{
-			view->list_rows--;
+	if(is_unc_root(view->curr_dir))
+	{
+		fill_with_shared(view);
+		return 0;
+	}
+
+	snprintf(buf, sizeof(buf), "%s/*", view->curr_dir);
+
+	view->list_rows = 0;
+
+	hfind = FindFirstFileA(buf, &ffd);
+	if(hfind == INVALID_HANDLE_VALUE)
+		return -1;
+
+	do
+	{
+		dir_entry_t *dir_entry;
+		size_t name_len;
+
+		/* Ignore the "." directory. */
+		if(stroscmp(ffd.cFileName, ".") == 0)
 			continue;
-		}
-		if(stroscmp(d->d_name, "..") == 0)
+		/* Always include the ../ directory unless it is the root directory. */
+		if(stroscmp(ffd.cFileName, "..") == 0)
 		{
 			if(!parent_dir_is_visible(is_root))
 			{
-				view->list_rows--;
 				continue;
 			}
 			with_parent_dir = 1;
 		}
-		else if(!file_is_visible(view, d->d_name, is_dirent_targets_dir(d)))
+		else if(!file_is_visible(view, ffd.cFileName,
+				ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
 		{
 			view->filtered++;
-			view->list_rows--;
 			continue;
 		}
-		else if(view->hide_dot && d->d_name[0] == '.')
+		else if(view->hide_dot && ffd.cFileName[0] == '.')
 		{
 			view->filtered++;
-			view->list_rows--;
 			continue;
 		}
 
-		view->dir_entry = (dir_entry_t *)realloc(view->dir_entry,
-				(view->list_rows + 1) * sizeof(dir_entry_t));
-		if(view->dir_entry == NULL)
+		if(reserve_dir_entries(&view->dir_entry, &capacity,
+					view->list_rows + 1) != 0)
 		{
-			closedir(dir);
 			show_error_msg("Memory Error", "Unable to allocate enough memory");
+			FindClose(hfind);
 			return -1;
 		}
 
 		dir_entry = view->dir_entry + view->list_rows;
 
-		name_len = strlen(d->d_name);
+		name_len = strlen(ffd.cFileName);
 		/* Allocate extra for adding / to directories. */
-		dir_entry->name = strdup(d->d_name);
+		dir_entry->name = strdup(ffd.cFileName);
 		if(dir_entry->name == NULL)
 		{
-			closedir(dir);
 			show_error_msg("Memory Error", "Unable to allocate enough memory");
+			FindClose(hfind);
 			return -1;
 		}
 
@@ -2497,120 +3010,133 @@ fill_dir_list(FileView *view)
 		dir_entry->was_selected = 0;
 		dir_entry->search_match = 0;
 
-		/* Load the inode info */
-		if(lstat(dir_entry->name, &s) != 0)
+		dir_entry->size = ((uintmax_t)ffd.nFileSizeHigh << 32) + ffd.nFileSizeLow;
+		dir_entry->attrs = ffd.dwFileAttributes;
+		dir_entry->mtime = win_to_unix_time(ffd.ftLastWriteTime);
+		dir_entry->atime = win_to_unix_time(ffd.ftLastAccessTime);
+		dir_entry->ctime = win_to_unix_time(ffd.ftCreationTime);
+
+		dir_entry->link_type = SLT_UNKNOWN;
+		dir_entry->link_broken = 0;
+		if(is_win_symlink(ffd.dwFileAttributes, ffd.dwReserved0))
 		{
-			LOG_SERROR_MSG(errno, "Can't lstat() \"%s/%s\"", view->curr_dir,
+			char full_path[PATH_MAX];
+			snprintf(full_path, sizeof(full_path), "%s/%s", view->curr_dir,
 					dir_entry->name);
-			log_cwd();
 
-			dir_entry->type = UNKNOWN;
-			dir_entry->size = 0;
-			dir_entry->mode = 0;
-			dir_entry->uid = -1;
-			dir_entry->gid = -1;
-			dir_entry->mtime = 0;
-			dir_entry->atime = 0;
-			dir_entry->ctime = 0;
+			dir_entry->type = LINK;
+			dir_entry->link_type = get_symlink_type(full_path);
+			dir_entry->link_broken = dir_entry->link_type != SLT_SLOW &&
+				!path_exists(full_path);
 		}
-		else
+		else if(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 		{
-			dir_entry->type = get_type_from_mode(s.st_mode);
-			dir_entry->size = (uintmax_t)s.st_size;
-			dir_entry->mode = s.st_mode;
-			dir_entry->uid = s.st_uid;
-			dir_entry->gid = s.st_gid;
-			dir_entry->mtime = s.st_mtime;
-			dir_entry->atime = s.st_atime;
-			dir_entry->ctime = s.st_ctime;
+			dir_entry->type = DIRECTORY;
 		}
-
-		if(dir_entry->type == UNKNOWN)
+		else if(is_win_executable(dir_entry->name))
 		{
-			dir_entry->type = type_from_dir_entry(d);
+			dir_entry->type = EXECUTABLE;
 		}
-
-		if(dir_entry->type == LINK)
+		else
 		{
-			struct stat st;
-
-			const SymLinkType symlink_type = get_symlink_type(dir_entry->name);
-			if(symlink_type != SLT_SLOW && stat(dir_entry->name, &st) == 0)
-			{
-				dir_entry->mode = st.st_mode;
-			}
+			dir_entry->type = REGULAR;
 		}
-
+		view->list_rows++;
 		name_len += get_filetype_decoration_width(dir_entry->type);
 		view->max_filename_len = MAX(view->max_filename_len, name_len);
 	}
-	closedir(dir);
-#else
-	char buf[PATH_MAX];
-	HANDLE hfind;
-	WIN32_FIND_DATAA ffd;
+	while(FindNextFileA(hfind, &ffd));
+	FindClose(hfind);
 
-	if(is_unc_root(view->curr_dir))
+	/* Not all Windows file systems contain or show dot directories. */
+	if(!with_parent_dir && parent_dir_is_visible(is_root))
 	{
-		fill_with_shared(view);
-		return 0;
+		add_parent_dir(view);
+		with_parent_dir = 1;
 	}
 
-	snprintf(buf, sizeof(buf), "%s/*", view->curr_dir);
+#endif
 
-	view->list_rows = 0;
+	add_parent_dir_if_needed(view, with_parent_dir);
+	return 0;
+}
 
-	hfind = FindFirstFileA(buf, &ffd);
-	if(hfind == INVALID_HANDLE_VALUE)
-		return -1;
+/* Adds ".." entry to the view if it wasn't read from file system, but should be
+ * displayed. */
+static void
+add_parent_dir_if_needed(FileView *view, int with_parent_dir)
+{
+	if(!with_parent_dir && !is_root_dir(view->curr_dir))
+	{
+		if((cfg.dot_dirs & DD_NONROOT_PARENT) || view->list_rows == 0)
+		{
+			add_parent_dir(view);
+		}
+	}
+}
 
-	do
+#ifndef _WIN32
+
+/* Reads at most limit entries (or all of them if limit is negative) of the dir
+ * into the list of files of the view and fills information about them.  The
+ * *capacity is number of entries view->dir_entry has room for and
+ * *with_parent_dir is set when ".." is read.  Returns positive number when end
+ * of directory is reached, zero if there are more entries to read and negative
+ * number on error. */
+static int
+read_dir_entries(FileView *view, DIR *dir, size_t *capacity,
+		int *with_parent_dir, int limit)
+{
+	const int is_root = is_root_dir(view->curr_dir);
+	const int first = view->list_rows;
+	struct dirent *d;
+
+	while(limit < 0 || view->list_rows - first < limit)
 	{
 		dir_entry_t *dir_entry;
-		size_t name_len;
+
+		if((d = readdir(dir)) == NULL)
+		{
+			break;
+		}
 
 		/* Ignore the "." directory. */
-		if(stroscmp(ffd.cFileName, ".") == 0)
+		if(stroscmp(d->d_name, ".") == 0)
+		{
 			continue;
-		/* Always include the ../ directory unless it is the root directory. */
-		if(stroscmp(ffd.cFileName, "..") == 0)
+		}
+		if(stroscmp(d->d_name, "..") == 0)
 		{
 			if(!parent_dir_is_visible(is_root))
 			{
 				continue;
 			}
-			with_parent_dir = 1;
+			*with_parent_dir = 1;
 		}
-		else if(!file_is_visible(view, ffd.cFileName,
-				ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		else if(!file_is_visible(view, d->d_name, is_dirent_targets_dir(d)))
 		{
 			view->filtered++;
 			continue;
 		}
-		else if(view->hide_dot && ffd.cFileName[0] == '.')
+		else if(view->hide_dot && d->d_name[0] == '.')
 		{
 			view->filtered++;
 			continue;
 		}
 
-		view->dir_entry = realloc(view->dir_entry,
-				(view->list_rows + 1) * sizeof(dir_entry_t));
-		if(view->dir_entry == NULL)
+		if(reserve_dir_entries(&view->dir_entry, capacity,
+					view->list_rows + 1) != 0)
 		{
 			show_error_msg("Memory Error", "Unable to allocate enough memory");
-			FindClose(hfind);
 			return -1;
 		}
 
 		dir_entry = view->dir_entry + view->list_rows;
 
-		name_len = strlen(ffd.cFileName);
-		/* Allocate extra for adding / to directories. */
-		dir_entry->name = strdup(ffd.cFileName);
+		dir_entry->name = strdup(d->d_name);
 		if(dir_entry->name == NULL)
 		{
 			show_error_msg("Memory Error", "Unable to allocate enough memory");
-			FindClose(hfind);
 			return -1;
 		}
 
@@ -2619,55 +3145,301 @@ fill_dir_list(FileView *view)
 		dir_entry->was_selected = 0;
 		dir_entry->search_match = 0;
 
-		dir_entry->size = ((uintmax_t)ffd.nFileSizeHigh << 32) + ffd.nFileSizeLow;
-		dir_entry->attrs = ffd.dwFileAttributes;
-		dir_entry->mtime = win_to_unix_time(ffd.ftLastWriteTime);
-		dir_entry->atime = win_to_unix_time(ffd.ftLastAccessTime);
-		dir_entry->ctime = win_to_unix_time(ffd.ftCreationTime);
+		/* Type reported by readdir() serves as a fallback for the case when
+		 * lstat() can't tell anything. */
+		dir_entry->type = type_from_dir_entry(d);
 
-		if(is_win_symlink(ffd.dwFileAttributes, ffd.dwReserved0))
+		view->list_rows++;
+	}
+
+	fill_entries_info(&view->dir_entry[first], view->list_rows - first);
+	update_max_filename_len(view, first);
+
+	return d == NULL;
+}
+
+int
+load_dir_list_portion(FileView *view)
+{
+	const int prev_rows = view->list_rows;
+	int result;
+
+	if(view->loading.dir == NULL)
+	{
+		return 0;
+	}
+
+	/* Names of entries are relative to current directory. */
+	if(vifm_chdir(view->curr_dir) != 0)
+	{
+		stop_dir_list_loading(view);
+		return 0;
+	}
+
+	result = read_dir_entries(view, view->loading.dir, &view->loading.capacity,
+			&view->loading.with_parent, LOAD_PORTION_SIZE);
+	(void)vifm_chdir(curr_view->curr_dir);
+
+	if(result == 0)
+	{
+		if(prev_rows/LOAD_PROGRESS_STEP != view->list_rows/LOAD_PROGRESS_STEP &&
+				!vle_mode_is(CMDLINE_MODE))
 		{
-			dir_entry->type = LINK;
+			ui_sb_quick_msgf("Reading directory... %d items", view->list_rows);
 		}
-		else if(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		ui_view_schedule_redraw(view);
+		return 1;
+	}
+
+	closedir(view->loading.dir);
+	view->loading.dir = NULL;
+	add_parent_dir_if_needed(view, view->loading.with_parent);
+
+	/* Cursor position is restored from history only if it wasn't moved while the
+	 * list was being loaded. */
+	if(view->list_pos == 0)
+	{
+		sort_dir_list(1, view);
+		check_view_dir_history(view);
+	}
+	else
+	{
+		resort_dir_list(1, view);
+	}
+	view->column_count = calculate_columns_count(view);
+
+	if(!vle_mode_is(CMDLINE_MODE))
+	{
+		clean_status_bar();
+	}
+	ui_view_schedule_redraw(view);
+	return 0;
+}
+
+/* Aborts reading of a large directory, if any, leaving the list partially
+ * loaded.  Returns non-zero if reading was in progress, otherwise zero is
+ * returned. */
+static int
+stop_dir_list_loading(FileView *view)
+{
+	if(view->loading.dir == NULL)
+	{
+		return 0;
+	}
+
+	closedir(view->loading.dir);
+	view->loading.dir = NULL;
+	return 1;
+}
+
+/* Fills information about files of the list from file system.  Names of
+ * entries are relative to current working directory and types are expected to
+ * be preset to values guessed without accessing file system.  Work is split
+ * among several threads for large lists, so that requests to file system don't
+ * wait for each other, which matters a lot for network file systems.  Symbolic
+ * links are resolved by the calling thread after that. */
+static void
+fill_entries_info(dir_entry_t entries[], size_t count)
+{
+	stat_pool_t pool = {
+		.entries = entries, .errors = NULL, .count = count, .next = 0U
+	};
+	pthread_t threads[MAX_STAT_WORKERS];
+	const int nworkers = MIN(cfg.stat_workers, MAX_STAT_WORKERS);
+	int nstarted;
+	int i;
+	size_t j;
+
+	if(nworkers > 1 && count >= MIN_PARALLEL_STAT_ENTRIES)
+	{
+		pool.errors = malloc(sizeof(*pool.errors)*count);
+	}
+
+	if(pool.errors == NULL || pthread_mutex_init(&pool.lock, NULL) != 0)
+	{
+		free(pool.errors);
+		for(j = 0U; j < count; ++j)
 		{
-			dir_entry->type = DIRECTORY;
+			fill_entry_info(entries[j].name, &entries[j]);
 		}
-		else if(is_win_executable(dir_entry->name))
+		return;
+	}
+
+	/* Current thread is one of the workers, which guarantees progress even if no
+	 * other thread can be started. */
+	nstarted = 0;
+	for(i = 1; i < nworkers; ++i)
+	{
+		if(pthread_create(&threads[nstarted], NULL, &stat_worker, &pool) == 0)
 		{
-			dir_entry->type = EXECUTABLE;
+			++nstarted;
 		}
-		else
+	}
+
+	(void)stat_worker(&pool);
+
+	for(i = 0; i < nstarted; ++i)
+	{
+		(void)pthread_join(threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool.lock);
+
+	for(j = 0U; j < count; ++j)
+	{
+		finish_entry_info(entries[j].name, &entries[j], pool.errors[j]);
+	}
+	free(pool.errors);
+}
+
+/* Entry point of a thread that fills information about files.  Takes entries
+ * from the pool in small batches until they are over.  Returns NULL. */
+static void *
+stat_worker(void *arg)
+{
+	stat_pool_t *const pool = arg;
+
+	while(1)
+	{
+		size_t from, to;
+
+		pthread_mutex_lock(&pool->lock);
+		from = pool->next;
+		to = MIN(from + STAT_BATCH_SIZE, pool->count);
+		pool->next = to;
+		pthread_mutex_unlock(&pool->lock);
+
+		if(from >= to)
 		{
-			dir_entry->type = REGULAR;
+			break;
+		}
+
+		for(; from < to; ++from)
+		{
+			dir_entry_t *const entry = &pool->entries[from];
+			pool->errors[from] = query_entry_info(entry->name, entry);
 		}
-		view->list_rows++;
-		name_len += get_filetype_decoration_width(dir_entry->type);
-		view->max_filename_len = MAX(view->max_filename_len, name_len);
 	}
-	while(FindNextFileA(hfind, &ffd));
-	FindClose(hfind);
 
-	/* Not all Windows file systems contain or show dot directories. */
-	if(!with_parent_dir && parent_dir_is_visible(is_root))
+	return NULL;
+}
+
+/* Queries file system for information about single entry located at the
+ * path. */
+static void
+fill_entry_info(const char path[], dir_entry_t *entry)
+{
+	finish_entry_info(path, entry, query_entry_info(path, entry));
+}
+
+/* Fills information about single entry located at the path, which is available
+ * from lstat().  Is safe to call from multiple threads for different entries.
+ * Returns errno on failure, otherwise zero is returned. */
+static int
+query_entry_info(const char path[], dir_entry_t *entry)
+{
+	struct stat s;
+	FileType type;
+
+	if(lstat(path, &s) != 0)
 	{
-		add_parent_dir(view);
-		with_parent_dir = 1;
+		const int error = errno;
+
+		entry->size = 0;
+		entry->mode = 0;
+		entry->uid = -1;
+		entry->gid = -1;
+		entry->mtime = 0;
+		entry->atime = 0;
+		entry->ctime = 0;
+		return error;
 	}
 
-#endif
+	type = get_type_from_mode(s.st_mode);
+	if(type != UNKNOWN)
+	{
+		entry->type = type;
+	}
+	entry->size = (uintmax_t)s.st_size;
+	entry->mode = s.st_mode;
+	entry->uid = s.st_uid;
+	entry->gid = s.st_gid;
+	entry->mtime = s.st_mtime;
+	entry->atime = s.st_atime;
+	entry->ctime = s.st_ctime;
+	return 0;
+}
 
-	if(!with_parent_dir && !is_root)
+/* Completes information about the entry after query_entry_info() finished with
+ * the error.  Does what isn't safe to do from several threads: logging and
+ * resolution of symbolic links, which looks up mount points. */
+static void
+finish_entry_info(const char path[], dir_entry_t *entry, int error)
+{
+	if(error != 0)
 	{
-		if((cfg.dot_dirs & DD_NONROOT_PARENT) || view->list_rows == 0)
+		LOG_SERROR_MSG(error, "Can't lstat() \"%s\"", path);
+		log_cwd();
+	}
+
+	entry->link_type = SLT_UNKNOWN;
+	entry->link_broken = 0;
+	if(entry->type == LINK)
+	{
+		struct stat st;
+
+		/* Assume that targets on slow file system are not broken as actual check
+		 * might take long time. */
+		entry->link_type = get_symlink_type(path);
+		if(entry->link_type != SLT_SLOW)
 		{
-			add_parent_dir(view);
+			if(stat(path, &st) == 0)
+			{
+				entry->mode = st.st_mode;
+			}
+			else
+			{
+				entry->link_broken = 1;
+			}
 		}
 	}
+}
+
+/* Accounts entries of the view starting at the from index in the maximum file
+ * name length. */
+static void
+update_max_filename_len(FileView *view, int from)
+{
+	int i;
+	for(i = from; i < view->list_rows; ++i)
+	{
+		const dir_entry_t *const entry = &view->dir_entry[i];
+		const size_t name_len = strlen(entry->name)
+		                      + get_filetype_decoration_width(entry->type);
+		view->max_filename_len = MAX(view->max_filename_len, name_len);
+	}
+}
 
+#else
+
+int
+load_dir_list_portion(FileView *view)
+{
+	/* Directories are always read at once. */
 	return 0;
 }
 
+#endif
+
+void
+finish_dir_list_loading(FileView *view)
+{
+	while(load_dir_list_portion(view) != 0)
+	{
+		/* Do nothing. */
+	}
+}
+
 /* Checks whether file/directory passes filename filters of the view.  Returns
  * non-zero if given filename passes filter and should be visible, otherwise
  * zero is returned, in which case the file should be hidden. */
@@ -2766,6 +3538,15 @@ populate_dir_list_internal(FileView *view, int reload)
 {
 	int old_list = view->list_rows;
 	int need_free = (view->selected_filelist == NULL);
+	dir_entry_t *old_entries = NULL;
+	/* Initial loading and reloading of partially read directory don't differ
+	 * from reading new directory. */
+	int first_load = !is_dir_list_loaded(view);
+	int is_big;
+
+#ifndef _WIN32
+	first_load |= stop_dir_list_loading(view);
+#endif
 
 	view->filtered = 0;
 
@@ -2775,7 +3556,8 @@ populate_dir_list_internal(FileView *view, int reload)
 		return 1;
 	}
 
-	if(!reload && is_dir_big(view->curr_dir))
+	is_big = (!reload || first_load) && is_dir_big(view->curr_dir);
+	if(is_big)
 	{
 		if(!vle_mode_is(CMDLINE_MODE))
 		{
@@ -2795,7 +3577,16 @@ populate_dir_list_internal(FileView *view, int reload)
 		return 1;
 	}
 
-	if(reload && view->selected_files > 0 && view->selected_filelist == NULL)
+	/* On reload previous list is merged with the new one instead of capturing
+	 * and restoring selection by file names. */
+	if(reload && view->dir_entry != NULL && old_list > 0 &&
+			view->dir_entry[0].name != NULL)
+	{
+		old_entries = view->dir_entry;
+		view->dir_entry = NULL;
+	}
+	else if(reload && view->selected_files > 0 &&
+			view->selected_filelist == NULL)
 	{
 		capture_selection(view);
 	}
@@ -2814,11 +3605,13 @@ populate_dir_list_internal(FileView *view, int reload)
 	view->dir_entry = malloc(sizeof(dir_entry_t));
 	if(view->dir_entry == NULL)
 	{
+		/* Leave list of files untouched. */
+		view->dir_entry = old_entries;
 		show_error_msg("Memory Error", "Unable to allocate enough memory.");
 		return 1;
 	}
 
-	if(fill_dir_list(view) != 0)
+	if(fill_dir_list(view, is_big) != 0)
 	{
 		/* we don't have read access, only execute, or there were other problems */
 		/* all memory from file names was released in a loop above */
@@ -2826,7 +3619,14 @@ populate_dir_list_internal(FileView *view, int reload)
 		add_parent_dir(view);
 	}
 
-	sort_dir_list(!reload, view);
+	if(old_entries != NULL)
+	{
+		merge_dir_lists(view, old_entries, old_list);
+	}
+	else
+	{
+		sort_dir_list(!reload, view);
+	}
 
 	if(!reload && !vle_mode_is(CMDLINE_MODE))
 	{
@@ -2850,7 +3650,14 @@ populate_dir_list_internal(FileView *view, int reload)
 		return 1;
 	}
 
-	if(reload && view->selected_files != 0)
+	if(old_entries != NULL)
+	{
+		if(view->selected_filelist == NULL)
+		{
+			recount_selected_files(view);
+		}
+	}
+	else if(reload && view->selected_files != 0)
 	{
 		reset_selected_files(view, need_free);
 	}
@@ -2862,6 +3669,153 @@ populate_dir_list_internal(FileView *view, int reload)
 	return 0;
 }
 
+/* Merges freshly read and not yet sorted list of files of the view with its
+ * previous list, which is sorted.  Entries present in both lists retain their
+ * state (selection and search match) and relative order, so only new entries
+ * are sorted, unless changes of files invalidated previous order.  Cursor stays
+ * on the same file if it still exists.  Frees previous list. */
+static void
+merge_dir_lists(FileView *view, dir_entry_t *old, int old_count)
+{
+	const int count = view->list_rows;
+	dir_entry_t **const by_name = malloc(sizeof(*by_name)*count);
+	char *const matched = calloc(count, 1);
+	dir_entry_t *const merged = malloc(sizeof(*merged)*count);
+	/* Name of file under cursor in the new list, it's not moved by sorting. */
+	const char *cursor_name = NULL;
+	int nkept = 0;
+	int nadded;
+	int ordered = 1;
+	int i;
+
+	if(by_name == NULL || matched == NULL || merged == NULL)
+	{
+		free(by_name);
+		free(matched);
+		free(merged);
+		sort_dir_list(0, view);
+		for(i = 0; i < old_count; ++i)
+		{
+			free(old[i].name);
+		}
+		free(old);
+		return;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		by_name[i] = &view->dir_entry[i];
+	}
+	qsort(by_name, count, sizeof(*by_name), &entry_name_cmp);
+
+	/* Collect entries that are still present in order of previous list. */
+	for(i = 0; i < old_count; ++i)
+	{
+		const dir_entry_t key = { .name = old[i].name };
+		const dir_entry_t *const key_ptr = &key;
+		dir_entry_t **const found = bsearch(&key_ptr, by_name, count,
+				sizeof(*by_name), &entry_name_cmp);
+		if(found != NULL)
+		{
+			dir_entry_t *const entry = &merged[nkept];
+			*entry = **found;
+			entry->selected = old[i].selected;
+			entry->search_match = old[i].search_match;
+			matched[*found - view->dir_entry] = 1;
+
+			if(i == view->list_pos)
+			{
+				cursor_name = entry->name;
+			}
+
+			if(ordered && nkept != 0 &&
+					sort_compare_entries(view, entry - 1, entry) > 0)
+			{
+				ordered = 0;
+			}
+			++nkept;
+		}
+		free(old[i].name);
+	}
+	free(old);
+
+	/* Append new entries. */
+	nadded = 0;
+	for(i = 0; i < count; ++i)
+	{
+		if(!matched[i])
+		{
+			merged[nkept + nadded++] = view->dir_entry[i];
+		}
+	}
+
+	if(!ordered)
+	{
+		memcpy(view->dir_entry, merged, sizeof(*merged)*count);
+		sort_dir_list(0, view);
+	}
+	else
+	{
+		dir_entry_t *kept = merged;
+		dir_entry_t *const kept_end = merged + nkept;
+		dir_entry_t *added = kept_end;
+		dir_entry_t *const added_end = merged + count;
+		dir_entry_t *out = view->dir_entry;
+
+		sort_entries(view, added, nadded);
+
+		while(kept != kept_end && added != added_end)
+		{
+			if(sort_compare_entries(view, kept, added) <= 0)
+			{
+				*out++ = *kept++;
+			}
+			else
+			{
+				*out++ = *added++;
+			}
+		}
+		while(kept != kept_end)
+		{
+			*out++ = *kept++;
+		}
+		while(added != added_end)
+		{
+			*out++ = *added++;
+		}
+	}
+
+	free(merged);
+	free(matched);
+	free(by_name);
+
+	if(cursor_name != NULL)
+	{
+		for(i = 0; i < count; ++i)
+		{
+			if(view->dir_entry[i].name == cursor_name)
+			{
+				view->list_pos = i;
+				break;
+			}
+		}
+	}
+	else if(view->list_pos >= count)
+	{
+		view->list_pos = MAX(0, count - 1);
+	}
+}
+
+/* Compares names of two entries specified by pointers to pointers to them for
+ * qsort() and bsearch(). */
+static int
+entry_name_cmp(const void *one, const void *two)
+{
+	const dir_entry_t *const first = *(const dir_entry_t **)one;
+	const dir_entry_t *const second = *(const dir_entry_t **)two;
+	return strcmp(first->name, second->name);
+}
+
 /* Checks for subjectively relative size of a directory specified by the path
  * parameter.  Returns non-zero if size of the directory in question is
  * considered to be big. */
@@ -2984,6 +3938,8 @@ add_parent_dir(FileView *view)
 	dir_entry->search_match = 0;
 
 	dir_entry->type = DIRECTORY;
+	dir_entry->link_type = SLT_UNKNOWN;
+	dir_entry->link_broken = 0;
 
 	/* Load the inode info */
 	if(lstat(dir_entry->name, &s) != 0)
@@ -3107,7 +4063,11 @@ local_filter_set(FileView *view, const char filter[])
 static int
 load_unfiltered_list(FileView *const view)
 {
-	int current_file_pos = view->list_pos;
+	int current_file_pos;
+
+	/* Filtering needs full list of files. */
+	finish_dir_list_loading(view);
+	current_file_pos = view->list_pos;
 
 	view->local_filter.in_progress = 1;
 
@@ -3299,59 +4259,308 @@ local_filter_cancel(FileView *view)
 static void
 update_filtering_lists(FileView *view, int add, int clear)
 {
-	size_t i;
-	size_t list_size = 0U;
+	const size_t *matches;
+	size_t count;
 
-	for(i = 0; i < view->local_filter.unfiltered_count; i++)
-	{
-		/* FIXME: some very long file names won't be matched against some
-		 * regexps. */
-		char name_with_slash[NAME_MAX + 1 + 1];
+	update_local_filter_matches(view);
 
-		const dir_entry_t *const entry = &view->local_filter.unfiltered[i];
-		const char *name = entry->name;
+	matches = view->local_filter.matches;
+	count = view->local_filter.matches_count;
 
-		if(is_parent_dir(name))
+	if(clear)
+	{
+		size_t i, j = 0U;
+		for(i = 0U; i < view->local_filter.unfiltered_count; ++i)
 		{
-			if(add && parent_dir_is_visible(is_root_dir(view->curr_dir)))
+			if(j < count && matches[j] == i)
+			{
+				++j;
+			}
+			else if(!is_parent_dir(view->local_filter.unfiltered[i].name))
 			{
-				(void)add_dir_entry(&view->dir_entry, &list_size, entry);
+				free(view->local_filter.unfiltered[i].name);
 			}
+		}
+	}
+
+	if(add)
+	{
+		size_t i;
+		dir_entry_t *const list = realloc(view->dir_entry,
+				sizeof(dir_entry_t)*MAX(count, 1U));
+		if(list == NULL)
+		{
+			return;
+		}
+		view->dir_entry = list;
+
+		for(i = 0U; i < count; ++i)
+		{
+			list[i] = view->local_filter.unfiltered[matches[i]];
+		}
+
+		view->list_rows = count;
+		view->filtered = view->local_filter.unfiltered_count - count;
+
+		if(count == 0U)
+		{
+			add_parent_dir(view);
+		}
+	}
+}
+
+/* Updates list of positions of entries in unfiltered list that match local
+ * filter.  When new value of the filter refines the one that produced current
+ * list, only entries of that list are checked. */
+static void
+update_local_filter_matches(FileView *view)
+{
+	const filter_t *const filter = &view->local_filter.filter;
+	filter_chunk_t chunk = {
+		.entries = view->local_filter.unfiltered,
+		.regex = filter->is_regex_valid ? &filter->regex : NULL,
+		.show_parent = parent_dir_is_visible(is_root_dir(view->curr_dir)),
+	};
+
+	if(view->local_filter.matched != NULL &&
+			strcmp(view->local_filter.matched, filter->raw) == 0 &&
+			view->local_filter.matched_cflags == filter->cflags)
+	{
+		/* Nothing has changed. */
+		return;
+	}
+
+	if(local_filter_is_refined(view))
+	{
+		chunk.positions = view->local_filter.matches;
+		chunk.count = view->local_filter.matches_count;
+	}
+	else
+	{
+		const size_t total = view->local_filter.unfiltered_count;
+		size_t *const positions = realloc(view->local_filter.matches,
+				sizeof(*positions)*MAX(total, 1U));
+		size_t i;
+
+		if(positions == NULL)
+		{
+			free(view->local_filter.matched);
+			view->local_filter.matched = NULL;
+			view->local_filter.matches_count = 0U;
+			return;
+		}
+
+		for(i = 0U; i < total; ++i)
+		{
+			positions[i] = i;
+		}
+
+		chunk.positions = positions;
+		chunk.count = total;
+	}
+
+#ifndef _WIN32
+	if(chunk.regex != NULL && chunk.count >= MIN_PARALLEL_FILTER_ENTRIES)
+	{
+		match_candidates_in_parallel(&chunk, filter);
+	}
+	else
+#endif
+	{
+		match_chunk(&chunk);
+	}
+
+	view->local_filter.matches = chunk.positions;
+	view->local_filter.matches_count = chunk.count;
+	(void)replace_string(&view->local_filter.matched, filter->raw);
+	view->local_filter.matched_cflags = filter->cflags;
+}
+
+/* Checks whether every name that matches current value of local filter also
+ * matches value that produced current list of matches, which is the case when
+ * valid regular expression is extended with literal characters.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+local_filter_is_refined(const FileView *view)
+{
+	/* Characters that can't change meaning of preceding part of an extended
+	 * regular expression and have no special meaning on their own. */
+	static const char LITERALS[] = "abcdefghijklmnopqrstuvwxyz"
+	                               "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	                               "0123456789 _-~/,:;=@#%&!'\"<>";
+
+	const filter_t *const filter = &view->local_filter.filter;
+	const char *const matched = view->local_filter.matched;
+	const char *suffix;
+	size_t matched_len;
+
+	if(matched == NULL || !filter->is_regex_valid)
+	{
+		return 0;
+	}
+
+	/* Dropping case insensitivity can only decrease number of matches. */
+	if((filter->cflags & ~REG_ICASE) !=
+			(view->local_filter.matched_cflags & ~REG_ICASE) ||
+			((filter->cflags & REG_ICASE) &&
+			 !(view->local_filter.matched_cflags & REG_ICASE)))
+	{
+		return 0;
+	}
+
+	matched_len = strlen(matched);
+	if(strncmp(filter->raw, matched, matched_len) != 0)
+	{
+		return 0;
+	}
+
+	for(suffix = filter->raw + matched_len; *suffix != '\0'; ++suffix)
+	{
+		/* Bytes of multibyte characters are treated as literals as well. */
+		if((unsigned char)*suffix < 0x80 && strchr(LITERALS, *suffix) == NULL)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+#ifndef _WIN32
+/* Same as match_chunk(), but splits candidates into several parts and
+ * processes them in separate threads.  Each thread uses its own copy of the
+ * regular expression, because regexec() might serialize calls on the same
+ * one. */
+static void
+match_candidates_in_parallel(filter_chunk_t *chunk, const filter_t *filter)
+{
+	filter_chunk_t chunks[MAX_FILTER_WORKERS];
+	regex_t regexes[MAX_FILTER_WORKERS];
+	int compiled[MAX_FILTER_WORKERS];
+	pthread_t threads[MAX_FILTER_WORKERS];
+	int started[MAX_FILTER_WORKERS];
+	const long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const int nchunks = (int)MIN(MAX(ncpus, 1L), (long)MAX_FILTER_WORKERS);
+	const size_t chunk_size = (chunk->count + nchunks - 1)/nchunks;
+	size_t count;
+	int i;
+
+	if(nchunks == 1)
+	{
+		match_chunk(chunk);
+		return;
+	}
+
+	for(i = 0; i < nchunks; ++i)
+	{
+		const size_t from = MIN(i*chunk_size, chunk->count);
+		const size_t to = MIN(from + chunk_size, chunk->count);
+
+		chunks[i] = *chunk;
+		chunks[i].positions = chunk->positions + from;
+		chunks[i].count = to - from;
+
+		/* The first chunk is processed by the current thread. */
+		started[i] = 0;
+		compiled[i] = 0;
+		if(i == 0)
+		{
 			continue;
 		}
 
-		if(is_directory_entry(entry))
+		compiled[i] = (regcomp(&regexes[i], filter->raw, filter->cflags) == 0);
+		if(compiled[i])
 		{
-			append_slash(name, name_with_slash, sizeof(name_with_slash));
-			name = name_with_slash;
+			chunks[i].regex = &regexes[i];
 		}
+		started[i] = (pthread_create(&threads[i], NULL, &filter_worker,
+					&chunks[i]) == 0);
+	}
 
-		if(filter_matches(&view->local_filter.filter, name) != 0)
+	count = 0U;
+	for(i = 0; i < nchunks; ++i)
+	{
+		if(i == 0 || !started[i])
 		{
-			if(add)
-			{
-				(void)add_dir_entry(&view->dir_entry, &list_size, entry);
-			}
+			match_chunk(&chunks[i]);
 		}
 		else
 		{
-			if(clear)
-			{
-				free(entry->name);
-			}
+			(void)pthread_join(threads[i], NULL);
+		}
+
+		if(compiled[i])
+		{
+			regfree(&regexes[i]);
 		}
+
+		memmove(chunk->positions + count, chunks[i].positions,
+				sizeof(*chunk->positions)*chunks[i].count);
+		count += chunks[i].count;
 	}
 
-	if(add)
-	{
-		view->list_rows = list_size;
-		view->filtered = view->local_filter.unfiltered_count - list_size;
+	chunk->count = count;
+}
+
+/* Entry point of a thread that matches part of candidates against local
+ * filter.  Returns NULL. */
+static void *
+filter_worker(void *arg)
+{
+	match_chunk(arg);
+	return NULL;
+}
+#endif
+
+/* Matches candidates of the chunk moving matching ones to the front of its
+ * list of positions. */
+static void
+match_chunk(filter_chunk_t *chunk)
+{
+	size_t i;
+	size_t count = 0U;
 
-		if(list_size == 0U)
+	for(i = 0U; i < chunk->count; ++i)
+	{
+		const size_t pos = chunk->positions[i];
+		if(local_filter_matches(&chunk->entries[pos], chunk->regex,
+					chunk->show_parent))
 		{
-			add_parent_dir(view);
+			chunk->positions[count++] = pos;
 		}
 	}
+
+	chunk->count = count;
+}
+
+/* Checks whether entry of unfiltered list passes local filter.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+local_filter_matches(const dir_entry_t *entry, const regex_t *regex,
+		int show_parent)
+{
+	/* FIXME: some very long file names won't be matched against some
+	 * regexps. */
+	char name_with_slash[NAME_MAX + 1 + 1];
+	const char *name = entry->name;
+
+	if(is_parent_dir(name))
+	{
+		return show_parent;
+	}
+
+	if(regex == NULL)
+	{
+		return 1;
+	}
+
+	if(is_directory_entry(entry))
+	{
+		append_slash(name, name_with_slash, sizeof(name_with_slash));
+		name = name_with_slash;
+	}
+
+	return regexec(regex, name, 0, NULL, 0) == 0;
 }
 
 /* Appends slash to the name and stores result in the buffer. */
@@ -3374,6 +4583,12 @@ local_filter_finish(FileView *view)
 	free(view->local_filter.poshist);
 	view->local_filter.poshist = NULL;
 	view->local_filter.poshist_len = 0U;
+
+	free(view->local_filter.matches);
+	view->local_filter.matches = NULL;
+	view->local_filter.matches_count = 0U;
+	free(view->local_filter.matched);
+	view->local_filter.matched = NULL;
 }
 
 void
@@ -3390,21 +4605,32 @@ local_filter_restore(FileView *view)
 	(void)replace_string(&view->local_filter.prev, "");
 }
 
-/* Adds new entry to the *list of length *list_size and updates them
- * appropriately.  Returns zero on success, otherwise non-zero is returned. */
+/* Makes sure that *list, which has room for *capacity entries, can hold at
+ * least required entries.  The list grows geometrically, so that filling it
+ * one entry at a time takes linear time.  Returns zero on success, otherwise
+ * non-zero is returned. */
 static int
-add_dir_entry(dir_entry_t **list, size_t *list_size, const dir_entry_t *entry)
+reserve_dir_entries(dir_entry_t **list, size_t *capacity, size_t required)
 {
-	dir_entry_t *const new_entry_list = realloc(*list,
-			sizeof(dir_entry_t)*(*list_size + 1));
-	if(new_entry_list == NULL)
+	dir_entry_t *new_list;
+	size_t new_capacity;
+
+	if(required <= *capacity)
+	{
+		return 0;
+	}
+
+	new_capacity = MAX(*capacity*2U, (size_t)DIR_ENTRIES_MIN_CAPACITY);
+	new_capacity = MAX(new_capacity, required);
+
+	new_list = realloc(*list, sizeof(dir_entry_t)*new_capacity);
+	if(new_list == NULL)
 	{
 		return 1;
 	}
 
-	*list = new_entry_list;
-	new_entry_list[*list_size] = *entry;
-	++*list_size;
+	*list = new_list;
+	*capacity = new_capacity;
 	return 0;
 }
 
@@ -3470,6 +4696,26 @@ check_if_filelists_have_changed(FileView *view)
 		return;
 	}
 
+#ifndef _WIN32
+	/* Changes are checked after directory is read completely. */
+	if(view->loading.dir != NULL)
+	{
+		return;
+	}
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+	/* Fall back to checking modification time if directory isn't watched. */
+	switch(process_dir_events(view))
+	{
+		case 0:
+			return;
+		case 1:
+			reload_window(view);
+			return;
+	}
+#endif
+
 #ifndef _WIN32
 	struct stat s;
 	if(stat(view->curr_dir, &s) != 0)
@@ -3639,6 +4885,8 @@ ensure_file_is_selected(FileView *view, const char name[])
 	copy_str(nm, sizeof(nm), name);
 	chosp(nm);
 
+	finish_dir_list_loading(view);
+
 	file_pos = find_file_pos_in_list(view, nm);
 	if(file_pos < 0 && file_can_be_displayed(view->curr_dir, nm))
 	{
@@ -3822,7 +5070,7 @@ int
 is_directory_entry(const dir_entry_t *entry)
 {
 	return (entry->type == DIRECTORY)
-	    || (entry->type == LINK && get_symlink_type(entry->name) != SLT_UNKNOWN);
+	    || (entry->type == LINK && entry->link_type != SLT_UNKNOWN);
 }
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
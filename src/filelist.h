@@ -226,6 +226,13 @@ void populate_dir_list(FileView *view, int reload);
 /* Loads file list for the view and redraws the view.  The reload parameter
  * should be set in case of view refresh operation. */
 void load_dir_list(FileView *view, int reload);
+/* Reads next portion of a large directory, which is displayed before it's
+ * fully loaded.  Sorts the list once the whole directory is read.  Returns
+ * non-zero if there is more to read, otherwise zero is returned. */
+int load_dir_list_portion(FileView *view);
+/* Reads the rest of a partially loaded directory, if any.  Should precede
+ * operations that need the whole list or remember positions in it. */
+void finish_dir_list_loading(FileView *view);
 /* Resorts view without reloading it and preserving currently file under cursor
  * along with its relative position in the list.  msg parameter controls whether
  * to show "Sorting..." statusbar message. */
@@ -38,9 +38,11 @@
 #include <errno.h> /* errno */
 #include <stddef.h> /* NULL size_t */
 #include <stdint.h> /* uint64_t */
-#include <stdio.h> /* snprintf() */
-#include <stdlib.h> /* free() malloc() strtol() */
-#include <string.h> /* memcmp() memset() strcpy() strdup() strerror() */
+#include <inttypes.h> /* PRIu64 SCNu64 */
+#include <stdio.h> /* FILE fclose() fopen() fprintf() snprintf() sscanf() */
+#include <stdlib.h> /* free() malloc() qsort() realloc() strtol() */
+#include <string.h> /* memcmp() memset() strchr() strcpy() strdup() strerror() */
+#include <time.h> /* time() time_t */
 
 #include "cfg/config.h"
 #include "io/ioeta.h"
@@ -50,13 +52,16 @@
 #ifdef _WIN32
 #include "utils/env.h"
 #endif
+#include "utils/file_streams.h"
 #include "utils/fs.h"
 #include "utils/fs_limits.h"
+#include "utils/log.h"
 #include "utils/macros.h"
 #include "utils/path.h"
 #include "utils/str.h"
 #include "utils/string_array.h"
 #include "utils/tree.h"
+#include "utils/trie.h"
 #include "utils/test_helpers.h"
 #include "utils/utils.h"
 #include "background.h"
@@ -106,18 +111,99 @@ typedef struct
 }
 bg_args_t;
 
+/* Information about directory that allows reusing sum of sizes of its files
+ * while the directory isn't changed. */
+typedef struct
+{
+	char *path;               /* Path to the directory. */
+	uint64_t own_size;        /* Size of files (not directories) in it. */
+	time_t mtime;             /* Modification time of the directory. */
+	uint64_t inode;           /* Inode number of the directory. */
+	unsigned long long stamp; /* Order of updates, larger is newer. */
+}
+dir_size_rec_t;
+
+/* Size and number of files of a directory tree along with state of its root
+ * at the moment they were calculated. */
+typedef struct
+{
+	uint64_t size;  /* Size of files of the tree. */
+	uint64_t items; /* Number of files (not directories) in the tree. */
+	time_t mtime;   /* Modification time of the root. */
+	uint64_t inode; /* Inode number of the root. */
+}
+dir_estimate_t;
+
+/* Estimates of directory trees calculated by ga/gA for file operations. */
+static struct
+{
+	trie_t index;         /* Maps paths to estimates. */
+	pthread_mutex_t lock; /* Protects the structure from background jobs. */
+}
+dir_estimates = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Known sizes of directories, which are kept between sessions. */
+static struct
+{
+	dir_size_rec_t **recs;    /* Records, not necessarily ordered. */
+	int count;                /* Number of records. */
+	trie_t index;             /* Maps paths to records. */
+	unsigned long long stamp; /* Last used stamp. */
+	pthread_mutex_t lock;     /* Protects the structure from background jobs. */
+}
+dir_sizes = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Maximum number of threads that calculate sizes of directories of a single
+ * background task. */
+#define MAX_DIR_SIZE_WORKERS 64
+
 /* Arguments pack for dir_size_bg() background function. */
 typedef struct
 {
-	char *path; /* Full path to directory to process, will be freed. */
-	int force;  /* Whether cached values should be ignored. */
+	char **paths; /* Full paths to directories to process, will be freed. */
+	int count;    /* Number of elements in paths array. */
+	int force;    /* Whether cached values should be ignored. */
 }
 dir_size_args_t;
 
+/* Directory of a tree whose size is being calculated. */
+typedef struct dir_size_node_t
+{
+	char *path;                     /* Full path to the directory. */
+	struct dir_size_node_t *parent; /* Parent node or NULL for the root. */
+	struct dir_size_node_t *next;   /* Next node in the queue of work. */
+	uint64_t size;                  /* Size accumulated so far. */
+	uint64_t items;                 /* Number of files accumulated so far. */
+	int items_known;                /* Whether all files are counted. */
+	int pending;                    /* Number of unfinished parts: reading of
+	                                   the directory and its subdirectories. */
+	int stat_ok;                    /* Whether mtime and inode are set. */
+	time_t mtime;                   /* Modification time of the directory. */
+	uint64_t inode;                 /* Inode number of the directory. */
+}
+dir_size_node_t;
+
+/* State shared among threads of a single directory size calculation. */
+typedef struct
+{
+	dir_size_node_t *queue; /* Stack of directories waiting to be read. */
+	int active;             /* Number of directories being read right now. */
+	int force;              /* Whether cached values should be ignored. */
+	job_t *job;             /* Job to report progress to. */
+	pthread_mutex_t lock;   /* Protects the structure and all nodes. */
+	pthread_cond_t cond;    /* Signaled on new work and on finishing it. */
+}
+dir_size_pool_t;
+
 static void io_progress_changed(const io_progress_t *const progress);
 static void format_pretty_path(const char base_dir[], const char path[],
 		char pretty[], size_t pretty_size);
 static int prepare_register(int reg);
+static void open_trash_dirs(const char dir[], const char trash_dir[],
+		int *dirfd, int *trash_dirfd);
+static void close_trash_dirs(int dirfd, int trash_dirfd);
+static int rename_to_trash(int dirfd, const char fname[], int trash_dirfd,
+		const char trash_dir[], const char src[], const char dst[]);
 static void delete_files_in_bg(void *arg);
 static void delete_files_bg_i(const char curr_dir[], char *list[], int count,
 		int use_trash);
@@ -143,7 +229,6 @@ static void clone_file(FileView* view, const char filename[], const char path[],
 		const char clone[], ops_t *ops);
 static void put_decide_cb(const char dest_name[]);
 static void put_continue(int force);
-static int is_dir_entry(const char full_path[], const struct dirent* dentry);
 static int initiate_put_files_from_register(FileView *view, OPS op,
 		const char descr[], int reg_name, int force_move, int link);
 static void reset_put_confirm(OPS main_op, const char descr[],
@@ -162,11 +247,30 @@ static void progress_msg(const char text[], int ready, int total);
 static void cpmv_in_bg(void *arg);
 static void general_prepare_for_bg_task(FileView *view, bg_args_t *args);
 static const char * get_cancellation_suffix(void);
-static void update_dir_entry_size(const FileView *view, int index, int force);
-static void start_dir_size_calc(const char path[], int force);
+static int add_dir_entry_path(const FileView *view, int index, char ***paths,
+		int *count);
+static void start_dir_size_calc(char *paths[], int count, int force);
 static void dir_size_bg(void *arg);
-static uint64_t calc_dirsize(const char path[], int force_update);
+static int queue_dir_size_node(dir_size_pool_t *pool, dir_size_node_t *parent,
+		const char path[]);
+static void * dir_size_worker(void *arg);
+static void read_dir_for_size(dir_size_pool_t *pool, dir_size_node_t *node);
+static int query_dir_entry(DIR *dir, const char path[],
+		const struct dirent *dentry, uint64_t *size);
+static void finish_dir_size_node(dir_size_pool_t *pool, dir_size_node_t *node,
+		uint64_t size, uint64_t items, int items_known);
+static int lookup_dir_estimate(const char path[], dir_estimate_t *estimate);
+static void set_dir_estimate(const char path[], const dir_size_node_t *node);
+static void redraw_after_dir_size(const char path[]);
 static void set_dir_size(const char path[], uint64_t size);
+static int get_own_size(const char path[], const struct stat *s,
+		uint64_t *size);
+static void set_own_size(const char path[], const struct stat *s,
+		uint64_t size);
+static dir_size_rec_t * get_dir_size_rec(const char path[], int create);
+static void trim_dir_sizes(int limit);
+static void drop_dir_sizes(void);
+static int dir_size_rec_stamp_cmp(const void *first, const void *second);
 
 void
 init_fileops(void)
@@ -194,12 +298,12 @@ io_progress_changed(const io_progress_t *const state)
 	{
 		progress = estim->total_items/PRECISION;
 	}
-	else if(estim->total_bytes == 0)
+	else if(estim->total_bytes == 0 && !estim->in_background)
 	{
 		progress = 0;
 	}
-	else if(prev_progress >= 100*PRECISION &&
-			estim->current_byte == estim->total_bytes)
+	else if(estim->in_background || (prev_progress >= 100*PRECISION &&
+			estim->current_byte == estim->total_bytes))
 	{
 		/* Special handling for unknown total size. */
 		++prev_progress;
@@ -239,7 +343,14 @@ io_progress_changed(const io_progress_t *const state)
 			(void)friendly_size_notation(estim->current_byte,
 					sizeof(current_size_str), current_size_str);
 
-			if(progress < 0)
+			if(estim->in_background)
+			{
+				/* Totals are still being calculated and only grow. */
+				ui_sb_quick_msgf("%s: %d of at least %d; %s of at least %s %s",
+						ops_describe(ops), estim->current_item + 1, estim->total_items,
+						current_size_str, total_size_str, pretty_path);
+			}
+			else if(progress < 0)
 			{
 				/* Simplified message for unknown total size. */
 				ui_sb_quick_msgf("%s: %d of %d; %s %s", ops_describe(ops),
@@ -317,7 +428,7 @@ yank_selected_files(FileView *view, int reg)
 
 		snprintf(buf, sizeof(buf), "%s%s%s", view->curr_dir,
 				ends_with_slash(view->curr_dir) ? "" : "/", view->selected_filelist[i]);
-		append_to_register(reg, buf);
+		append_existing_to_register(reg, buf);
 	}
 	update_unnamed_reg(reg);
 }
@@ -351,6 +462,7 @@ delete_files(FileView *view, int reg, int count, int *indexes, int use_trash)
 	int sel_len;
 	ops_t *ops;
 	char *dst_hint;
+	int dirfd = -1, trash_dirfd = -1;
 
 	if(!check_if_dir_writable(DR_CURRENT, view->curr_dir))
 	{
@@ -399,18 +511,28 @@ delete_files(FileView *view, int reg, int count, int *indexes, int use_trash)
 	sel_len = view->selected_files;
 
 	dst_hint = use_trash ? pick_trash_dir(view->curr_dir) : NULL;
+	if(dst_hint != NULL)
+	{
+		open_trash_dirs(view->curr_dir, dst_hint, &dirfd, &trash_dirfd);
+	}
 
 	for(i = 0; i < sel_len && !ui_cancellation_requested(); ++i)
 	{
 		char full_buf[PATH_MAX];
 		const char *const fname = view->selected_filelist[i];
 
+		/* Moving to trash on the same file system is a single rename per item,
+		 * there is no point in estimating sizes of items. */
+		if(trash_dirfd != -1)
+		{
+			ops_enqueue_cheap(ops);
+			continue;
+		}
+
 		snprintf(full_buf, sizeof(full_buf), "%s/%s", view->curr_dir, fname);
 		ops_enqueue(ops, full_buf, dst_hint);
 	}
 
-	free(dst_hint);
-
 	for(i = 0; i < sel_len && !ui_cancellation_requested(); ++i)
 	{
 		const char *const fname = view->selected_filelist[i];
@@ -434,16 +556,21 @@ delete_files(FileView *view, int reg, int count, int *indexes, int use_trash)
 				char *const dest = gen_trash_name(view->curr_dir, fname);
 				if(dest != NULL)
 				{
-					result = perform_operation(OP_MOVE, ops, NULL, full_buf, dest);
-					/* For some reason "rm" sometimes returns 0 on cancellation. */
-					if(path_exists(full_buf))
+					result = rename_to_trash(dirfd, fname, trash_dirfd, dst_hint,
+							full_buf, dest);
+					if(result != 0)
 					{
-						result = -1;
+						result = perform_operation(OP_MOVE, ops, NULL, full_buf, dest);
+						/* For some reason "rm" sometimes returns 0 on cancellation. */
+						if(path_exists(full_buf))
+						{
+							result = -1;
+						}
 					}
 					if(result == 0)
 					{
 						add_operation(OP_MOVE, NULL, NULL, full_buf, dest);
-						append_to_register(reg, dest);
+						append_existing_to_register(reg, dest);
 					}
 					free(dest);
 				}
@@ -488,6 +615,9 @@ delete_files(FileView *view, int reg, int count, int *indexes, int use_trash)
 	}
 	free_file_capture(view);
 
+	close_trash_dirs(dirfd, trash_dirfd);
+	free(dst_hint);
+
 	update_unnamed_reg(reg);
 
 	cmd_group_end();
@@ -502,6 +632,82 @@ delete_files(FileView *view, int reg, int count, int *indexes, int use_trash)
 	return 1;
 }
 
+/* Opens the directory and trash directory for moving files between them with
+ * renameat().  Leaves descriptors equal to -1 if directories are on different
+ * file systems or can't be opened. */
+static void
+open_trash_dirs(const char dir[], const char trash_dir[], int *dirfd,
+		int *trash_dirfd)
+{
+#ifndef _WIN32
+	struct stat dir_st, trash_st;
+
+	*dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	*trash_dirfd = open(trash_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if(*dirfd == -1 || *trash_dirfd == -1 || fstat(*dirfd, &dir_st) != 0 ||
+			fstat(*trash_dirfd, &trash_st) != 0 || dir_st.st_dev != trash_st.st_dev)
+	{
+		close_trash_dirs(*dirfd, *trash_dirfd);
+		*dirfd = -1;
+		*trash_dirfd = -1;
+	}
+#endif
+}
+
+/* Closes descriptors opened by open_trash_dirs(). */
+static void
+close_trash_dirs(int dirfd, int trash_dirfd)
+{
+#ifndef _WIN32
+	if(dirfd != -1)
+	{
+		(void)close(dirfd);
+	}
+	if(trash_dirfd != -1)
+	{
+		(void)close(trash_dirfd);
+	}
+#endif
+}
+
+/* Moves file to trash directory on the same file system by renaming it.  src
+ * and dst are full paths that correspond to fname and trash name.  Returns
+ * zero on success, otherwise non-zero is returned (e.g. when fname is a mount
+ * point), in which case regular move should be performed. */
+static int
+rename_to_trash(int dirfd, const char fname[], int trash_dirfd,
+		const char trash_dir[], const char src[], const char dst[])
+{
+#ifndef _WIN32
+	const char *const dst_name = after_last(dst, '/');
+	const size_t trash_dir_len = strlen(trash_dir);
+
+	if(trash_dirfd == -1)
+	{
+		return 1;
+	}
+
+	/* Trash name must point to the directory of trash_dirfd. */
+	if((size_t)(dst_name - dst) != trash_dir_len + 1 ||
+			strncmp(dst, trash_dir, trash_dir_len) != 0)
+	{
+		return 1;
+	}
+
+	if(renameat(dirfd, fname, trash_dirfd, dst_name) != 0)
+	{
+		LOG_SERROR_MSG(errno, "Can't rename \"%s\" to \"%s\"", src, dst);
+		return 1;
+	}
+
+	add_to_trash(src, dst);
+	return 0;
+#else
+	return 1;
+#endif
+}
+
 /* Transforms "A-"Z register to "a-"z or clears the reg.  So that for "A-"Z new
  * values will be appended to "a-"z, for other registers old values will be
  * removed.  Returns possibly modified value of the reg parameter. */
@@ -2018,27 +2224,6 @@ clone_file(FileView* view, const char filename[], const char path[],
 	}
 }
 
-/* Uses dentry to check file type and fallbacks to lstat() if dentry contains
- * unknown type. */
-static int
-is_dir_entry(const char full_path[], const struct dirent* dentry)
-{
-#ifndef _WIN32
-	struct stat s;
-	if(dentry->d_type != DT_UNKNOWN)
-	{
-		return dentry->d_type == DT_DIR;
-	}
-	if(lstat(full_path, &s) == 0 && s.st_ino != 0)
-	{
-		return (s.st_mode&S_IFMT) == S_IFDIR;
-	}
-	return 0;
-#else
-	return is_dir(full_path);
-#endif
-}
-
 int
 put_links(FileView *view, int reg_name, int relative)
 {
@@ -3346,11 +3531,16 @@ check_if_dir_writable(DirRole dir_role, const char *path)
 void
 calculate_size(const FileView *view, int force)
 {
+	char **paths = NULL;
+	int count = 0;
 	int i;
 
 	if(!view->dir_entry[view->list_pos].selected && view->user_selection)
 	{
-		update_dir_entry_size(view, view->list_pos, force);
+		if(add_dir_entry_path(view, view->list_pos, &paths, &count) == 0)
+		{
+			start_dir_size_calc(paths, count, force);
+		}
 		return;
 	}
 
@@ -3360,38 +3550,72 @@ calculate_size(const FileView *view, int force)
 
 		if(entry->selected && entry->type == DIRECTORY)
 		{
-			update_dir_entry_size(view, i, force);
+			if(add_dir_entry_path(view, i, &paths, &count) != 0)
+			{
+				free_string_array(paths, count);
+				return;
+			}
 		}
 	}
+
+	if(count != 0)
+	{
+		start_dir_size_calc(paths, count, force);
+	}
 }
 
-/* Initiates background size calculation for view entry. */
-static void
-update_dir_entry_size(const FileView *view, int index, int force)
+/* Appends full path to view entry to the array.  Returns zero on success,
+ * otherwise non-zero is returned and error is displayed. */
+static int
+add_dir_entry_path(const FileView *view, int index, char ***paths, int *count)
 {
 	char full_path[PATH_MAX];
 	const dir_entry_t *const entry = &view->dir_entry[index];
 
 	snprintf(full_path, sizeof(full_path), "%s/%s", view->curr_dir, entry->name);
-	start_dir_size_calc(full_path, force);
+	if(add_to_string_array(paths, *count, 1, full_path) == *count)
+	{
+		show_error_msg("Can't calculate size", "Not enough memory");
+		return 1;
+	}
+
+	++*count;
+	return 0;
 }
 
-/* Initiates background directory size calculation. */
+/* Initiates background calculation of sizes of directories as a single job.
+ * Takes ownership of the paths array. */
 static void
-start_dir_size_calc(const char path[], int force)
+start_dir_size_calc(char *paths[], int count, int force)
 {
 	char task_desc[PATH_MAX];
 	dir_size_args_t *dir_size;
 
 	dir_size = malloc(sizeof(*dir_size));
-	dir_size->path = strdup(path);
+	if(dir_size == NULL)
+	{
+		free_string_array(paths, count);
+		show_error_msg("Can't calculate size", "Not enough memory");
+		return;
+	}
+
+	dir_size->paths = paths;
+	dir_size->count = count;
 	dir_size->force = force;
 
-	snprintf(task_desc, sizeof(task_desc), "Calculating size: %s", path);
+	if(count == 1)
+	{
+		snprintf(task_desc, sizeof(task_desc), "Calculating size: %s", paths[0]);
+	}
+	else
+	{
+		snprintf(task_desc, sizeof(task_desc), "Calculating size: %d directories",
+				count);
+	}
 
-	if(bg_execute(task_desc, BG_UNDEFINED_TOTAL, 0, &dir_size_bg, dir_size) != 0)
+	if(bg_execute(task_desc, count, 0, &dir_size_bg, dir_size) != 0)
 	{
-		free(dir_size->path);
+		free_string_array(dir_size->paths, dir_size->count);
 		free(dir_size);
 
 		show_error_msg("Can't calculate size",
@@ -3399,74 +3623,346 @@ start_dir_size_calc(const char path[], int force)
 	}
 }
 
-/* Entry point for a background task that calculates size of a directory. */
+/* Entry point for a background task that calculates sizes of directories.
+ * Subdirectories are read by a bounded set of threads that take them from
+ * a shared queue, so that both many small and a single large tree are
+ * processed in parallel. */
 static void
 dir_size_bg(void *arg)
 {
 	dir_size_args_t *const dir_size = arg;
+	dir_size_pool_t pool = { .queue = NULL, .active = 0 };
+	pthread_t threads[MAX_DIR_SIZE_WORKERS];
+	const int nworkers = MAX(1, MIN(cfg.stat_workers, MAX_DIR_SIZE_WORKERS));
+	int nstarted;
+	int i;
 
-	(void)calc_dirsize(dir_size->path, dir_size->force);
+	pool.force = dir_size->force;
+	pool.job = bg_get_current_job();
 
-	remove_last_path_component(dir_size->path);
-	if(path_starts_with(lwin.curr_dir, dir_size->path))
+	if(pthread_mutex_init(&pool.lock, NULL) != 0)
 	{
-		ui_view_schedule_redraw(&lwin);
+		free_string_array(dir_size->paths, dir_size->count);
+		free(dir_size);
+		return;
 	}
-	if(path_starts_with(rwin.curr_dir, dir_size->path))
+	if(pthread_cond_init(&pool.cond, NULL) != 0)
 	{
-		ui_view_schedule_redraw(&rwin);
+		pthread_mutex_destroy(&pool.lock);
+		free_string_array(dir_size->paths, dir_size->count);
+		free(dir_size);
+		return;
 	}
 
-	free(dir_size->path);
+	for(i = 0; i < dir_size->count; ++i)
+	{
+		(void)queue_dir_size_node(&pool, NULL, dir_size->paths[i]);
+	}
+	free_string_array(dir_size->paths, dir_size->count);
 	free(dir_size);
+
+	/* Current thread is one of the workers, which guarantees progress even if no
+	 * other thread can be started. */
+	nstarted = 0;
+	for(i = 1; i < nworkers; ++i)
+	{
+		if(pthread_create(&threads[nstarted], NULL, &dir_size_worker, &pool) == 0)
+		{
+			++nstarted;
+		}
+	}
+
+	(void)dir_size_worker(&pool);
+
+	for(i = 0; i < nstarted; ++i)
+	{
+		(void)pthread_join(threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.lock);
 }
 
-/* Calculates size of a directory possibly using cache of known sizes.  Returns
- * size of a directory or zero on error. */
-static uint64_t
-calc_dirsize(const char path[], int force_update)
+/* Adds directory to the queue of directories to be read.  Returns zero on
+ * success, otherwise non-zero is returned. */
+static int
+queue_dir_size_node(dir_size_pool_t *pool, dir_size_node_t *parent,
+		const char path[])
+{
+	dir_size_node_t *const node = malloc(sizeof(*node));
+	if(node == NULL)
+	{
+		return 1;
+	}
+
+	node->path = strdup(path);
+	if(node->path == NULL)
+	{
+		free(node);
+		return 1;
+	}
+
+	node->parent = parent;
+	node->size = 0U;
+	node->items = 0U;
+	node->items_known = 1;
+	node->pending = 1;
+	node->stat_ok = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	if(parent != NULL)
+	{
+		++parent->pending;
+	}
+	node->next = pool->queue;
+	pool->queue = node;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+/* Entry point of a thread that reads directories from the queue until there is
+ * nothing left to read.  Returns NULL. */
+static void *
+dir_size_worker(void *arg)
+{
+	dir_size_pool_t *const pool = arg;
+
+	bg_set_current_job(pool->job);
+
+	pthread_mutex_lock(&pool->lock);
+	while(1)
+	{
+		dir_size_node_t *node;
+
+		/* Directories being read can produce more work. */
+		while(pool->queue == NULL && pool->active != 0)
+		{
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		}
+
+		if(pool->queue == NULL)
+		{
+			break;
+		}
+
+		node = pool->queue;
+		pool->queue = node->next;
+		++pool->active;
+		pthread_mutex_unlock(&pool->lock);
+
+		read_dir_for_size(pool, node);
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->active == 0 && pool->queue == NULL)
+		{
+			pthread_cond_broadcast(&pool->cond);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* Reads single directory summing sizes of its files and known sizes of its
+ * subdirectories and queuing the rest of subdirectories. */
+static void
+read_dir_for_size(dir_size_pool_t *pool, dir_size_node_t *node)
 {
 	DIR* dir;
 	struct dirent* dentry;
 	const char* slash = "";
 	uint64_t size;
+	uint64_t own_size;
+	uint64_t items;
+	int items_known;
+	struct stat s;
+	int stat_failed;
+	int own_size_known;
 
-	dir = opendir(path);
+	/* Query information about directory before reading it, so that changes made
+	 * while it's being read are detected on the next calculation. */
+	stat_failed = (stat(node->path, &s) != 0);
+	if(!stat_failed)
+	{
+		node->stat_ok = 1;
+		node->mtime = s.st_mtime;
+		node->inode = s.st_ino;
+	}
+
+	dir = opendir(node->path);
 	if(dir == NULL)
-		return 0;
+	{
+		finish_dir_size_node(pool, node, 0U, 0U, 0);
+		return;
+	}
 
-	if(path[strlen(path) - 1] != '/')
+	if(node->path[strlen(node->path) - 1] != '/')
 		slash = "/";
 
+	own_size = 0;
+	own_size_known = !pool->force && !stat_failed &&
+		get_own_size(node->path, &s, &own_size) == 0;
+
 	size = 0;
+	items = 0;
+	items_known = 1;
 	while((dentry = readdir(dir)) != NULL)
 	{
 		char buf[PATH_MAX];
+		uint64_t file_size = 0U;
 
 		if(is_builtin_dir(dentry->d_name))
 		{
 			continue;
 		}
 
-		snprintf(buf, sizeof(buf), "%s%s%s", path, slash, dentry->d_name);
-		if(is_dir_entry(buf, dentry))
+		snprintf(buf, sizeof(buf), "%s%s%s", node->path, slash, dentry->d_name);
+		if(query_dir_entry(dir, buf, dentry,
+					own_size_known ? NULL : &file_size))
 		{
 			uint64_t dir_size = 0;
-			if(tree_get_data(curr_stats.dirsize_cache, buf, &dir_size) != 0
-					|| force_update)
-				dir_size = calc_dirsize(buf, force_update);
+			dir_estimate_t estimate;
+
+			if(pool->force ||
+					tree_get_data(curr_stats.dirsize_cache, buf, &dir_size) != 0)
+			{
+				if(queue_dir_size_node(pool, node, buf) == 0)
+				{
+					continue;
+				}
+				items_known = 0;
+			}
+			else if(lookup_dir_estimate(buf, &estimate) == 0 &&
+					estimate.size == dir_size)
+			{
+				items += estimate.items;
+			}
+			else
+			{
+				items_known = 0;
+			}
 			size += dir_size;
 		}
 		else
 		{
-			size += get_file_size(buf);
+			own_size += file_size;
+			++items;
 		}
 	}
 
 	closedir(dir);
 
-	set_dir_size(path, size);
-	return size;
+	if(!own_size_known && !stat_failed)
+	{
+		set_own_size(node->path, &s, own_size);
+	}
+
+	finish_dir_size_node(pool, node, size + own_size, items, items_known);
+}
+
+/* Checks whether directory entry is a directory and if it's not and size isn't
+ * NULL, queries its size.  Avoids resolving full path where possible.  Returns
+ * non-zero for directories. */
+static int
+query_dir_entry(DIR *dir, const char path[], const struct dirent *dentry,
+		uint64_t *size)
+{
+#ifndef _WIN32
+	struct stat s;
+
+	if(dentry->d_type == DT_DIR)
+	{
+		return 1;
+	}
+	if(dentry->d_type != DT_UNKNOWN && size == NULL)
+	{
+		return 0;
+	}
+
+	if(fstatat(dirfd(dir), dentry->d_name, &s, AT_SYMLINK_NOFOLLOW) != 0)
+	{
+		return 0;
+	}
+
+	if(S_ISDIR(s.st_mode))
+	{
+		return 1;
+	}
+
+	if(size != NULL)
+	{
+		*size = (uint64_t)s.st_size;
+	}
+	return 0;
+#else
+	if(is_dir(path))
+	{
+		return 1;
+	}
+
+	if(size != NULL)
+	{
+		*size = get_file_size(path);
+	}
+	return 0;
+#endif
+}
+
+/* Adds size and number of files to the node and finishes processing of the
+ * node and its parents if they have no pending work left. */
+static void
+finish_dir_size_node(dir_size_pool_t *pool, dir_size_node_t *node,
+		uint64_t size, uint64_t items, int items_known)
+{
+	pthread_mutex_lock(&pool->lock);
+	node->size += size;
+	node->items += items;
+	node->items_known &= items_known;
+	while(node != NULL && --node->pending == 0)
+	{
+		dir_size_node_t *const parent = node->parent;
+
+		set_dir_size(node->path, node->size);
+		set_dir_estimate(node->path, node);
+
+		if(parent == NULL)
+		{
+			inner_bg_next();
+			redraw_after_dir_size(node->path);
+		}
+		else
+		{
+			parent->size += node->size;
+			parent->items += node->items;
+			parent->items_known &= node->items_known;
+		}
+
+		free(node->path);
+		free(node);
+		node = parent;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* Schedules redraw of views that might display size of the directory. */
+static void
+redraw_after_dir_size(const char path[])
+{
+	char parent[PATH_MAX];
+
+	copy_str(parent, sizeof(parent), path);
+	remove_last_path_component(parent);
+
+	if(path_starts_with(lwin.curr_dir, parent))
+	{
+		ui_view_schedule_redraw(&lwin);
+	}
+	if(path_starts_with(rwin.curr_dir, parent))
+	{
+		ui_view_schedule_redraw(&rwin);
+	}
 }
 
 /* Updates cached directory size in a thread-safe way. */
@@ -3480,5 +3976,372 @@ set_dir_size(const char path[], uint64_t size)
 	pthread_mutex_unlock(&mutex);
 }
 
+int
+get_dir_estimate(const char path[], uint64_t *size, uint64_t *items)
+{
+	struct stat s;
+	dir_estimate_t estimate;
+
+	if(lookup_dir_estimate(path, &estimate) != 0 || stat(path, &s) != 0)
+	{
+		return 1;
+	}
+
+	if(estimate.mtime != s.st_mtime || estimate.inode != (uint64_t)s.st_ino)
+	{
+		return 1;
+	}
+
+	*size = estimate.size;
+	*items = estimate.items;
+	return 0;
+}
+
+/* Looks up estimate of the directory tree without checking whether it's still
+ * valid.  Returns zero and fills *estimate on success, otherwise non-zero is
+ * returned. */
+static int
+lookup_dir_estimate(const char path[], dir_estimate_t *estimate)
+{
+	void *data;
+	int result = 1;
+
+	pthread_mutex_lock(&dir_estimates.lock);
+	if(dir_estimates.index != NULL_TRIE &&
+			trie_get(dir_estimates.index, path, &data) == 0)
+	{
+		*estimate = *(const dir_estimate_t *)data;
+		result = 0;
+	}
+	pthread_mutex_unlock(&dir_estimates.lock);
+
+	return result;
+}
+
+/* Remembers size and number of files of the tree rooted at the node if they
+ * are complete and state of the directory can be trusted later. */
+static void
+set_dir_estimate(const char path[], const dir_size_node_t *node)
+{
+	void *data;
+	dir_estimate_t *estimate;
+
+	/* Changes made within the same second as the last one won't affect
+	 * modification time. */
+	if(!node->items_known || !node->stat_ok || node->mtime >= time(NULL))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&dir_estimates.lock);
+
+	if(dir_estimates.index == NULL_TRIE)
+	{
+		dir_estimates.index = trie_create();
+	}
+
+	if(dir_estimates.index != NULL_TRIE)
+	{
+		if(trie_get(dir_estimates.index, path, &data) == 0)
+		{
+			estimate = data;
+		}
+		else if((estimate = malloc(sizeof(*estimate))) != NULL &&
+				trie_set(dir_estimates.index, path, estimate) != 0)
+		{
+			free(estimate);
+			estimate = NULL;
+		}
+
+		if(estimate != NULL)
+		{
+			estimate->size = node->size;
+			estimate->items = node->items;
+			estimate->mtime = node->mtime;
+			estimate->inode = node->inode;
+		}
+	}
+
+	pthread_mutex_unlock(&dir_estimates.lock);
+}
+
+/* Looks up size of files of the directory calculated previously and checks that
+ * it's still valid for the directory described by s.  Returns zero and sets
+ * *size on success, otherwise non-zero is returned. */
+static int
+get_own_size(const char path[], const struct stat *s, uint64_t *size)
+{
+	const dir_size_rec_t *rec;
+	int result = 1;
+
+	pthread_mutex_lock(&dir_sizes.lock);
+	rec = get_dir_size_rec(path, 0);
+	if(rec != NULL && rec->mtime == s->st_mtime &&
+			rec->inode == (uint64_t)s->st_ino)
+	{
+		*size = rec->own_size;
+		result = 0;
+	}
+	pthread_mutex_unlock(&dir_sizes.lock);
+
+	return result;
+}
+
+/* Remembers size of files of the directory described by s. */
+static void
+set_own_size(const char path[], const struct stat *s, uint64_t size)
+{
+	dir_size_rec_t *rec;
+
+	/* Changes made within the same second as the last one won't affect
+	 * modification time, so such state can't be trusted later. */
+	if(s->st_mtime >= time(NULL) || cfg.dir_size_cache == 0)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&dir_sizes.lock);
+	rec = get_dir_size_rec(path, 1);
+	if(rec != NULL)
+	{
+		rec->own_size = size;
+		rec->mtime = s->st_mtime;
+		rec->inode = s->st_ino;
+		rec->stamp = ++dir_sizes.stamp;
+	}
+	/* Let the number of records grow above the limit a bit to not trim them on
+	 * every update. */
+	if(dir_sizes.count > 2*cfg.dir_size_cache)
+	{
+		trim_dir_sizes(cfg.dir_size_cache);
+	}
+	pthread_mutex_unlock(&dir_sizes.lock);
+}
+
+/* Finds record about the path optionally creating it.  Should be called with
+ * dir_sizes.lock held.  Returns the record or NULL if it's not found or on
+ * memory allocation error. */
+static dir_size_rec_t *
+get_dir_size_rec(const char path[], int create)
+{
+	void *data;
+	dir_size_rec_t *rec;
+	dir_size_rec_t **recs;
+
+	if(dir_sizes.index == NULL_TRIE)
+	{
+		if(!create || (dir_sizes.index = trie_create()) == NULL_TRIE)
+		{
+			return NULL;
+		}
+	}
+
+	if(trie_get(dir_sizes.index, path, &data) == 0)
+	{
+		return data;
+	}
+
+	if(!create)
+	{
+		return NULL;
+	}
+
+	recs = realloc(dir_sizes.recs, sizeof(*recs)*(dir_sizes.count + 1));
+	if(recs == NULL)
+	{
+		return NULL;
+	}
+	dir_sizes.recs = recs;
+
+	rec = calloc(1, sizeof(*rec));
+	if(rec == NULL)
+	{
+		return NULL;
+	}
+
+	rec->path = strdup(path);
+	if(rec->path == NULL || trie_set(dir_sizes.index, path, rec) != 0)
+	{
+		free(rec->path);
+		free(rec);
+		return NULL;
+	}
+
+	dir_sizes.recs[dir_sizes.count++] = rec;
+	return rec;
+}
+
+void
+load_dir_sizes(const char path[])
+{
+	FILE *fp;
+	char *line = NULL;
+
+	if((fp = fopen(path, "r")) == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&dir_sizes.lock);
+	while((line = read_line(fp, line)) != NULL)
+	{
+		uint64_t own_size;
+		long long mtime;
+		uint64_t inode;
+		int path_pos;
+		dir_size_rec_t *rec;
+
+		if(sscanf(line, "%" SCNu64 " %lld %" SCNu64 " %n", &own_size, &mtime,
+					&inode, &path_pos) != 3 || line[path_pos] == '\0')
+		{
+			LOG_ERROR_MSG("Wrong line in %s: %s", path, line);
+			continue;
+		}
+
+		rec = get_dir_size_rec(line + path_pos, 1);
+		if(rec != NULL)
+		{
+			rec->own_size = own_size;
+			rec->mtime = mtime;
+			rec->inode = inode;
+			rec->stamp = ++dir_sizes.stamp;
+		}
+	}
+	if(dir_sizes.count > cfg.dir_size_cache)
+	{
+		trim_dir_sizes(cfg.dir_size_cache);
+	}
+	pthread_mutex_unlock(&dir_sizes.lock);
+
+	free(line);
+	fclose(fp);
+}
+
+void
+save_dir_sizes(const char path[])
+{
+	char tmp_path[PATH_MAX];
+	FILE *fp;
+	int i;
+	int error;
+
+	if(cfg.dir_size_cache == 0)
+	{
+		(void)remove(path);
+		return;
+	}
+
+	/* Write to a temporary file and replace the old one only when everything
+	 * is written, so that failures and concurrent sessions can't leave a
+	 * truncated file behind. */
+	if(snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+			(int)sizeof(tmp_path))
+	{
+		LOG_ERROR_MSG("Path to directory sizes is too long: %s", path);
+		return;
+	}
+	if((fp = fopen(tmp_path, "w")) == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&dir_sizes.lock);
+
+	/* Oldest records go first, so that they are dropped when the limit is
+	 * reached and come first on loading. */
+	trim_dir_sizes(cfg.dir_size_cache);
+
+	for(i = 0; i < dir_sizes.count; ++i)
+	{
+		const dir_size_rec_t *const rec = dir_sizes.recs[i];
+
+		/* Such paths would break line-based format. */
+		if(strchr(rec->path, '\n') != NULL)
+		{
+			continue;
+		}
+
+		fprintf(fp, "%" PRIu64 " %lld %" PRIu64 " %s\n", rec->own_size,
+				(long long)rec->mtime, rec->inode, rec->path);
+	}
+
+	pthread_mutex_unlock(&dir_sizes.lock);
+
+	error = ferror(fp);
+	error |= (fclose(fp) != 0);
+	if(error || rename_file(tmp_path, path) != 0)
+	{
+		LOG_ERROR_MSG("Failed to write directory sizes to %s", path);
+		(void)remove(tmp_path);
+	}
+}
+
+/* Leaves at most limit newest records about directory sizes ordered from the
+ * oldest to the newest.  Should be called with dir_sizes.lock held. */
+static void
+trim_dir_sizes(int limit)
+{
+	const int first = MAX(0, dir_sizes.count - limit);
+	int i;
+
+	qsort(dir_sizes.recs, dir_sizes.count, sizeof(*dir_sizes.recs),
+			&dir_size_rec_stamp_cmp);
+
+	if(first == 0)
+	{
+		return;
+	}
+
+	for(i = 0; i < first; ++i)
+	{
+		free(dir_sizes.recs[i]->path);
+		free(dir_sizes.recs[i]);
+	}
+	dir_sizes.count -= first;
+	memmove(dir_sizes.recs, dir_sizes.recs + first,
+			sizeof(*dir_sizes.recs)*dir_sizes.count);
+
+	/* Trie doesn't support removal of keys, so rebuild it. */
+	trie_free(dir_sizes.index);
+	dir_sizes.index = trie_create();
+	for(i = 0; i < dir_sizes.count; ++i)
+	{
+		if(dir_sizes.index == NULL_TRIE ||
+				trie_set(dir_sizes.index, dir_sizes.recs[i]->path,
+					dir_sizes.recs[i]) != 0)
+		{
+			/* Can't index records, so drop them all. */
+			drop_dir_sizes();
+			return;
+		}
+	}
+}
+
+/* Frees all records about directory sizes.  Should be called with
+ * dir_sizes.lock held. */
+static void
+drop_dir_sizes(void)
+{
+	int i;
+	for(i = 0; i < dir_sizes.count; ++i)
+	{
+		free(dir_sizes.recs[i]->path);
+		free(dir_sizes.recs[i]);
+	}
+	dir_sizes.count = 0;
+
+	trie_free(dir_sizes.index);
+	dir_sizes.index = NULL_TRIE;
+}
+
+/* Orders records about directory sizes from the oldest to the newest. */
+static int
+dir_size_rec_stamp_cmp(const void *first, const void *second)
+{
+	const dir_size_rec_t *const a = *(const dir_size_rec_t **)first;
+	const dir_size_rec_t *const b = *(const dir_size_rec_t **)second;
+	return (a->stamp > b->stamp) - (a->stamp < b->stamp);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 : */
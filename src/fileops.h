@@ -124,6 +124,18 @@ int restore_files(FileView *view);
 /* Initiates background calculation of directory sizes. */
 void calculate_size(const FileView *view, int force);
 
+/* Looks up size and number of files of a directory tree calculated by ga/gA
+ * as long as the directory wasn't modified since then.  Returns zero and sets
+ * *size and *items on success, otherwise non-zero is returned. */
+int get_dir_estimate(const char path[], uint64_t *size, uint64_t *items);
+
+/* Loads information about directory sizes stored by previous sessions. */
+void load_dir_sizes(const char path[]);
+
+/* Stores information about at most 'dirsizecache' most recently calculated
+ * directory sizes for the use by future sessions. */
+void save_dir_sizes(const char path[]);
+
 TSTATIC_DEFS(
 	int is_rename_list_ok(char *files[], int *is_dup, int len, char *list[]);
 	int check_file_rename(const char dir[], const char old[], const char new[],
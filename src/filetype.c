@@ -47,7 +47,8 @@ static assoc_record_type_t new_records_type = ART_CUSTOM;
 static external_command_exists_t external_command_exists_func;
 
 TSTATIC void replace_double_comma(char cmd[], int put_null);
-static int get_filetype_number(const char *file, assoc_list_t assoc_list);
+static int get_filetype_number(const char *file, assoc_list_t assoc_list,
+		int from);
 static void assoc_programs(const char pattern[], const char programs[],
 		int for_x, int in_x);
 static void register_assoc(assoc_t assoc, int for_x, int in_x);
@@ -108,7 +109,7 @@ get_default_program_for_file(const char *file, assoc_record_t *result)
 char *
 get_viewer_for_file(const char file[])
 {
-	int i = get_filetype_number(file, fileviewers);
+	int i = get_filetype_number(file, fileviewers, 0);
 
 	if(i < 0)
 	{
@@ -118,11 +119,20 @@ get_viewer_for_file(const char file[])
 	return fileviewers.list[i].records.list[0].command;
 }
 
+/* Finds first association of the list that matches the file starting with the
+ * from position.  Returns index of the association or -1 if there is no
+ * match. */
 static int
-get_filetype_number(const char *file, assoc_list_t assoc_list)
+get_filetype_number(const char *file, assoc_list_t assoc_list, int from)
 {
 	int i;
-	for(i = 0; i < assoc_list.count; i++)
+
+	if(assoc_list.globs != NULL)
+	{
+		return globs_find(assoc_list.globs, file, from);
+	}
+
+	for(i = from; i < assoc_list.count; i++)
 	{
 		if(global_matches(assoc_list.list[i].pattern, file))
 		{
@@ -138,16 +148,12 @@ get_all_programs_for_file(const char *file)
 	int i;
 	assoc_records_t result = {};
 
-	for(i = 0; i < active_filetypes.count; i++)
+	for(i = get_filetype_number(file, active_filetypes, 0); i >= 0;
+			i = get_filetype_number(file, active_filetypes, i + 1))
 	{
 		assoc_records_t progs;
 		int j;
 
-		if(!global_matches(active_filetypes.list[i].pattern, file))
-		{
-			continue;
-		}
-
 		progs = active_filetypes.list[i].records;
 		for(j = 0; j < progs.count; j++)
 		{
@@ -347,6 +353,19 @@ add_assoc(assoc_list_t *assoc_list, assoc_t assoc)
 	assoc_list->list = p;
 	assoc_list->list[assoc_list->count] = assoc;
 	assoc_list->count++;
+
+	/* Compiled patterns must stay in sync with the list, on any failure just
+	 * stop using them. */
+	if(assoc_list->count == 1)
+	{
+		assoc_list->globs = globs_alloc();
+	}
+	if(assoc_list->globs != NULL &&
+			globs_add(assoc_list->globs, assoc.pattern) != 0)
+	{
+		globs_free(assoc_list->globs);
+		assoc_list->globs = NULL;
+	}
 }
 
 void
@@ -392,6 +411,9 @@ reset_list_head(assoc_list_t *assoc_list)
 	free(assoc_list->list);
 	assoc_list->list = NULL;
 	assoc_list->count = 0;
+
+	globs_free(assoc_list->globs);
+	assoc_list->globs = NULL;
 }
 
 static void
@@ -21,6 +21,7 @@
 #define VIFM__FILETYPE_H__
 
 #include "utils/test_helpers.h"
+#include "globals.h"
 
 /* Type of file association by it's source. */
 typedef enum
@@ -58,6 +59,7 @@ typedef struct
 {
 	assoc_t *list;
 	int count;
+	globs_t *globs; /* Compiled patterns of the list or NULL on failure. */
 }
 assoc_list_t;
 
@@ -20,12 +20,55 @@
 
 #include <regex.h>
 
-#include <stdlib.h> /* realloc() free() */
-#include <string.h> /* strdup() strchr() */
+#include <limits.h> /* INT_MAX */
+#include <stddef.h> /* NULL size_t */
+#include <stdlib.h> /* calloc() free() malloc() realloc() */
+#include <string.h> /* strdup() strchr() strlen() */
 
 #include "utils/str.h"
 
+/* Node of a trie of reversed literal parts of globs.  Paths from the root
+ * correspond to ends of file names. */
+typedef struct suffix_node_t
+{
+	struct suffix_node_t *child; /* First child of the node. */
+	struct suffix_node_t *next;  /* Next sibling of the node. */
+	int *suffix_ids;             /* Positions of "*literal" globs, which end at
+	                                this node, in ascending order. */
+	int nsuffix_ids;             /* Number of elements in suffix_ids. */
+	int *exact_ids;              /* Positions of "literal" globs, which end at
+	                                this node, in ascending order. */
+	int nexact_ids;              /* Number of elements in exact_ids. */
+	char c;                      /* Lowercased character of the node. */
+}
+suffix_node_t;
+
+/* Glob that is too complex to be put into the trie. */
+typedef struct
+{
+	regex_t *regex; /* Compiled glob or NULL if it's malformed. */
+	int id;         /* Position of the glob in the list. */
+}
+regex_glob_t;
+
+struct globs_t
+{
+	suffix_node_t root;    /* Root of the trie of literal globs. */
+	regex_glob_t *regexes; /* Globs that are matched via regular expressions. */
+	int nregexes;          /* Number of elements in regexes. */
+	int count;             /* Total number of globs in the list. */
+};
+
 static char * to_regex(const char *global);
+static int is_literal(const char str[]);
+static int add_to_trie(suffix_node_t *root, const char literal[], int id,
+		int exact);
+static int add_id(int **ids, int *count, int id);
+static int add_regex(globs_t *globs, const char global[], int id);
+static int find_first_id(const int ids[], int count, int from);
+static const suffix_node_t * find_child(const suffix_node_t *node, char c);
+static char lower_char(char c);
+static void free_trie(suffix_node_t *node);
 
 int
 global_matches(const char *global, const char *file)
@@ -115,5 +158,269 @@ to_regex(const char *global)
 	return result;
 }
 
+globs_t *
+globs_alloc(void)
+{
+	return calloc(1, sizeof(globs_t));
+}
+
+void
+globs_free(globs_t *globs)
+{
+	int i;
+
+	if(globs == NULL)
+	{
+		return;
+	}
+
+	for(i = 0; i < globs->nregexes; ++i)
+	{
+		if(globs->regexes[i].regex != NULL)
+		{
+			regfree(globs->regexes[i].regex);
+			free(globs->regexes[i].regex);
+		}
+	}
+	free(globs->regexes);
+
+	free_trie(globs->root.child);
+	free(globs->root.suffix_ids);
+	free(globs->root.exact_ids);
+
+	free(globs);
+}
+
+int
+globs_add(globs_t *globs, const char global[])
+{
+	const int id = globs->count;
+	int result;
+
+	/* Leading asterisk doesn't match leading dot, which is accounted for on
+	 * lookup. */
+	if(global[0] == '*' && is_literal(global + 1))
+	{
+		result = add_to_trie(&globs->root, global + 1, id, 0);
+	}
+	else if(is_literal(global))
+	{
+		result = add_to_trie(&globs->root, global, id, 1);
+	}
+	else
+	{
+		result = add_regex(globs, global, id);
+	}
+
+	if(result == 0)
+	{
+		++globs->count;
+	}
+	return result;
+}
+
+/* Checks whether string has no characters that have special meaning in globs
+ * and can be compared ignoring case without regard to locale.  Returns non-zero
+ * if so, otherwise zero is returned. */
+static int
+is_literal(const char str[])
+{
+	while(*str != '\0')
+	{
+		if((unsigned char)*str >= 0x80 || char_is_one_of("*?[\\", *str))
+		{
+			return 0;
+		}
+		++str;
+	}
+	return 1;
+}
+
+/* Adds reversed literal to the trie.  Returns zero on success, otherwise
+ * non-zero is returned. */
+static int
+add_to_trie(suffix_node_t *root, const char literal[], int id, int exact)
+{
+	suffix_node_t *node = root;
+	const char *p = literal + strlen(literal);
+
+	while(p != literal)
+	{
+		const char c = lower_char(*--p);
+		suffix_node_t *child = (suffix_node_t *)find_child(node, c);
+		if(child == NULL)
+		{
+			child = calloc(1, sizeof(*child));
+			if(child == NULL)
+			{
+				return 1;
+			}
+			child->c = c;
+			child->next = node->child;
+			node->child = child;
+		}
+		node = child;
+	}
+
+	return exact ? add_id(&node->exact_ids, &node->nexact_ids, id)
+	             : add_id(&node->suffix_ids, &node->nsuffix_ids, id);
+}
+
+/* Appends id to the array.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+add_id(int **ids, int *count, int id)
+{
+	int *const new_ids = realloc(*ids, sizeof(**ids)*(*count + 1));
+	if(new_ids == NULL)
+	{
+		return 1;
+	}
+
+	*ids = new_ids;
+	new_ids[(*count)++] = id;
+	return 0;
+}
+
+/* Compiles glob into regular expression and appends it to list of such globs.
+ * Returns zero on success, otherwise non-zero is returned. */
+static int
+add_regex(globs_t *globs, const char global[], int id)
+{
+	regex_glob_t *const regexes = realloc(globs->regexes,
+			sizeof(*regexes)*(globs->nregexes + 1));
+	regex_t *const regex = malloc(sizeof(*regex));
+	char *const regex_str = to_regex(global);
+
+	if(regexes != NULL)
+	{
+		globs->regexes = regexes;
+	}
+
+	if(regexes == NULL || regex == NULL || regex_str == NULL)
+	{
+		free(regex);
+		free(regex_str);
+		return 1;
+	}
+
+	/* Malformed globs never match anything. */
+	regexes[globs->nregexes].id = id;
+	regexes[globs->nregexes].regex = regex;
+	if(regcomp(regex, regex_str, REG_EXTENDED | REG_ICASE) != 0)
+	{
+		regexes[globs->nregexes].regex = NULL;
+		free(regex);
+	}
+	++globs->nregexes;
+
+	free(regex_str);
+	return 0;
+}
+
+int
+globs_find(const globs_t *globs, const char file[], int from)
+{
+	const size_t len = strlen(file);
+	const int can_skip_prefix = (file[0] != '.');
+	const suffix_node_t *node = &globs->root;
+	const char *p = file + len;
+	int best = INT_MAX;
+	int i;
+
+	/* Walk the trie from the end of the name, each visited node corresponds to
+	 * one of suffixes of the name. */
+	while(1)
+	{
+		int id;
+
+		/* Leading asterisk must match at least one character, which isn't a
+		 * dot. */
+		if(p != file && can_skip_prefix)
+		{
+			id = find_first_id(node->suffix_ids, node->nsuffix_ids, from);
+			best = (id >= 0 && id < best) ? id : best;
+		}
+		else if(p == file)
+		{
+			id = find_first_id(node->exact_ids, node->nexact_ids, from);
+			best = (id >= 0 && id < best) ? id : best;
+		}
+
+		if(p == file || (node = find_child(node, lower_char(*--p))) == NULL)
+		{
+			break;
+		}
+	}
+
+	for(i = 0; i < globs->nregexes; ++i)
+	{
+		const regex_glob_t *const glob = &globs->regexes[i];
+		if(glob->id >= best)
+		{
+			break;
+		}
+		if(glob->id >= from && glob->regex != NULL &&
+				regexec(glob->regex, file, 0, NULL, 0) == 0)
+		{
+			return glob->id;
+		}
+	}
+
+	return (best == INT_MAX) ? -1 : best;
+}
+
+/* Finds first element of sorted ids that is not less than from.  Returns the
+ * element or -1 if there is no such element. */
+static int
+find_first_id(const int ids[], int count, int from)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		if(ids[i] >= from)
+		{
+			return ids[i];
+		}
+	}
+	return -1;
+}
+
+/* Looks up child of the node by its character.  Returns the child or NULL. */
+static const suffix_node_t *
+find_child(const suffix_node_t *node, char c)
+{
+	const suffix_node_t *child = node->child;
+	while(child != NULL && child->c != c)
+	{
+		child = child->next;
+	}
+	return child;
+}
+
+/* Converts ASCII letter to lower case, leaves other characters as is.  Returns
+ * the converted character. */
+static char
+lower_char(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? (c - 'A' + 'a') : c;
+}
+
+/* Frees the node, its siblings and all their children.  The node can be
+ * NULL. */
+static void
+free_trie(suffix_node_t *node)
+{
+	while(node != NULL)
+	{
+		suffix_node_t *const next = node->next;
+		free_trie(node->child);
+		free(node->suffix_ids);
+		free(node->exact_ids);
+		free(node);
+		node = next;
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 : */
@@ -19,8 +19,27 @@
 #ifndef VIFM__GLOBALS_H__
 #define VIFM__GLOBALS_H__
 
+/* Ordered list of compiled globs, which is optimized for finding globs that
+ * match a file name. */
+typedef struct globs_t globs_t;
+
 int global_matches(const char *global, const char *file);
 
+/* Allocates empty list of globs.  Returns NULL on error. */
+globs_t * globs_alloc(void);
+
+/* Frees list of globs.  The globs can be NULL. */
+void globs_free(globs_t *globs);
+
+/* Compiles the global and appends it to the list.  Returns zero on success,
+ * otherwise non-zero is returned. */
+int globs_add(globs_t *globs, const char global[]);
+
+/* Finds first glob in the list at position from or further that matches the
+ * file in the same way as global_matches() does.  Returns position of the glob
+ * or -1 if there is no such glob. */
+int globs_find(const globs_t *globs, const char file[], int from);
+
 #endif /* VIFM__GLOBALS_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -18,16 +18,29 @@
 
 #include "ioeta.h"
 
+#include <pthread.h>
+
 #include <assert.h> /* assert() */
 #include <stddef.h> /* NULL size_t */
 #include <stdint.h> /* uint64_t */
 #include <stdlib.h> /* calloc() free() */
 
+#include "../utils/string_array.h"
 #include "../ui.h"
 #include "private/ioeta.h"
 #include "private/traverser.h"
 
-static VisitResult eta_visitor(const char full_path[], VisitAction action,
+/* State of estimation that runs in a separate thread. */
+struct ioeta_bg_t
+{
+	pthread_t thread; /* Thread that performs the estimation. */
+	char **paths;     /* Paths to estimate. */
+	int count;        /* Number of elements in paths. */
+};
+
+static void calculate_all(ioeta_estim_t *estim, char *paths[], int count);
+static void * estimate_in_bg(void *arg);
+static VisitResult eta_visitor(const trav_entry_t *entry, VisitAction action,
 		void *param);
 
 ioeta_estim_t *
@@ -43,6 +56,7 @@ ioeta_free(ioeta_estim_t *estim)
 {
 	if(estim != NULL)
 	{
+		ioeta_stop_bg(estim);
 		free(estim->item);
 		free(estim);
 	}
@@ -57,18 +71,98 @@ ioeta_calculate(ioeta_estim_t *estim, const char path[], int shallow)
 	}
 	else
 	{
-		(void)traverse(path, &eta_visitor, estim);
+		(void)traverse_at(path, &eta_visitor, estim);
+	}
+}
+
+void
+ioeta_calculate_bg(ioeta_estim_t *estim, char *paths[], int count)
+{
+	struct ioeta_bg_t *bg;
+
+	if(estim->bg != NULL || count == 0)
+	{
+		calculate_all(estim, paths, count);
+		return;
+	}
+
+	bg = malloc(sizeof(*bg));
+	if(bg == NULL)
+	{
+		calculate_all(estim, paths, count);
+		return;
+	}
+
+	bg->paths = copy_string_array(paths, count);
+	bg->count = count;
+	if(bg->paths == NULL)
+	{
+		free(bg);
+		calculate_all(estim, paths, count);
+		return;
+	}
+
+	estim->bg = bg;
+	ioeta_set_in_background(estim, 1);
+	if(pthread_create(&bg->thread, NULL, &estimate_in_bg, estim) != 0)
+	{
+		ioeta_set_in_background(estim, 0);
+		estim->bg = NULL;
+		free_string_array(bg->paths, bg->count);
+		free(bg);
+		calculate_all(estim, paths, count);
 	}
 }
 
-/* Implementation of traverse() visitor for subtree copying.  Returns 0 on
- * success, otherwise non-zero is returned. */
+void
+ioeta_stop_bg(ioeta_estim_t *estim)
+{
+	struct ioeta_bg_t *const bg = estim->bg;
+	if(bg == NULL)
+	{
+		return;
+	}
+
+	ioeta_cancel(estim);
+	(void)pthread_join(bg->thread, NULL);
+
+	free_string_array(bg->paths, bg->count);
+	free(bg);
+	estim->bg = NULL;
+}
+
+/* Calculates estimates for all the paths in the current thread. */
+static void
+calculate_all(ioeta_estim_t *estim, char *paths[], int count)
+{
+	int i;
+	for(i = 0; i < count && !ioeta_is_cancelled(estim); ++i)
+	{
+		ioeta_calculate(estim, paths[i], 0);
+	}
+}
+
+/* Entry point of background estimation thread.  Returns NULL. */
+static void *
+estimate_in_bg(void *arg)
+{
+	ioeta_estim_t *const estim = arg;
+	struct ioeta_bg_t *const bg = estim->bg;
+
+	calculate_all(estim, bg->paths, bg->count);
+	ioeta_set_in_background(estim, 0);
+
+	return NULL;
+}
+
+/* Implementation of traverse_at() visitor for subtree estimation.  Returns 0
+ * on success, otherwise non-zero is returned. */
 static VisitResult
-eta_visitor(const char full_path[], VisitAction action, void *param)
+eta_visitor(const trav_entry_t *entry, VisitAction action, void *param)
 {
 	ioeta_estim_t *const estim = param;
 
-	if(ui_cancellation_requested())
+	if(ui_cancellation_requested() || ioeta_is_cancelled(estim))
 	{
 		return VR_CANCELLED;
 	}
@@ -76,10 +170,10 @@ eta_visitor(const char full_path[], VisitAction action, void *param)
 	switch(action)
 	{
 		case VA_DIR_ENTER:
-			ioeta_add_dir(estim, full_path);
+			ioeta_add_dir_at(estim, entry);
 			return VR_SKIP_DIR_LEAVE;
 		case VA_FILE:
-			ioeta_add_file(estim, full_path);
+			ioeta_add_file_at(estim, entry);
 			return VR_OK;
 		case VA_DIR_LEAVE:
 			assert(0 && "Can't get here because of VR_SKIP_DIR_LEAVE.");
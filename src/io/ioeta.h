@@ -47,6 +47,21 @@ typedef struct
 
 	/* Custom parameter for notification callbacks. */
 	void *param;
+
+	/* Whether estimation is still being calculated concurrently with the
+	 * operation, totals are only lower bounds while this is set. */
+	int in_background;
+
+	/* Set to request stopping of estimation. */
+	int cancelled;
+
+	/* Whether updates only change counters without notifying about progress,
+	 * which is then reported by ioeta_notify().  Used when updates come from
+	 * several threads. */
+	int quiet;
+
+	/* State of background estimation, NULL if it wasn't started. */
+	struct ioeta_bg_t *bg;
 }
 ioeta_estim_t;
 
@@ -61,6 +76,20 @@ void ioeta_free(ioeta_estim_t *estim);
  * directories. */
 void ioeta_calculate(ioeta_estim_t *estim, const char path[], int shallow);
 
+/* Accounts for a directory with known number of files and their size (e.g.
+ * taken from a cache) without examining the file system. */
+void ioeta_add_known(ioeta_estim_t *estim, const char path[], size_t items,
+		uint64_t size);
+
+/* Starts calculating estimates for count paths in a separate thread, so that
+ * operation doesn't need to wait for it.  Progress notifications aren't sent
+ * for such estimation.  Copies paths.  Falls back to synchronous calculation on
+ * failure to start a thread. */
+void ioeta_calculate_bg(ioeta_estim_t *estim, char *paths[], int count);
+
+/* Stops background estimation (if any) and waits for it to finish. */
+void ioeta_stop_bg(ioeta_estim_t *estim);
+
 #endif /* VIFM__IO__IOETA_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -24,15 +24,27 @@
 #include <windows.h>
 #endif
 
-#include <sys/stat.h> /* stat chmod() mkdir() */
-#include <sys/types.h> /* mode_t */
-#include <unistd.h> /* rmdir() symlink() unlink() */
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h> /* FICLONE */
+#include <sys/ioctl.h> /* ioctl() */
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h> /* sendfile() */
+#endif
+#ifdef __linux__
+#include <sys/syscall.h> /* SYS_copy_file_range syscall() */
+#endif
+#include <sys/stat.h> /* stat chmod() fstat() mkdir() */
+#include <sys/types.h> /* mode_t off_t ssize_t */
+#include <unistd.h> /* ftruncate() lseek() read() rmdir() symlink() unlink()
+                       write() */
 
-#include <errno.h> /* EEXIST errno */
+#include <errno.h> /* EEXIST EINTR EINVAL ENXIO errno */
 #include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* UINT64_MAX uint64_t */
 #include <stdio.h> /* FILE fpos_t fclose() fgetpos() fopen() fread() fseek()
                       fsetpos() fwrite() rename() snprintf() */
-#include <stdlib.h> /* free() */
+#include <stdlib.h> /* free() malloc() */
 #include <string.h> /* strchr() */
 
 #include "../utils/fs.h"
@@ -46,14 +58,35 @@
 #include "private/ioeta.h"
 #include "ioc.h"
 
+#ifdef _WIN32
 /* Amount of data to transfer at once. */
 #define BLOCK_SIZE 32*1024
+#else
+/* Size of buffer for copying data through user space when the kernel can't do
+ * it for us. */
+#define BIG_BLOCK_SIZE (1024*1024)
+
+/* Maximum amount of data copied by the kernel at once, limits delay of reacting
+ * to cancellation and granularity of progress reports. */
+#define KERNEL_COPY_CHUNK (8*1024*1024)
+#endif
 
 #ifdef _WIN32
 static DWORD CALLBACK win_progress_cb(LARGE_INTEGER total,
 		LARGE_INTEGER transferred, LARGE_INTEGER stream_size,
 		LARGE_INTEGER stream_transfered, DWORD stream_num, DWORD reason,
 		HANDLE src_file, HANDLE dst_file, LPVOID param);
+#else
+static int copy_file_data(io_args_t *args, int in, int out, int empty_out);
+static int is_sparse(const struct stat *st);
+static int copy_sparse_file(io_args_t *args, int in, int out, off_t size);
+static int copy_data_range(io_args_t *args, int in, int out, uint64_t len);
+static int clone_file(io_args_t *args, int in, int out);
+static int copy_in_kernel(io_args_t *args, int in, int out, int use_sendfile,
+		uint64_t *len, int *error);
+static int copy_through_buffer(io_args_t *args, int in, int out,
+		uint64_t len);
+static int is_copy_cancelled(const io_args_t *args);
 #endif
 
 int
@@ -182,9 +215,11 @@ iop_cp(io_args_t *const args)
 	const IoCrs crs = args->arg3.crs;
 	const int cancellable = args->cancellable;
 
+#ifdef _WIN32
 	char block[BLOCK_SIZE];
-	FILE *in, *out;
 	size_t nread;
+#endif
+	FILE *in, *out;
 	int error;
 	struct stat src_st;
 	const char *open_mode = "wb";
@@ -289,9 +324,16 @@ iop_cp(io_args_t *const args)
 		}
 	}
 
-	/* TODO: use sendfile() if platform supports it. */
-
-	while((nread = fread(&block, 1, sizeof(block), in)) != 0U)
+#ifndef _WIN32
+	if(!error)
+	{
+		/* Streams weren't used for reading or writing yet, so their buffers are
+		 * empty and file descriptors are at correct positions. */
+		error = copy_file_data(args, fileno(in), fileno(out),
+				crs != IO_CRS_APPEND_TO_FILES);
+	}
+#else
+	while(!error && (nread = fread(&block, 1, sizeof(block), in)) != 0U)
 	{
 		if(cancellable && ui_cancellation_requested())
 		{
@@ -307,6 +349,7 @@ iop_cp(io_args_t *const args)
 
 		ioeta_update(args->estim, src, 0, nread);
 	}
+#endif
 
 	fclose(in);
 	fclose(out);
@@ -321,7 +364,284 @@ iop_cp(io_args_t *const args)
 	return error;
 }
 
-#ifdef _WIN32
+#ifndef _WIN32
+
+/* Copies data from current position of in till its end to out trying
+ * mechanisms that don't pass data through user space first.  empty_out
+ * indicates that out is a newly created empty file.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+copy_file_data(io_args_t *args, int in, int out, int empty_out)
+{
+	struct stat st;
+
+	if(!empty_out)
+	{
+		return copy_data_range(args, in, out, UINT64_MAX);
+	}
+
+	if(clone_file(args, in, out) == 0)
+	{
+		return 0;
+	}
+
+	if(fstat(in, &st) == 0 && is_sparse(&st))
+	{
+		const int result = copy_sparse_file(args, in, out, st.st_size);
+		if(result >= 0)
+		{
+			return result;
+		}
+	}
+
+	return copy_data_range(args, in, out, UINT64_MAX);
+}
+
+/* Checks whether file described by st has less blocks allocated than is
+ * needed to store all of its data.  Returns non-zero if so, otherwise zero is
+ * returned. */
+static int
+is_sparse(const struct stat *st)
+{
+	/* st_blocks is measured in 512-byte units regardless of block size. */
+	return S_ISREG(st->st_mode) && (uint64_t)st->st_blocks*512U < st->st_size;
+}
+
+/* Copies data extents of the file recreating holes between them in out, which
+ * must be empty.  Holes are accounted in progress as if they were copied, so
+ * that it's measured in file sizes like for other methods.  Returns zero on
+ * success, positive number on error and negative number if holes can't be
+ * discovered for this file. */
+static int
+copy_sparse_file(io_args_t *args, int in, int out, off_t size)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	off_t data = 0;
+	off_t copied = 0;
+
+	while(data < size)
+	{
+		off_t hole;
+
+		data = lseek(in, data, SEEK_DATA);
+		if(data < 0)
+		{
+			if(errno == ENXIO)
+			{
+				/* The rest of the file is a hole. */
+				break;
+			}
+			return (errno == EINVAL && lseek(in, 0, SEEK_SET) == 0) ? -1 : 1;
+		}
+
+		hole = lseek(in, data, SEEK_HOLE);
+		if(hole < 0)
+		{
+			return 1;
+		}
+
+		if(lseek(in, data, SEEK_SET) != data || lseek(out, data, SEEK_SET) != data)
+		{
+			return 1;
+		}
+
+		ioeta_update(args->estim, NULL, 0, data - copied);
+
+		if(copy_data_range(args, in, out, hole - data) != 0)
+		{
+			return 1;
+		}
+
+		data = hole;
+		copied = hole;
+	}
+
+	ioeta_update(args->estim, NULL, 0, size - copied);
+
+	/* Trailing hole isn't created by seeking alone. */
+	return ftruncate(out, size) != 0;
+#else
+	return -1;
+#endif
+}
+
+/* Copies at most len bytes (or till the end of in) from current position of in
+ * to current position of out.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+copy_data_range(io_args_t *args, int in, int out, uint64_t len)
+{
+	int error;
+
+	if(copy_in_kernel(args, in, out, 0, &len, &error) == 0 ||
+			copy_in_kernel(args, in, out, 1, &len, &error) == 0)
+	{
+		return error;
+	}
+
+	return copy_through_buffer(args, in, out, len);
+}
+
+/* Makes out share data blocks with in (reflink) on file systems that support
+ * it, which copies file of any size almost instantly.  Returns zero on
+ * success, otherwise non-zero is returned. */
+static int
+clone_file(io_args_t *args, int in, int out)
+{
+#if defined(HAVE_LINUX_FS_H) && defined(FICLONE)
+	struct stat st;
+
+	if(fstat(in, &st) != 0 || lseek(in, 0, SEEK_CUR) != 0)
+	{
+		return 1;
+	}
+
+	if(ioctl(out, FICLONE, in) != 0)
+	{
+		return 1;
+	}
+
+	/* Leave descriptors in the same state as other methods do. */
+	(void)lseek(in, 0, SEEK_END);
+	(void)lseek(out, 0, SEEK_END);
+
+	ioeta_update(args->estim, args->arg1.src, 0, st.st_size);
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+/* Copies data in chunks using copy_file_range() or sendfile() system call
+ * depending on use_sendfile.  Copying starts and continues from current
+ * positions of both file descriptors and stops at the end of in or after *len
+ * bytes, *len is decreased by amount of copied data.  Returns non-zero if the
+ * method isn't usable for these files and another one should be tried
+ * (possibly after some data was copied), otherwise zero is returned and *error
+ * is set. */
+static int
+copy_in_kernel(io_args_t *args, int in, int out, int use_sendfile,
+		uint64_t *len, int *error)
+{
+	while(*len != 0U)
+	{
+		const size_t chunk = MIN(*len, KERNEL_COPY_CHUNK);
+		ssize_t ncopied;
+
+		if(is_copy_cancelled(args))
+		{
+			*error = 1;
+			return 0;
+		}
+
+		if(use_sendfile)
+		{
+#ifdef HAVE_SYS_SENDFILE_H
+			ncopied = sendfile(out, in, NULL, chunk);
+#else
+			return 1;
+#endif
+		}
+		else
+		{
+#if defined(__linux__) && defined(SYS_copy_file_range)
+			ncopied = syscall(SYS_copy_file_range, in, NULL, out, NULL, chunk, 0U);
+#else
+			return 1;
+#endif
+		}
+
+		if(ncopied == 0)
+		{
+			break;
+		}
+
+		if(ncopied < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			/* Some other method might still work (e.g., for files on different
+			 * file systems or for special files), which is also the way to get
+			 * correct error code if something is really wrong. */
+			return 1;
+		}
+
+		*len -= ncopied;
+		ioeta_update(args->estim, args->arg1.src, 0, ncopied);
+	}
+
+	*error = 0;
+	return 0;
+}
+
+/* Copies at most len bytes (or till the end of in) via a large buffer in user
+ * space.  Returns zero on success, otherwise non-zero is returned. */
+static int
+copy_through_buffer(io_args_t *args, int in, int out, uint64_t len)
+{
+	char *const block = malloc(BIG_BLOCK_SIZE);
+	int error = 0;
+
+	if(block == NULL)
+	{
+		return 1;
+	}
+
+	while(!error && len != 0U)
+	{
+		ssize_t nwritten;
+		const ssize_t nread = read(in, block, MIN(len, BIG_BLOCK_SIZE));
+		if(nread == 0)
+		{
+			break;
+		}
+		if(nread < 0)
+		{
+			error = (errno != EINTR);
+			continue;
+		}
+
+		if(is_copy_cancelled(args))
+		{
+			error = 1;
+			break;
+		}
+
+		nwritten = 0;
+		while(nwritten < nread)
+		{
+			const ssize_t n = write(out, block + nwritten, nread - nwritten);
+			if(n < 0)
+			{
+				if(errno == EINTR)
+				{
+					continue;
+				}
+				error = 1;
+				break;
+			}
+			nwritten += n;
+		}
+
+		len -= nwritten;
+		ioeta_update(args->estim, args->arg1.src, 0, nwritten);
+	}
+
+	free(block);
+	return error;
+}
+
+/* Checks whether user asked to cancel copying.  Returns non-zero if so,
+ * otherwise zero is returned. */
+static int
+is_copy_cancelled(const io_args_t *args)
+{
+	return args->cancellable && ui_cancellation_requested();
+}
+
+#else
 
 static DWORD CALLBACK win_progress_cb(LARGE_INTEGER total,
 		LARGE_INTEGER transferred, LARGE_INTEGER stream_size,
@@ -23,18 +23,28 @@
 #include <shellapi.h>
 #endif
 
-#include <sys/stat.h> /* stat chmod() */
-#include <unistd.h> /* lstat() unlink() */
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <fcntl.h> /* AT_REMOVEDIR AT_SYMLINK_NOFOLLOW */
+#endif
+#include <sys/stat.h> /* stat chmod() fstatat() */
+#include <sys/time.h> /* timeval gettimeofday() */
+#include <unistd.h> /* lstat() unlink() unlinkat() */
 
 #include <errno.h> /* EEXIST EISDIR ENOTEMPTY EXDEV errno */
 #include <stddef.h> /* NULL */
+#include <stdint.h> /* uint64_t */
 #include <stdio.h> /* removee() snprintf() */
-#include <stdlib.h> /* free() */
-#include <string.h> /* strlen() */
+#include <stdlib.h> /* free() malloc() */
+#include <string.h> /* strdup() strlen() */
+#include <time.h> /* timespec */
 
+#include "../cfg/config.h"
 #include "../utils/fs.h"
 #include "../utils/fs_limits.h"
 #include "../utils/log.h"
+#include "../utils/macros.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
 #include "../background.h"
@@ -44,27 +54,91 @@
 #include "ioc.h"
 #include "iop.h"
 
-static VisitResult rm_visitor(const char full_path[], VisitAction action,
+/* Maximum number of threads that copy files while tree is being traversed. */
+#define MAX_CP_WORKERS 64
+
+/* How often progress of parallel copying is reported while traversing thread
+ * waits for workers. */
+#define CP_NOTIFY_INTERVAL_MS 100
+
+/* Maximum number of files waiting to be copied, limits how far traversal can
+ * go ahead of copying. */
+#define CP_QUEUE_LIMIT 1024
+
+/* Destination directory whose attributes are set after all its files and
+ * subdirectories are done. */
+typedef struct cp_dir_t
+{
+	char *src;               /* Source directory. */
+	char *dst;               /* Destination directory. */
+	struct cp_dir_t *parent; /* Parent directory or NULL for the root. */
+	struct cp_dir_t *next;   /* Next directory in the list of all of them. */
+	int pending;             /* Number of unfinished children plus one for
+	                            traversal of the directory itself. */
+	int keep_attrs;          /* Whether existing directory shouldn't be
+	                            updated. */
+}
+cp_dir_t;
+
+/* Single file to be copied by one of the workers. */
+typedef struct cp_task_t
+{
+	char *src;              /* Source file. */
+	char *dst;              /* Destination file. */
+	cp_dir_t *dir;          /* Directory which contains the file. */
+	struct cp_task_t *next; /* Next task in the queue. */
+}
+cp_task_t;
+
+/* State shared by traversing thread and copying threads of ior_cp(). */
+typedef struct
+{
+	const io_args_t *args;  /* Arguments of the operation. */
+	cp_task_t *head;        /* First task in the queue. */
+	cp_task_t *tail;        /* Last task in the queue. */
+	int queued;             /* Number of tasks in the queue. */
+	cp_dir_t *dirs;         /* All directories for freeing them at the end. */
+	cp_dir_t *current;      /* Directory being traversed. */
+	int traversed;          /* Whether traversal has finished. */
+	int running;            /* Number of workers that haven't exited yet. */
+	int failed;             /* Whether an error or cancellation happened. */
+	pthread_mutex_t lock;   /* Protects this structure and directories. */
+	pthread_cond_t changed; /* Signaled on any change of the queue. */
+}
+cp_pool_t;
+
+static VisitResult rm_visitor(const trav_entry_t *entry, VisitAction action,
 		void *param);
-static VisitResult cp_visitor(const char full_path[], VisitAction action,
+static VisitResult rm_entry(const io_args_t *rm_args,
+		const trav_entry_t *entry, int dir);
+static VisitResult cp_visitor(const trav_entry_t *entry, VisitAction action,
 		void *param);
+static int parallel_cp(io_args_t *args);
+static VisitResult parallel_cp_visitor(const char full_path[],
+		VisitAction action, void *param);
+static char * get_dst_path(const io_args_t *args, const char full_path[]);
+static int queue_cp_task(cp_pool_t *pool, const char src[], char dst[]);
+static void wait_for_cp_workers(cp_pool_t *pool);
+static void * cp_worker(void *arg);
+static void finish_cp_child(cp_pool_t *pool, cp_dir_t *dir);
+static int set_dir_attrs(const char src[], const char dst[]);
 static int is_file(const char path[]);
-static VisitResult mv_visitor(const char full_path[], VisitAction action,
+static VisitResult mv_visitor(const trav_entry_t *entry, VisitAction action,
 		void *param);
-static VisitResult cp_mv_visitor(const char full_path[], VisitAction action,
-		void *param, int cp);
+static VisitResult cp_mv_visitor(const trav_entry_t *entry,
+		VisitAction action, void *param, int cp);
 
 int
 ior_rm(io_args_t *const args)
 {
 	const char *const path = args->arg1.path;
-	return traverse(path, &rm_visitor, args);
+	return traverse_at(path, &rm_visitor, args);
 }
 
-/* Implementation of traverse() visitor for subtree removal.  Returns 0 on
+/* Implementation of traverse_at() visitor for subtree removal.  Returns 0 on
  * success, otherwise non-zero is returned. */
 static VisitResult
-rm_visitor(const char full_path[], VisitAction action, void *param)
+rm_visitor(const trav_entry_t *entry, VisitAction action, void *param)
 {
 	const io_args_t *const rm_args = param;
 	VisitResult result = VR_OK;
@@ -81,34 +155,57 @@ rm_visitor(const char full_path[], VisitAction action, void *param)
 			result = VR_OK;
 			break;
 		case VA_FILE:
-			{
-				io_args_t args =
-				{
-					.arg1.path = full_path,
+			result = rm_entry(rm_args, entry, 0);
+			break;
+		case VA_DIR_LEAVE:
+			result = rm_entry(rm_args, entry, 1);
+			break;
+	}
 
-					.cancellable = rm_args->cancellable,
-					.estim = rm_args->estim,
-				};
+	return result;
+}
 
-				result = iop_rmfile(&args);
-				break;
-			}
-		case VA_DIR_LEAVE:
-			{
-				io_args_t args =
-				{
-					.arg1.path = full_path,
+/* Removes file or empty directory (when dir is non-zero) by descriptor of its
+ * parent directory.  Returns VR_OK on success, otherwise VR_ERROR is
+ * returned. */
+static VisitResult
+rm_entry(const io_args_t *rm_args, const trav_entry_t *entry, int dir)
+{
+#ifndef _WIN32
+	uint64_t size = 0U;
+	int result;
 
-					.cancellable = rm_args->cancellable,
-					.estim = rm_args->estim,
-				};
+	/* Full path and size are needed only to report progress. */
+	if(rm_args->estim != NULL)
+	{
+		struct stat st;
 
-				result = iop_rmdir(&args);
-				break;
-			}
+		ioeta_update(rm_args->estim, trav_full_path(entry), 0, 0);
+
+		if(!dir && fstatat(entry->dirfd, entry->name, &st,
+					AT_SYMLINK_NOFOLLOW) == 0)
+		{
+			size = st.st_size;
+		}
 	}
 
-	return result;
+	result = unlinkat(entry->dirfd, entry->name, dir ? AT_REMOVEDIR : 0);
+
+	ioeta_update(rm_args->estim, NULL, 1, size);
+
+	return (result == 0) ? VR_OK : VR_ERROR;
+#else
+	io_args_t args =
+	{
+		.arg1.path = entry->name,
+
+		.cancellable = rm_args->cancellable,
+		.estim = rm_args->estim,
+	};
+
+	return ((dir ? iop_rmdir(&args) : iop_rmfile(&args)) == 0) ? VR_OK
+	                                                          : VR_ERROR;
+#endif
 }
 
 int
@@ -138,15 +235,410 @@ ior_cp(io_args_t *const args)
 		}
 	}
 
-	return traverse(src, &cp_visitor, args);
+	if(is_dir(src) && !is_symlink(src))
+	{
+		return parallel_cp(args);
+	}
+
+	return traverse_at(src, &cp_visitor, args);
 }
 
-/* Implementation of traverse() visitor for subtree copying.  Returns 0 on
+/* Implementation of traverse_at() visitor for subtree copying.  Returns 0 on
  * success, otherwise non-zero is returned. */
 static VisitResult
-cp_visitor(const char full_path[], VisitAction action, void *param)
+cp_visitor(const trav_entry_t *entry, VisitAction action, void *param)
+{
+	return cp_mv_visitor(entry, action, param, 1);
+}
+
+/* Copies directory tree by traversing it in current thread and copying files
+ * in several other threads.  Workers only update counters of the estimation,
+ * progress is reported from the current thread.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+parallel_cp(io_args_t *args)
 {
-	return cp_mv_visitor(full_path, action, param, 1);
+	pthread_t threads[MAX_CP_WORKERS];
+	const int nworkers = MAX(1, MIN(cfg.stat_workers, MAX_CP_WORKERS));
+	cp_pool_t pool = { .args = args };
+	int nstarted;
+	int result;
+	int i;
+
+	if(pthread_mutex_init(&pool.lock, NULL) != 0)
+	{
+		return traverse_at(args->arg1.src, &cp_visitor, args);
+	}
+	if(pthread_cond_init(&pool.changed, NULL) != 0)
+	{
+		pthread_mutex_destroy(&pool.lock);
+		return traverse_at(args->arg1.src, &cp_visitor, args);
+	}
+
+	ioeta_set_quiet(args->estim, 1);
+
+	nstarted = 0;
+	for(i = 0; i < nworkers; ++i)
+	{
+		if(pthread_create(&threads[nstarted], NULL, &cp_worker, &pool) == 0)
+		{
+			++nstarted;
+		}
+	}
+
+	if(nstarted == 0)
+	{
+		ioeta_set_quiet(args->estim, 0);
+		pthread_cond_destroy(&pool.changed);
+		pthread_mutex_destroy(&pool.lock);
+		return traverse_at(args->arg1.src, &cp_visitor, args);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.running = nstarted;
+	pthread_mutex_unlock(&pool.lock);
+
+	result = traverse(args->arg1.src, &parallel_cp_visitor, &pool);
+
+	pthread_mutex_lock(&pool.lock);
+	pool.traversed = 1;
+	if(result != 0)
+	{
+		pool.failed = 1;
+	}
+	pthread_cond_broadcast(&pool.changed);
+	while(pool.running != 0)
+	{
+		wait_for_cp_workers(&pool);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	for(i = 0; i < nstarted; ++i)
+	{
+		(void)pthread_join(threads[i], NULL);
+	}
+
+	ioeta_set_quiet(args->estim, 0);
+	ioeta_notify(args->estim);
+
+	if(pool.failed)
+	{
+		result = 1;
+	}
+
+	while(pool.dirs != NULL)
+	{
+		cp_dir_t *const next = pool.dirs->next;
+		free(pool.dirs->src);
+		free(pool.dirs->dst);
+		free(pool.dirs);
+		pool.dirs = next;
+	}
+
+	pthread_cond_destroy(&pool.changed);
+	pthread_mutex_destroy(&pool.lock);
+
+	return result;
+}
+
+/* Implementation of traverse() visitor for parallel subtree copying, which
+ * creates directories and queues files.  Returns 0 on success, otherwise
+ * non-zero is returned. */
+static VisitResult
+parallel_cp_visitor(const char full_path[], VisitAction action, void *param)
+{
+	cp_pool_t *const pool = param;
+	const io_args_t *const cp_args = pool->args;
+	char *dst_full_path;
+	int failed;
+	cp_dir_t *dir;
+
+	pthread_mutex_lock(&pool->lock);
+	failed = pool->failed;
+	pthread_mutex_unlock(&pool->lock);
+
+	if(failed)
+	{
+		return VR_ERROR;
+	}
+	if(cp_args->cancellable && ui_cancellation_requested())
+	{
+		return VR_CANCELLED;
+	}
+
+	ioeta_notify(cp_args->estim);
+
+	dst_full_path = get_dst_path(cp_args, full_path);
+	if(dst_full_path == NULL)
+	{
+		return VR_ERROR;
+	}
+
+	switch(action)
+	{
+		case VA_DIR_ENTER:
+			dir = malloc(sizeof(*dir));
+			if(dir == NULL || (dir->src = strdup(full_path)) == NULL)
+			{
+				free(dir);
+				free(dst_full_path);
+				return VR_ERROR;
+			}
+
+			dir->dst = dst_full_path;
+			dir->parent = pool->current;
+			dir->pending = 1;
+			dir->keep_attrs = (cp_args->arg3.crs == IO_CRS_REPLACE_FILES &&
+					is_dir(dst_full_path));
+
+			if(!dir->keep_attrs)
+			{
+				io_args_t args =
+				{
+					.arg1.path = dst_full_path,
+
+					/* Temporary fake rights so we can add files to the directory. */
+					.arg3.mode = 0700,
+
+					.cancellable = cp_args->cancellable,
+					.estim = cp_args->estim,
+				};
+
+				if(iop_mkdir(&args) != 0)
+				{
+					free(dir->src);
+					free(dir->dst);
+					free(dir);
+					return VR_ERROR;
+				}
+			}
+
+			pthread_mutex_lock(&pool->lock);
+			if(dir->parent != NULL)
+			{
+				++dir->parent->pending;
+			}
+			dir->next = pool->dirs;
+			pool->dirs = dir;
+			pthread_mutex_unlock(&pool->lock);
+
+			pool->current = dir;
+			return VR_OK;
+
+		case VA_FILE:
+			return (queue_cp_task(pool, full_path, dst_full_path) == 0)
+			     ? VR_OK
+			     : VR_ERROR;
+
+		case VA_DIR_LEAVE:
+			free(dst_full_path);
+
+			dir = pool->current;
+			pool->current = dir->parent;
+
+			pthread_mutex_lock(&pool->lock);
+			finish_cp_child(pool, dir);
+			failed = pool->failed;
+			pthread_mutex_unlock(&pool->lock);
+
+			return failed ? VR_ERROR : VR_OK;
+	}
+
+	free(dst_full_path);
+	return VR_OK;
+}
+
+/* Forms path at destination that corresponds to full_path at source.  Returns
+ * newly allocated string or NULL on error. */
+static char *
+get_dst_path(const io_args_t *args, const char full_path[])
+{
+	const char *const rel_part = full_path + strlen(args->arg1.src);
+	return (rel_part[0] == '\0')
+	     ? strdup(args->arg2.dst)
+	     : format_str("%s/%s", args->arg2.dst, rel_part);
+}
+
+/* Adds file to the queue of files to be copied waiting for free space in it if
+ * needed.  Takes ownership of dst.  Returns zero on success, otherwise non-zero
+ * is returned. */
+static int
+queue_cp_task(cp_pool_t *pool, const char src[], char dst[])
+{
+	cp_task_t *const task = malloc(sizeof(*task));
+	if(task == NULL || (task->src = strdup(src)) == NULL)
+	{
+		free(task);
+		free(dst);
+		return 1;
+	}
+
+	task->dst = dst;
+	task->dir = pool->current;
+	task->next = NULL;
+
+	pthread_mutex_lock(&pool->lock);
+
+	while(pool->queued >= CP_QUEUE_LIMIT && !pool->failed)
+	{
+		wait_for_cp_workers(pool);
+	}
+
+	if(pool->failed)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		free(task->src);
+		free(task->dst);
+		free(task);
+		return 1;
+	}
+
+	if(task->dir != NULL)
+	{
+		++task->dir->pending;
+	}
+
+	if(pool->tail == NULL)
+	{
+		pool->head = task;
+	}
+	else
+	{
+		pool->tail->next = task;
+	}
+	pool->tail = task;
+	++pool->queued;
+
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+/* Waits for a change of the pool for a limited time and reports progress made
+ * by workers meanwhile.  Should be called with pool->lock held. */
+static void
+wait_for_cp_workers(cp_pool_t *pool)
+{
+	struct timeval tv;
+	struct timespec deadline;
+
+	(void)gettimeofday(&tv, NULL);
+	deadline.tv_sec = tv.tv_sec;
+	deadline.tv_nsec = (tv.tv_usec + CP_NOTIFY_INTERVAL_MS*1000L)*1000L;
+	deadline.tv_sec += deadline.tv_nsec/1000000000L;
+	deadline.tv_nsec %= 1000000000L;
+
+	(void)pthread_cond_timedwait(&pool->changed, &pool->lock, &deadline);
+
+	/* Drawing might take a while, don't block workers meanwhile. */
+	pthread_mutex_unlock(&pool->lock);
+	ioeta_notify(pool->args->estim);
+	pthread_mutex_lock(&pool->lock);
+}
+
+/* Entry point of a thread that copies files from the queue until traversal is
+ * over and the queue is empty.  Returns NULL. */
+static void *
+cp_worker(void *arg)
+{
+	cp_pool_t *const pool = arg;
+	const io_args_t *const cp_args = pool->args;
+
+	pthread_mutex_lock(&pool->lock);
+	while(1)
+	{
+		cp_task_t *task;
+		int failed;
+
+		while(pool->head == NULL && !pool->traversed)
+		{
+			pthread_cond_wait(&pool->changed, &pool->lock);
+		}
+
+		task = pool->head;
+		if(task == NULL)
+		{
+			break;
+		}
+
+		pool->head = task->next;
+		if(pool->head == NULL)
+		{
+			pool->tail = NULL;
+		}
+		--pool->queued;
+		pthread_cond_broadcast(&pool->changed);
+
+		failed = pool->failed;
+		pthread_mutex_unlock(&pool->lock);
+
+		if(!failed)
+		{
+			io_args_t args =
+			{
+				.arg1.src = task->src,
+				.arg2.dst = task->dst,
+				.arg3.crs = cp_args->arg3.crs,
+
+				.cancellable = cp_args->cancellable,
+				.estim = cp_args->estim,
+			};
+
+			failed = (iop_cp(&args) != 0);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		if(failed)
+		{
+			pool->failed = 1;
+			pthread_cond_broadcast(&pool->changed);
+		}
+		if(task->dir != NULL)
+		{
+			finish_cp_child(pool, task->dir);
+		}
+
+		free(task->src);
+		free(task->dst);
+		free(task);
+	}
+	--pool->running;
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* Accounts for finishing of one of children of the directory (or its
+ * traversal) and finalizes attributes of directories that have nothing left to
+ * wait for.  Should be called with pool->lock held. */
+static void
+finish_cp_child(cp_pool_t *pool, cp_dir_t *dir)
+{
+	while(dir != NULL && --dir->pending == 0)
+	{
+		if(!pool->failed && !dir->keep_attrs &&
+				set_dir_attrs(dir->src, dir->dst) != 0)
+		{
+			pool->failed = 1;
+			pthread_cond_broadcast(&pool->changed);
+		}
+		dir = dir->parent;
+	}
+}
+
+/* Copies attributes of source directory to the destination one.  Returns zero
+ * on success, otherwise non-zero is returned. */
+static int
+set_dir_attrs(const char src[], const char dst[])
+{
+#ifndef _WIN32
+	struct stat st;
+	return lstat(src, &st) != 0 || chmod(dst, st.st_mode & 07777) != 0;
+#else
+	return 0;
+#endif
 }
 
 int
@@ -225,7 +717,7 @@ ior_mv(io_args_t *const args)
 				}
 #endif
 
-				return traverse(src, &mv_visitor, args);
+				return traverse_at(src, &mv_visitor, args);
 			}
 			/* Break is intentionally omitted. */
 
@@ -243,20 +735,22 @@ is_file(const char path[])
 	    || (is_symlink(path) && get_symlink_type(path) != SLT_UNKNOWN);
 }
 
-/* Implementation of traverse() visitor for subtree moving.  Returns 0 on
+/* Implementation of traverse_at() visitor for subtree moving.  Returns 0 on
  * success, otherwise non-zero is returned. */
 static VisitResult
-mv_visitor(const char full_path[], VisitAction action, void *param)
+mv_visitor(const trav_entry_t *entry, VisitAction action, void *param)
 {
-	return cp_mv_visitor(full_path, action, param, 0);
+	return cp_mv_visitor(entry, action, param, 0);
 }
 
-/* Generic implementation of traverse() visitor for subtree copying/moving.
+/* Generic implementation of traverse_at() visitor for subtree copying/moving.
  * Returns 0 on success, otherwise non-zero is returned. */
 static VisitResult
-cp_mv_visitor(const char full_path[], VisitAction action, void *param, int cp)
+cp_mv_visitor(const trav_entry_t *entry, VisitAction action, void *param,
+		int cp)
 {
 	const io_args_t *const cp_args = param;
+	const char *full_path;
 	const char *dst_full_path;
 	char *free_me = NULL;
 	VisitResult result = VR_OK;
@@ -267,6 +761,12 @@ cp_mv_visitor(const char full_path[], VisitAction action, void *param, int cp)
 		return VR_CANCELLED;
 	}
 
+	full_path = trav_full_path(entry);
+	if(full_path == NULL)
+	{
+		return VR_ERROR;
+	}
+
 	/* TODO: come up with something better than this. */
 	rel_part = full_path + strlen(cp_args->arg1.src);
 	dst_full_path = (rel_part[0] == '\0')
@@ -317,7 +817,8 @@ cp_mv_visitor(const char full_path[], VisitAction action, void *param, int cp)
 				{
 					struct stat st;
 
-					if(lstat(full_path, &st) == 0)
+					if(fstatat(entry->dirfd, entry->name, &st,
+								AT_SYMLINK_NOFOLLOW) == 0)
 					{
 						result = (chmod(dst_full_path, st.st_mode & 07777) == 0)
 						       ? VR_OK
@@ -18,6 +18,13 @@
 
 #include "ioeta.h"
 
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <fcntl.h> /* AT_SYMLINK_NOFOLLOW */
+#endif
+#include <sys/stat.h> /* S_ISLNK stat fstatat() */
+
 #include <stddef.h> /* NULL */
 #include <stdint.h> /* uint64_t */
 
@@ -25,34 +32,160 @@
 #include "../../utils/str.h"
 #include "../ioeta.h"
 #include "ionotif.h"
+#include "traverser.h"
+
+static void add_items(ioeta_estim_t *estim, const char path[], size_t count,
+		uint64_t size);
+
+/* Serializes updates of estimations, which can come from several threads. */
+static pthread_mutex_t update_lock = PTHREAD_MUTEX_INITIALIZER;
 
 void
 ioeta_add_item(ioeta_estim_t *estim, const char path[])
 {
-	++estim->total_items;
+	pthread_mutex_lock(&update_lock);
+	add_items(estim, path, 1U, 0U);
+	pthread_mutex_unlock(&update_lock);
+}
 
-	replace_string(&estim->item, path);
+void
+ioeta_add_file(ioeta_estim_t *estim, const char path[])
+{
+	const uint64_t size = is_symlink(path) ? 0U : get_file_size(path);
 
-	ionotif_notify(IO_PS_ESTIMATING, estim);
+	pthread_mutex_lock(&update_lock);
+	add_items(estim, path, 1U, size);
+	pthread_mutex_unlock(&update_lock);
 }
 
 void
-ioeta_add_file(ioeta_estim_t *estim, const char path[])
+ioeta_add_known(ioeta_estim_t *estim, const char path[], size_t items,
+		uint64_t size)
 {
-	if(!is_symlink(path))
+	pthread_mutex_lock(&update_lock);
+	add_items(estim, path, items, size);
+	pthread_mutex_unlock(&update_lock);
+}
+
+void
+ioeta_add_file_at(ioeta_estim_t *estim, const trav_entry_t *entry)
+{
+#ifndef _WIN32
+	struct stat st;
+	uint64_t size = 0U;
+
+	if(fstatat(entry->dirfd, entry->name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+			!S_ISLNK(st.st_mode))
 	{
-		estim->total_bytes += get_file_size(path);
+		size = st.st_size;
 	}
 
-	ioeta_add_item(estim, path);
+	pthread_mutex_lock(&update_lock);
+	/* Full path is needed only for notifications. */
+	add_items(estim, estim->in_background ? NULL : trav_full_path(entry), 1U,
+			size);
+	pthread_mutex_unlock(&update_lock);
+#else
+	ioeta_add_file(estim, entry->name);
+#endif
+}
+
+/* Adds count items of the given total size to the estimation.  The path can be
+ * NULL if it's not needed.  Must be called with update_lock held. */
+static void
+add_items(ioeta_estim_t *estim, const char path[], size_t count,
+		uint64_t size)
+{
+	estim->total_bytes += size;
+	estim->total_items += count;
+
+	/* Operation might be already running and reporting its progress, in which
+	 * case current item and progress messages belong to it. */
+	if(!estim->in_background && path != NULL)
+	{
+		replace_string(&estim->item, path);
+		ionotif_notify(IO_PS_ESTIMATING, estim);
+	}
 }
 
 void
 ioeta_add_dir(ioeta_estim_t *estim, const char path[])
 {
-	replace_string(&estim->item, path);
+	pthread_mutex_lock(&update_lock);
+	if(!estim->in_background)
+	{
+		replace_string(&estim->item, path);
+		ionotif_notify(IO_PS_ESTIMATING, estim);
+	}
+	pthread_mutex_unlock(&update_lock);
+}
+
+void
+ioeta_add_dir_at(ioeta_estim_t *estim, const trav_entry_t *entry)
+{
+	pthread_mutex_lock(&update_lock);
+	if(!estim->in_background)
+	{
+		const char *const path = trav_full_path(entry);
+		if(path != NULL)
+		{
+			replace_string(&estim->item, path);
+			ionotif_notify(IO_PS_ESTIMATING, estim);
+		}
+	}
+	pthread_mutex_unlock(&update_lock);
+}
+
+void
+ioeta_set_in_background(ioeta_estim_t *estim, int in_background)
+{
+	pthread_mutex_lock(&update_lock);
+	estim->in_background = in_background;
+	pthread_mutex_unlock(&update_lock);
+}
 
-	ionotif_notify(IO_PS_ESTIMATING, estim);
+void
+ioeta_set_quiet(ioeta_estim_t *estim, int quiet)
+{
+	if(estim == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&update_lock);
+	estim->quiet = quiet;
+	pthread_mutex_unlock(&update_lock);
+}
+
+void
+ioeta_notify(ioeta_estim_t *estim)
+{
+	if(estim == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&update_lock);
+	ionotif_notify(IO_PS_IN_PROGRESS, estim);
+	pthread_mutex_unlock(&update_lock);
+}
+
+void
+ioeta_cancel(ioeta_estim_t *estim)
+{
+	pthread_mutex_lock(&update_lock);
+	estim->cancelled = 1;
+	pthread_mutex_unlock(&update_lock);
+}
+
+int
+ioeta_is_cancelled(ioeta_estim_t *estim)
+{
+	int cancelled;
+	pthread_mutex_lock(&update_lock);
+	cancelled = estim->cancelled;
+	pthread_mutex_unlock(&update_lock);
+	return cancelled;
 }
 
 void
@@ -64,6 +197,8 @@ ioeta_update(ioeta_estim_t *estim, const char path[], int finished,
 		return;
 	}
 
+	pthread_mutex_lock(&update_lock);
+
 	estim->current_byte += bytes;
 	if(estim->current_byte > estim->total_bytes)
 	{
@@ -86,7 +221,12 @@ ioeta_update(ioeta_estim_t *estim, const char path[], int finished,
 		replace_string(&estim->item, path);
 	}
 
-	ionotif_notify(IO_PS_IN_PROGRESS, estim);
+	if(!estim->quiet)
+	{
+		ionotif_notify(IO_PS_IN_PROGRESS, estim);
+	}
+
+	pthread_mutex_unlock(&update_lock);
 }
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
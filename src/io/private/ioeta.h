@@ -22,6 +22,7 @@
 #include <stdint.h> /* uint64_t */
 
 #include "../ioeta.h"
+#include "traverser.h"
 
 /* ioeta - private functions of Input/Output estimation */
 
@@ -34,11 +35,36 @@ void ioeta_add_file(ioeta_estim_t *estim, const char path[]);
 /* Adds directory to the estimation. */
 void ioeta_add_dir(ioeta_estim_t *estim, const char path[]);
 
+/* Adds file visited by traverse_at() to the estimation. */
+void ioeta_add_file_at(ioeta_estim_t *estim, const trav_entry_t *entry);
+
+/* Adds directory visited by traverse_at() to the estimation. */
+void ioeta_add_dir_at(ioeta_estim_t *estim, const trav_entry_t *entry);
+
+/* Marks estimation as running concurrently with the operation or finished. */
+void ioeta_set_in_background(ioeta_estim_t *estim, int in_background);
+
+/* Makes updates of the estimation quiet or restores their notifications.  The
+ * estim can be NULL. */
+void ioeta_set_quiet(ioeta_estim_t *estim, int quiet);
+
+/* Calls progress changed notification handler for current state of the
+ * estimation.  The estim can be NULL. */
+void ioeta_notify(ioeta_estim_t *estim);
+
+/* Requests estimation to stop as soon as possible. */
+void ioeta_cancel(ioeta_estim_t *estim);
+
+/* Checks whether estimation was requested to stop.  Returns non-zero if so,
+ * otherwise zero is returned. */
+int ioeta_is_cancelled(ioeta_estim_t *estim);
+
 /* ioeta_update_estim(e, "p", 0, 100); -- 100 bytes of current item processed.
  * ioeta_update_estim(e, "", 1, 50); -- Last 50 bytes of current item processed.
  * Might calculate speed, time, etc.  When estim is NULL, the function just
  * returns.  The path can be NULL to indicate that file name didn't change.
- * Calls progress changed notification handler. */
+ * Calls progress changed notification handler unless estimation is quiet.  Can
+ * be called from several threads, updates are serialized. */
 void ioeta_update(ioeta_estim_t *estim, const char path[], int finished,
 		uint64_t bytes);
 
@@ -18,56 +18,181 @@
 
 #include "traverser.h"
 
-#include <dirent.h> /* DIR dirent opendir() readdir() closedir() */
+#ifndef _WIN32
+#include <fcntl.h> /* AT_FDCWD AT_SYMLINK_NOFOLLOW O_* openat() */
+#include <sys/stat.h> /* S_ISDIR fstatat() stat */
+#include <unistd.h> /* close() */
+#endif
 
-#include <stddef.h> /* NULL */
-#include <stdlib.h> /* free() */
+#include <dirent.h> /* DIR dirent fdopendir() opendir() readdir() closedir() */
+
+#include <stddef.h> /* NULL size_t */
+#include <stdlib.h> /* free() realloc() */
+#include <string.h> /* memcpy() strlen() */
 
 #include "../../utils/fs.h"
 #include "../../utils/path.h"
 #include "../../utils/str.h"
 
-static int traverse_subtree(const char path[], subtree_visitor visitor,
+/* Private state of traversal. */
+struct trav_state_t
+{
+	subtree_visitor_at visitor; /* Visitor of entries. */
+	void *param;                /* Parameter of the visitor. */
+	char *path;                 /* Path of current directory followed by name of
+	                               an entry in it. */
+	size_t path_size;           /* Size of the path buffer. */
+};
+
+/* Parameters of adapter of path-based visitor to traverse_at(). */
+typedef struct
+{
+	subtree_visitor visitor; /* Path-based visitor. */
+	void *param;             /* Parameter of the visitor. */
+}
+path_visitor_t;
+
+static VisitResult path_visitor(const trav_entry_t *entry, VisitAction action,
 		void *param);
+static int traverse_subtree(struct trav_state_t *state,
+		const trav_entry_t *dir_entry, size_t len);
+#ifndef _WIN32
+static int is_dir_entry(int dirfd, const struct dirent *d);
+#endif
 
 int
 traverse(const char path[], subtree_visitor visitor, void *param)
+{
+	path_visitor_t pv = { .visitor = visitor, .param = param };
+	return traverse_at(path, &path_visitor, &pv);
+}
+
+/* Adapts path-based visitor to traverse_at() interface.  Returns result of the
+ * visitor. */
+static VisitResult
+path_visitor(const trav_entry_t *entry, VisitAction action, void *param)
+{
+	const path_visitor_t *const pv = param;
+	const char *const full_path = trav_full_path(entry);
+	if(full_path == NULL)
+	{
+		return VR_ERROR;
+	}
+	return pv->visitor(full_path, action, pv->param);
+}
+
+int
+traverse_at(const char path[], subtree_visitor_at visitor, void *param)
 {
 	/* Duplication with traverse_subtree(), but this way traverse_subtree() can
 	 * use information from dirent structure to save some operations. */
 
-	if(is_symlink(path))
+	struct trav_state_t state = { .visitor = visitor, .param = param };
+	trav_entry_t root = { .name = path, .state = &state, .is_root = 1 };
+	int result;
+
+#ifndef _WIN32
+	struct stat st;
+
+	root.dirfd = AT_FDCWD;
+
+	/* Tread symbolic links to directories as files as well. */
+	if(fstatat(AT_FDCWD, path, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+			!S_ISDIR(st.st_mode))
+	{
+		return visitor(&root, VA_FILE, param);
+	}
+#else
+	root.dirfd = -1;
+
+	if(is_symlink(path) || !is_dir(path))
 	{
 		/* Tread symbolic links to directories as files as well. */
-		return visitor(path, VA_FILE, param);
+		return visitor(&root, VA_FILE, param);
 	}
-	else if(is_dir(path))
+#endif
+
+	state.path = strdup(path);
+	if(state.path == NULL)
 	{
-		return traverse_subtree(path, visitor, param);
+		return 1;
 	}
-	else
+	state.path_size = strlen(path) + 1U;
+
+	result = traverse_subtree(&state, &root, strlen(path));
+	free(state.path);
+	return result;
+}
+
+const char *
+trav_full_path(const trav_entry_t *entry)
+{
+#ifndef _WIN32
+	struct trav_state_t *const state = entry->state;
+	size_t name_len;
+	size_t size;
+
+	if(entry->is_root)
+	{
+		return entry->name;
+	}
+
+	name_len = strlen(entry->name);
+	size = entry->prefix_len + 1U + name_len + 1U;
+	if(size > state->path_size)
 	{
-		return visitor(path, VA_FILE, param);
+		char *const path = realloc(state->path, size*2U);
+		if(path == NULL)
+		{
+			return NULL;
+		}
+		state->path = path;
+		state->path_size = size*2U;
 	}
+
+	state->path[entry->prefix_len] = '/';
+	memcpy(&state->path[entry->prefix_len + 1U], entry->name, name_len + 1U);
+	return state->path;
+#else
+	return entry->name;
+#endif
 }
 
-/* A generic subtree traversing.  Returns zero on success, otherwise non-zero is
- * returned. */
+/* A generic subtree traversing.  The len is length of path to the directory in
+ * state.  Returns zero on success, otherwise non-zero is returned. */
 static int
-traverse_subtree(const char path[], subtree_visitor visitor, void *param)
+traverse_subtree(struct trav_state_t *state, const trav_entry_t *dir_entry,
+		size_t len)
 {
 	DIR *dir;
 	struct dirent *d;
 	int result;
 	VisitResult enter_result;
+#ifndef _WIN32
+	int fd;
+
+	fd = openat(dir_entry->dirfd, dir_entry->name,
+			O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if(fd == -1)
+	{
+		return 1;
+	}
 
-	dir = opendir(path);
+	dir = fdopendir(fd);
+	if(dir == NULL)
+	{
+		(void)close(fd);
+		return 1;
+	}
+#else
+	dir = opendir(dir_entry->name);
 	if(dir == NULL)
 	{
 		return 1;
 	}
+#endif
 
-	enter_result = visitor(path, VA_DIR_ENTER, param);
+	enter_result = state->visitor(dir_entry, VA_DIR_ENTER, state->param);
 	if(enter_result == VR_ERROR)
 	{
 		(void)closedir(dir);
@@ -77,28 +202,55 @@ traverse_subtree(const char path[], subtree_visitor visitor, void *param)
 	result = 0;
 	while((d = readdir(dir)) != NULL)
 	{
-		if(!is_builtin_dir(d->d_name))
+		trav_entry_t entry = { .state = state, .prefix_len = len };
+		int entry_is_directory;
+#ifdef _WIN32
+		char *full_path;
+#endif
+
+		if(is_builtin_dir(d->d_name))
 		{
-			char *const full_path = format_str("%s/%s", path, d->d_name);
-			if(entry_is_link(full_path, d))
-			{
-				/* Tread symbolic links to directories as files as well. */
-				result = visitor(full_path, VA_FILE, param);
-			}
-			else if(entry_is_dir(full_path, d))
+			continue;
+		}
+
+#ifndef _WIN32
+		entry.dirfd = fd;
+		entry.name = d->d_name;
+		entry_is_directory = is_dir_entry(fd, d);
+#else
+		full_path = format_str("%s/%s", dir_entry->name, d->d_name);
+		entry.dirfd = -1;
+		entry.name = full_path;
+		/* Tread symbolic links to directories as files as well. */
+		entry_is_directory = !entry_is_link(full_path, d)
+		                  && entry_is_dir(full_path, d);
+#endif
+
+		if(entry_is_directory)
+		{
+			/* Path of the directory is a prefix for paths of its entries. */
+			if(trav_full_path(&entry) == NULL)
 			{
-				result = traverse_subtree(full_path, visitor, param);
+				result = 1;
 			}
 			else
 			{
-				result = visitor(full_path, VA_FILE, param);
+				result = traverse_subtree(state, &entry,
+						len + 1U + strlen(d->d_name));
 			}
-			free(full_path);
+		}
+		else
+		{
+			result = state->visitor(&entry, VA_FILE, state->param);
+		}
 
-			if(result != 0)
-			{
-				break;
-			}
+#ifdef _WIN32
+		free(full_path);
+#endif
+
+		if(result != 0)
+		{
+			break;
 		}
 	}
 	(void)closedir(dir);
@@ -106,11 +258,31 @@ traverse_subtree(const char path[], subtree_visitor visitor, void *param)
 	if(result == 0 && enter_result != VR_SKIP_DIR_LEAVE &&
 			enter_result != VR_CANCELLED)
 	{
-		result = visitor(path, VA_DIR_LEAVE, param);
+		result = state->visitor(dir_entry, VA_DIR_LEAVE, state->param);
 	}
 
 	return result;
 }
 
+#ifndef _WIN32
+
+/* Checks whether entry of a directory is a directory itself without following
+ * symbolic links.  Returns non-zero if so, otherwise zero is returned. */
+static int
+is_dir_entry(int dirfd, const struct dirent *d)
+{
+	struct stat st;
+
+	if(d->d_type != DT_UNKNOWN)
+	{
+		return d->d_type == DT_DIR;
+	}
+
+	return fstatat(dirfd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0
+	    && S_ISDIR(st.st_mode);
+}
+
+#endif
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 : */
@@ -19,6 +19,8 @@
 #ifndef VIFM__IO__PRIVATE__TRAVERSER_H__
 #define VIFM__IO__PRIVATE__TRAVERSER_H__
 
+#include <stddef.h> /* size_t */
+
 /* Reason why file system traverse visitor is called. */
 typedef enum
 {
@@ -38,6 +40,31 @@ typedef enum
 }
 VisitResult;
 
+/* Private state of traversal. */
+struct trav_state_t;
+
+/* Entry of file system visited by traverse_at(). */
+typedef struct
+{
+	/* Descriptor of directory that contains the entry, AT_FDCWD for the root of
+	 * traversal.  Always -1 on Windows. */
+	int dirfd;
+	/* Name of the entry relative to dirfd, full path on Windows. */
+	const char *name;
+
+	struct trav_state_t *state; /* Traversal this entry belongs to. */
+	size_t prefix_len;          /* Length of path to parent directory in the
+	                               state, full path is formed on request. */
+	int is_root;                /* Whether this is the root of traversal. */
+}
+trav_entry_t;
+
+/* Handler for file system traversing algorithm that uses descriptors of
+ * directories.  Must return 0 on success, otherwise directory traverse will be
+ * stopped. */
+typedef VisitResult (*subtree_visitor_at)(const trav_entry_t *entry,
+		VisitAction action, void *param);
+
 /* Generic handler for file system traversing algorithm.  Must return 0 on
  * success, otherwise directory traverse will be stopped. */
 typedef VisitResult (*subtree_visitor)(const char full_path[],
@@ -47,6 +74,16 @@ typedef VisitResult (*subtree_visitor)(const char full_path[],
  * success, otherwise non-zero is returned. */
 int traverse(const char path[], subtree_visitor visitor, void *param);
 
+/* Same as traverse(), but keeps descriptors of directories open and visits
+ * entries by descriptor of parent directory and name, so that visitors can use
+ * *at() family of functions instead of resolving full paths.  Returns zero on
+ * success, otherwise non-zero is returned. */
+int traverse_at(const char path[], subtree_visitor_at visitor, void *param);
+
+/* Forms full path of the entry.  Returns pointer to internal buffer, which is
+ * valid until visitor returns, or NULL on memory allocation failure. */
+const char * trav_full_path(const trav_entry_t *entry);
+
 #endif // VIFM__IO__PRIVATE__TRAVERSER_H__
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
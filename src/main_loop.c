@@ -50,6 +50,7 @@ static void process_scheduled_updates(void);
 static void process_scheduled_updates_of_view(FileView *view);
 static int should_check_views_for_changes(void);
 static void check_view_for_changes(FileView *view);
+static int load_dir_lists_portions(void);
 
 static wchar_t buf[128];
 static int pos;
@@ -90,7 +91,16 @@ read_char(WINDOW *win, wint_t *c, int timeout)
 		for(j = 0; j < IPC_F; j++)
 		{
 			ipc_check();
-			wtimeout(win, MIN(T, timeout)/IPC_F);
+
+			/* Don't wait for input while there are directories to read. */
+			if(load_dir_lists_portions())
+			{
+				wtimeout(win, 0);
+			}
+			else
+			{
+				wtimeout(win, MIN(T, timeout)/IPC_F);
+			}
 
 			if((result = wget_wch(win, c)) != ERR)
 			{
@@ -350,6 +360,16 @@ check_view_for_changes(FileView *view)
 	}
 }
 
+/* Continues reading of large directories displayed in views.  Returns non-zero
+ * if there is more to read, otherwise zero is returned. */
+static int
+load_dir_lists_portions(void)
+{
+	const int curr_loading = load_dir_list_portion(curr_view);
+	const int other_loading = load_dir_list_portion(other_view);
+	return curr_loading || other_loading;
+}
+
 void
 update_input_buf(void)
 {
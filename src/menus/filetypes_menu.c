@@ -20,6 +20,7 @@
 #include "filetypes_menu.h"
 
 #include <stdio.h> /* snprintf() */
+#include <stdlib.h> /* free() malloc() */
 #include <string.h> /* strdup() strlen() */
 
 #include "../modes/menu.h"
@@ -38,6 +39,7 @@ static const char * form_filetype_menu_entry(assoc_record_t prog,
 		int descr_width);
 static const char * form_filetype_data_entry(assoc_record_t prog);
 static int execute_filetype_cb(FileView *view, menu_info *m);
+static void prefetch_view_mimetypes(const FileView *view);
 
 int
 show_filetypes_menu(FileView *view, int background)
@@ -51,6 +53,8 @@ show_filetypes_menu(FileView *view, int background)
 	assoc_records_t ft = get_all_programs_for_file(filename);
 	assoc_records_t magic = get_magic_handlers(filename);
 
+	prefetch_view_mimetypes(view);
+
 	init_menu_info(&m, FILETYPE_MENU,
 			strdup("No programs set for this filetype"));
 
@@ -149,5 +153,26 @@ execute_filetype_cb(FileView *view, menu_info *m)
 	return 0;
 }
 
+/* Starts determining mime types of all files of the view in background to
+ * speed up next invocations of the menu in the same directory. */
+static void
+prefetch_view_mimetypes(const FileView *view)
+{
+	int i;
+	char **const names = malloc(sizeof(*names)*view->list_rows);
+	if(names == NULL)
+	{
+		return;
+	}
+
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		names[i] = view->dir_entry[i].name;
+	}
+	(void)prefetch_mimetypes(view->curr_dir, names, view->list_rows);
+
+	free(names);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 : */
@@ -20,7 +20,8 @@
 #include "jobs_menu.h"
 
 #include <stdio.h> /* snprintf() */
-#include <string.h> /* strlen() strdup() */
+#include <stdlib.h> /* free() realloc() */
+#include <string.h> /* strdup() */
 
 #include "../modes/menu.h"
 #include "../utils/str.h"
@@ -29,7 +30,13 @@
 #include "../ui.h"
 #include "menus.h"
 
+static char * format_job_item(const job_t *job);
 static int execute_jobs_cb(FileView *view, menu_info *m);
+static void reset_jobs_cb(menu_info *m);
+static int is_job_alive(const job_t *job);
+
+/* Jobs that correspond to menu items. */
+static job_t **menu_jobs;
 
 int
 show_jobs_menu(FileView *view)
@@ -41,6 +48,7 @@ show_jobs_menu(FileView *view)
 	init_menu_info(&m, JOBS_MENU, strdup("No jobs currently running"));
 	m.title = strdup(" Pid --- Command ");
 	m.execute_handler = &execute_jobs_cb;
+	m.reset_handler = &reset_jobs_cb;
 
 	check_background_jobs();
 
@@ -53,24 +61,22 @@ show_jobs_menu(FileView *view)
 	{
 		if(p->running)
 		{
-			char info_buf[24];
-			char item_buf[sizeof(info_buf) + strlen(p->cmd)];
-
-			if(p->type == BJT_COMMAND)
+			job_t **const new_jobs = realloc(menu_jobs, sizeof(*menu_jobs)*(i + 1));
+			char *const item = format_job_item(p);
+			if(new_jobs != NULL)
 			{
-				snprintf(info_buf, sizeof(info_buf), PRINTF_PID_T, p->pid);
+				menu_jobs = new_jobs;
 			}
-			else if(p->total == BG_UNDEFINED_TOTAL)
+
+			if(new_jobs == NULL || item == NULL)
 			{
-				snprintf(info_buf, sizeof(info_buf), "n/a");
+				free(item);
 			}
 			else
 			{
-				snprintf(info_buf, sizeof(info_buf), "%d/%d", p->done + 1, p->total);
+				menu_jobs[i] = p;
+				i = put_into_string_array(&m.items, i, item);
 			}
-
-			snprintf(item_buf, sizeof(item_buf), "%-8s  %s", info_buf, p->cmd);
-			i = add_to_string_array(&m.items, i, 1, item_buf);
 		}
 
 		p = p->next;
@@ -83,12 +89,81 @@ show_jobs_menu(FileView *view)
 	return display_menu(&m, view);
 }
 
-/* Callback that is called when menu item is selected.  Should return non-zero
- * to stay in menu mode. */
+/* Formats menu item that describes the job.  Returns newly allocated string or
+ * NULL on error. */
+static char *
+format_job_item(const job_t *job)
+{
+	char info_buf[24];
+
+	if(job->type == BJT_COMMAND)
+	{
+		snprintf(info_buf, sizeof(info_buf), PRINTF_PID_T, job->pid);
+	}
+	else if(job->total == BG_UNDEFINED_TOTAL)
+	{
+		snprintf(info_buf, sizeof(info_buf), "n/a");
+	}
+	else
+	{
+		snprintf(info_buf, sizeof(info_buf), "%d/%d", job->done + 1, job->total);
+	}
+
+	return format_str("%-8s  %s%s", info_buf, job->cmd,
+			job->paused ? " (paused)" : "");
+}
+
+/* Callback that is called when menu item is selected.  Pauses or resumes the
+ * job if it supports that.  Should return non-zero to stay in menu mode. */
 static int
 execute_jobs_cb(FileView *view, menu_info *m)
 {
-	/* TODO write code for job control */
+	job_t *const job = menu_jobs[m->pos];
+	char *item;
+
+	bg_jobs_freeze();
+
+	if(!is_job_alive(job) || bg_job_toggle_pause(job) != 0)
+	{
+		bg_jobs_unfreeze();
+		return 0;
+	}
+
+	item = format_job_item(job);
+	if(item != NULL)
+	{
+		free(m->items[m->pos]);
+		m->items[m->pos] = item;
+	}
+
+	bg_jobs_unfreeze();
+
+	draw_menu(m);
+	return 1;
+}
+
+/* Callback that is called when menu is closed.  Frees list of jobs that
+ * correspond to menu items. */
+static void
+reset_jobs_cb(menu_info *m)
+{
+	free(menu_jobs);
+	menu_jobs = NULL;
+}
+
+/* Checks that the job is still in the list of jobs and is running.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+is_job_alive(const job_t *job)
+{
+	const job_t *p;
+	for(p = jobs; p != NULL; p = p->next)
+	{
+		if(p == job)
+		{
+			return p->running;
+		}
+	}
 	return 0;
 }
 
@@ -289,12 +289,18 @@ init_menu_info(menu_info *m, int menu_type, char empty_msg[])
 	m->key_handler = NULL;
 	m->extra_data = 0;
 	m->execute_handler = NULL;
+	m->reset_handler = NULL;
 	m->empty_msg = empty_msg;
 }
 
 void
 reset_popup_menu(menu_info *m)
 {
+	if(m->reset_handler != NULL)
+	{
+		m->reset_handler(m);
+	}
+
 	free(m->args);
 	/* Menu elements don't always have data associated with them.  That's why we
 	 * need this check. */
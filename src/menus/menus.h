@@ -102,6 +102,9 @@ typedef struct menu_info
 	/* Callback that is called when menu item is selected.  Should return non-zero
 	 * to stay in menu mode. */
 	int (*execute_handler)(FileView *view, struct menu_info *m);
+	/* Callback that is called by reset_popup_menu() to free menu-specific state,
+	 * can be NULL. */
+	void (*reset_handler)(struct menu_info *m);
 	/* Text displayed by display_menu() function in case menu is empty, it can be
 	 * NULL if this cannot happen and will be freed by reset_popup_menu(). */
 	char *empty_msg;
@@ -50,6 +50,7 @@ show_trash_menu(FileView *view)
 		const trash_entry_t *const entry = &trash_list[i];
 		if(is_under_trash(entry->trash_name))
 		{
+			(void)add_to_string_array(&m.data, m.len, 1, entry->trash_name);
 			m.len = add_to_string_array(&m.items, m.len, 1, entry->path);
 		}
 	}
@@ -64,7 +65,7 @@ trash_khandler(menu_info *m, const wchar_t keys[])
 {
 	if(wcscmp(keys, L"r") == 0)
 	{
-		char *const trash_path = strdup(trash_list[m->pos].trash_name);
+		char *const trash_path = strdup(m->data[m->pos]);
 
 		cmd_group_begin("restore: ");
 		cmd_group_end();
@@ -79,6 +80,7 @@ trash_khandler(menu_info *m, const wchar_t keys[])
 		}
 		free(trash_path);
 
+		remove_from_string_array(m->data, m->len, m->pos);
 		remove_current_item(m);
 		return KHR_REFRESH_WINDOW;
 	}
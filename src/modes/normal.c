@@ -1014,6 +1014,9 @@ static void
 cmd_G(key_info_t key_info, keys_info_t *keys_info)
 {
 	int new_pos;
+
+	finish_dir_list_loading(curr_view);
+
 	if(key_info.count == NO_COUNT_GIVEN)
 		key_info.count = curr_view->list_rows;
 
@@ -1047,6 +1050,8 @@ cmd_gf(key_info_t key_info, keys_info_t *keys_info)
 static void
 cmd_gg(key_info_t key_info, keys_info_t *keys_info)
 {
+	finish_dir_list_loading(curr_view);
+
 	if(key_info.count == NO_COUNT_GIVEN)
 		key_info.count = 1;
 
@@ -1262,6 +1267,7 @@ cmd_percent(key_info_t key_info, keys_info_t *keys_info)
 		return;
 	if(key_info.count > 100)
 		return;
+	finish_dir_list_loading(curr_view);
 	line = (key_info.count * curr_view->list_rows)/100;
 	pick_or_move(keys_info, line - 1);
 }
@@ -25,6 +25,7 @@
 #include <unistd.h> /* R_OK access() */
 
 #include <assert.h> /* assert() */
+#include <limits.h> /* INT_MAX */
 #include <stddef.h> /* ptrdiff_t size_t */
 #include <string.h> /* strcpy() strdup() strlen() */
 #include <stdio.h>  /* fclose() fopen() snprintf() */
@@ -39,7 +40,7 @@
 #include "../utils/macros.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
-#include "../utils/string_array.h"
+#include "../utils/text_index.h"
 #include "../utils/utf8.h"
 #include "../utils/utils.h"
 #include "../color_manager.h"
@@ -61,20 +62,15 @@
 
 typedef struct
 {
-	char **lines;
-	int (*widths)[2];
-	int nlines;
-	int nlinesv;
-	int line;
-	int linev;
+	text_index_t *text; /* Contents of the file. */
+	size_t line;        /* Beginning of the topmost displayed line. */
+	int linev;          /* Virtual line of the topmost line displayed first. */
 	int win_size; /* Scroll window size. */
 	int half_win;
-	int width;
 	FileView *view;
 	regex_t re;
 	int last_search_backward; /* Value -1 means no search was performed. */
 	int search_repeat; /* Saved count prefix of search commands. */
-	int wrap;
 	int abandoned; /* Shows whether view mode was abandoned. */
 	char *filename;
 }view_info_t;
@@ -94,9 +90,11 @@ static void reset_view_info(view_info_t *vi);
 static void init_view_info(view_info_t *vi);
 static void free_view_info(view_info_t *vi);
 static void redraw(void);
-static void calc_vlines(void);
-static void calc_vlines_wrapped(view_info_t *vi);
-static void calc_vlines_non_wrapped(view_info_t *vi);
+static int get_line_height(size_t line);
+static int get_text_height(const char text[]);
+static int step_down(size_t *line, int *linev);
+static int step_up(size_t *line, int *linev);
+static void get_last_screen_top(size_t *line, int *linev);
 static void draw(void);
 static int get_part(const char line[], int offset, size_t max_len, char part[]);
 static void display_error(const char error_msg[]);
@@ -378,8 +376,20 @@ view_post(void)
 void
 view_draw_pos(void)
 {
-	char buf[POS_WIN_WIDTH + 1];
-	snprintf(buf, sizeof(buf), "%d-%d ", vi->line + 1, vi->nlines);
+	char buf[64];
+	int line, count;
+	/* Line numbers are estimated until the file is indexed that far, single mark
+	 * is used for both numbers to fit them into the window. */
+	const int line_estimated = text_index_number(vi->text, vi->line, &line);
+	const int count_estimated = text_index_count(vi->text, &count);
+
+	snprintf(buf, sizeof(buf), "%s%d-%d ",
+			(line_estimated || count_estimated) ? "~" : "", line + 1, count);
+	/* Huge numbers don't fit into the window, so cut what doesn't fit. */
+	if(strlen(buf) > POS_WIN_WIDTH)
+	{
+		buf[POS_WIN_WIDTH] = '\0';
+	}
 
 	ui_pos_window_set(buf);
 }
@@ -468,19 +478,14 @@ reset_view_info(view_info_t *vi)
 static void
 init_view_info(view_info_t *vi)
 {
-	vi->lines = NULL;
-	vi->widths = NULL;
-	vi->nlines = 0;
-	vi->nlinesv = 0;
+	vi->text = NULL;
 	vi->line = 0;
 	vi->linev = 0;
 	vi->win_size = -1;
 	vi->half_win = -1;
-	vi->width = -1;
 	vi->view = NULL;
 	vi->last_search_backward = -1;
 	vi->search_repeat = NO_COUNT_GIVEN;
-	vi->wrap = 0;
 	vi->filename = NULL;
 	vi->abandoned = 0;
 }
@@ -489,8 +494,7 @@ init_view_info(view_info_t *vi)
 static void
 free_view_info(view_info_t *vi)
 {
-	free_string_array(vi->lines, vi->nlines);
-	free(vi->widths);
+	text_index_free(vi->text);
 	if(vi->last_search_backward != -1)
 	{
 		regfree(&vi->re);
@@ -498,96 +502,143 @@ free_view_info(view_info_t *vi)
 	free(vi->filename);
 }
 
-/* Updates line width and redraws the view. */
+/* Updates position for current line width and redraws the view. */
 static void
 redraw(void)
 {
 	ui_view_title_update(vi->view);
-	calc_vlines();
+	/* Top line could take more screen lines before resizing or change of
+	 * wrapping. */
+	vi->linev = MIN(vi->linev, get_line_height(vi->line) - 1);
 	draw();
 }
 
-/* Recalculates virtual lines of a view if display options require it. */
-static void
-calc_vlines(void)
+/* Computes number of screen lines occupied by the line.  Returns the
+ * number. */
+static int
+get_line_height(size_t line)
 {
-	if(vi->view->window_width - 1 == vi->width && vi->wrap == cfg.wrap_quick_view)
+	char *const text = text_index_get_line(vi->text, line);
+	const int height = (text == NULL) ? 1 : get_text_height(text);
+	free(text);
+	return height;
+}
+
+/* Computes number of screen lines occupied by text of a line.  Returns the
+ * number. */
+static int
+get_text_height(const char text[])
+{
+	const int width = vi->view->window_width - 1;
+	int len;
+
+	if(!cfg.wrap_quick_view || width <= 0)
 	{
-		return;
+		return 1;
 	}
 
-	vi->width = vi->view->window_width - 1;
-	vi->wrap = cfg.wrap_quick_view;
+	len = get_screen_string_length(text) - esc_str_overhead(text);
+	return MAX((len + width - 1)/width, 1);
+}
 
-	if(vi->wrap)
+/* Moves position one screen line down.  Returns zero on success and non-zero
+ * if the position is at the last screen line. */
+static int
+step_down(size_t *line, int *linev)
+{
+	if(*linev + 1 < get_line_height(*line))
 	{
-		calc_vlines_wrapped(vi);
+		++*linev;
+		return 0;
 	}
-	else
+
+	if(text_index_next(vi->text, *line, line) != 0)
 	{
-		calc_vlines_non_wrapped(vi);
+		return 1;
 	}
+
+	*linev = 0;
+	return 0;
 }
 
-/* Recalculates virtual lines of a view with line wrapping. */
-static void
-calc_vlines_wrapped(view_info_t *vi)
+/* Moves position one screen line up.  Returns zero on success and non-zero if
+ * the position is at the first screen line. */
+static int
+step_up(size_t *line, int *linev)
 {
-	int i;
-	vi->nlinesv = 0;
-	for(i = 0; i < vi->nlines; i++)
+	if(*linev > 0)
 	{
-		vi->widths[i][0] = vi->nlinesv++;
-		vi->widths[i][1] = get_screen_string_length(vi->lines[i]) -
-			esc_str_overhead(vi->lines[i]);
-		vi->nlinesv += vi->widths[i][1]/vi->width;
+		--*linev;
+		return 0;
 	}
+
+	if(text_index_prev(vi->text, *line, line) != 0)
+	{
+		return 1;
+	}
+
+	*linev = get_line_height(*line) - 1;
+	return 0;
 }
 
-/* Recalculates virtual lines of a view without line wrapping. */
+/* Finds top position at which the last screen line of the text is displayed
+ * at the bottom of the view. */
 static void
-calc_vlines_non_wrapped(view_info_t *vi)
+get_last_screen_top(size_t *line, int *linev)
 {
 	int i;
-	vi->nlinesv = vi->nlines;
-	for(i = 0; i < vi->nlines; i++)
+
+	*line = text_index_last(vi->text);
+	*linev = get_line_height(*line) - 1;
+
+	for(i = 0; i < vi->view->window_rows - 2; ++i)
 	{
-		vi->widths[i][0] = i;
-		vi->widths[i][1] = vi->width;
+		if(step_up(line, linev) != 0)
+		{
+			break;
+		}
 	}
 }
 
 static void
 draw(void)
 {
-	int l, vl;
+	int vl;
+	size_t l;
+	int more;
 	const int height = vi->view->window_rows - 1;
 	const int width = vi->view->window_width - 1;
-	const int max_l = MIN(vi->line + height, vi->nlines);
 	const int searched = (vi->last_search_backward != -1);
 	esc_state state;
 	esc_state_init(&state, &vi->view->cs.color[WIN_COLOR]);
 	werase(vi->view->win);
-	for(vl = 0, l = vi->line; l < max_l && vl < height; l++)
+	for(vl = 0, l = vi->line, more = 1; more && vl < height;
+			more = (text_index_next(vi->text, l, &l) == 0))
 	{
 		int offset = 0;
 		int t = 0;
-		char *const line = vi->lines[l];
-		char *p = searched ? esc_highlight_pattern(line, &vi->re) : line;
+		char *const line = text_index_get_line(vi->text, l);
+		char *p;
+		if(line == NULL)
+		{
+			break;
+		}
+		p = searched ? esc_highlight_pattern(line, &vi->re) : line;
 		do
 		{
 			int printed;
-			int vis = l != vi->line || vl + t >= vi->linev - vi->widths[vi->line][0];
+			int vis = l != vi->line || t >= vi->linev;
 			offset += esc_print_line(p + offset, vi->view->win, COL, 1 + vl, width,
 					!vis, &state, &printed);
 			vl += vis;
 			t++;
 		}
-		while(vi->wrap && p[offset] != '\0' && vl < height);
+		while(cfg.wrap_quick_view && p[offset] != '\0' && vl < height);
 		if(searched)
 		{
 			free(p);
 		}
+		free(line);
 	}
 	refresh_view_win(vi->view);
 }
@@ -846,10 +897,8 @@ cmd_percent(key_info_t key_info, keys_info_t *keys_info)
 	if(key_info.count > 100)
 		key_info.count = 100;
 
-	vi->line = (key_info.count*vi->nlinesv)/100;
-	if(vi->line >= vi->nlines)
-		vi->line = vi->nlines - 1;
-	vi->linev = vi->widths[vi->line][0];
+	vi->line = text_index_at_percent(vi->text, key_info.count);
+	vi->linev = 0;
 	draw();
 }
 
@@ -898,20 +947,21 @@ cmd_qmark(key_info_t key_info, keys_info_t *keys_info)
 static void
 cmd_G(key_info_t key_info, keys_info_t *keys_info)
 {
+	size_t line;
+	int linev;
+
 	if(key_info.count != NO_COUNT_GIVEN)
 	{
 		cmd_g(key_info, keys_info);
 		return;
 	}
 
-	if(vi->linev + 1 + vi->view->window_rows - 1 > vi->nlinesv)
+	get_last_screen_top(&line, &linev);
+	if(vi->line > line || (vi->line == line && vi->linev >= linev))
 		return;
 
-	vi->linev = vi->nlinesv - (vi->view->window_rows - 1);
-	for(vi->line = 0; vi->line < vi->nlines - 1; vi->line++)
-		if(vi->linev < vi->widths[vi->line + 1][0])
-			break;
-
+	vi->line = line;
+	vi->linev = linev;
 	draw();
 }
 
@@ -965,27 +1015,16 @@ load_view_data(view_info_t *vi, const char action[], const char file_to_view[])
 			return 1;
 	}
 
-	vi->widths = malloc(sizeof(*vi->widths)*vi->nlines);
-	if(vi->widths == NULL)
-	{
-		free_string_array(vi->lines, vi->nlines);
-		vi->lines = NULL;
-		vi->nlines = 0;
-		show_error_msg(action, "Not enough memory");
-		return 1;
-	}
-
 	return 0;
 }
 
-/* Reads data to be displayed handling error cases.  Returns zero on success, 1
- * if file is a directory, 2 on file reading error, 3 on issues with viewer or
+/* Reads data to be displayed handling error cases.  Files are read into memory
+ * at once and their lines are indexed in background.  Returns zero on success,
+ * 1 if file is a directory, 2 on file reading error, 3 on issues with viewer or
  * 4 on empty input. */
 static int
 get_view_data(view_info_t *vi, const char file_to_view[])
 {
-	FILE *fp;
-
 	const char *const viewer =
 		get_viewer_for_file(get_last_path_component(file_to_view));
 
@@ -995,27 +1034,33 @@ get_view_data(view_info_t *vi, const char file_to_view[])
 		{
 			return 1;
 		}
-		else if((fp = fopen(file_to_view, "rb")) == NULL)
+		else if((vi->text = text_index_open(file_to_view)) == NULL)
 		{
 			return 2;
 		}
 	}
-	else if((fp = use_info_prog(viewer)) == NULL)
+	else
 	{
-		return 3;
-	}
-
-	vi->lines = is_null_or_empty(viewer)
-		? read_file_lines(fp, &vi->nlines)
-		: read_stream_lines(fp, &vi->nlines);
+		FILE *const fp = use_info_prog(viewer);
+		if(fp == NULL)
+		{
+			return 3;
+		}
 
-	fclose(fp);
+		vi->text = text_index_read(fp);
+		fclose(fp);
+	}
 
-	if(vi->lines == NULL || vi->nlines == 0)
+	if(vi->text == NULL || text_index_is_empty(vi->text))
 	{
+		text_index_free(vi->text);
+		vi->text = NULL;
 		return 4;
 	}
 
+	/* Navigation doesn't depend on the index, so it's fine if this fails. */
+	(void)text_index_start_bg(vi->text);
+
 	return 0;
 }
 
@@ -1024,6 +1069,8 @@ get_view_data(view_info_t *vi, const char file_to_view[])
 static void
 replace_vi(view_info_t *const orig, view_info_t *const new)
 {
+	int number;
+
 	new->filename = orig->filename;
 	orig->filename = NULL;
 
@@ -1036,8 +1083,8 @@ replace_vi(view_info_t *const orig, view_info_t *const new)
 
 	new->win_size = orig->win_size;
 	new->half_win = orig->half_win;
-	new->line = orig->line;
-	new->linev = orig->linev;
+	(void)text_index_number(orig->text, orig->line, &number);
+	(void)text_index_find(new->text, number, &new->line);
 	new->view = orig->view;
 
 	free_view_info(orig);
@@ -1078,74 +1125,76 @@ check_and_set_from_default_win(key_info_t *const key_info)
 static void
 cmd_g(key_info_t key_info, keys_info_t *keys_info)
 {
+	size_t line, last_line;
+	int last_linev;
+
 	if(key_info.count == NO_COUNT_GIVEN)
 		key_info.count = 1;
-
-	key_info.count = MIN(vi->nlinesv - (vi->view->window_rows - 1),
-			key_info.count);
 	key_info.count = MAX(1, key_info.count);
 
-	if(vi->linev == vi->widths[key_info.count - 1][0])
+	(void)text_index_find(vi->text, key_info.count - 1, &line);
+
+	/* Don't leave empty space at the bottom of the view. */
+	get_last_screen_top(&last_line, &last_linev);
+	if(line > last_line)
+	{
+		line = last_line;
+	}
+
+	if(vi->line == line && vi->linev == 0)
 		return;
-	vi->line = key_info.count - 1;
-	vi->linev = vi->widths[vi->line][0];
+	vi->line = line;
+	vi->linev = 0;
 	draw();
 }
 
 static void
 cmd_j(key_info_t key_info, keys_info_t *keys_info)
 {
+	/* Bottom position is kept ahead of the top one to know when to stop without
+	 * processing the rest of the file. */
+	size_t bottom = vi->line;
+	int bottomv = vi->linev;
+	int moved = 0;
+	int i;
+
 	if(key_info.reg == NO_REG_GIVEN)
 	{
-		if((vi->linev + 1) + (vi->view->window_rows - 1) > vi->nlinesv)
-			return;
-	}
-	else
-	{
-		if(vi->linev + 1 > vi->nlinesv)
-			return;
+		for(i = 0; i < vi->view->window_rows - 2; ++i)
+		{
+			if(step_down(&bottom, &bottomv) != 0)
+				return;
+		}
 	}
 
 	if(key_info.count == NO_COUNT_GIVEN)
 		key_info.count = 1;
-	if(key_info.reg == NO_REG_GIVEN)
-		key_info.count = MIN(key_info.count,
-				vi->nlinesv - (vi->view->window_rows - 1) - vi->linev);
-	else
-		key_info.count = MIN(key_info.count, vi->nlinesv - vi->linev - 1);
 
-	while(key_info.count-- > 0)
+	while(key_info.count-- > 0 && step_down(&bottom, &bottomv) == 0)
 	{
-		size_t height = (vi->widths[vi->line][1] + vi->width - 1)/vi->width;
-		height = MAX(height, 1);
-		if(vi->linev + 1 >= vi->widths[vi->line][0] + height)
-			vi->line++;
-
-		vi->linev++;
+		(void)step_down(&vi->line, &vi->linev);
+		moved = 1;
 	}
 
-	draw();
+	if(moved)
+		draw();
 }
 
 static void
 cmd_k(key_info_t key_info, keys_info_t *keys_info)
 {
-	if(vi->linev == 0)
-		return;
+	int moved = 0;
 
 	if(key_info.count == NO_COUNT_GIVEN)
 		key_info.count = 1;
-	key_info.count = MIN(key_info.count, vi->linev);
 
-	while(key_info.count-- > 0)
+	while(key_info.count-- > 0 && step_up(&vi->line, &vi->linev) == 0)
 	{
-		if(vi->linev - 1 < vi->widths[vi->line][0])
-			vi->line--;
-
-		vi->linev--;
+		moved = 1;
 	}
 
-	draw();
+	if(moved)
+		draw();
 }
 
 static void
@@ -1193,43 +1242,61 @@ search(int repeat_count, int backward)
 static void
 find_previous(int vline_offset)
 {
-	int i;
-	int offset = 0;
 	char buf[(vi->view->window_width - 1)*4];
-	int vl, l;
-
-	vl = vi->linev - vline_offset;
-	l = vi->line;
-
-	if(l > 0 && vl < vi->widths[l][0])
-		l--;
+	size_t l = vi->line;
+	int vl = vi->linev;
+	int found = 0;
+	int i;
 
-	for(i = 0; i <= vl - vi->widths[l][0]; i++)
-		offset = get_part(vi->lines[l], offset, vi->view->window_width - 1, buf);
+	for(i = 0; i < vline_offset; i++)
+	{
+		if(step_up(&l, &vl) != 0)
+		{
+			vl = -1;
+			break;
+		}
+	}
 
 	/* Don't stop until we go above first virtual line of the first line. */
-	while(l >= 0 && vl >= 0)
+	while(vl >= 0)
 	{
-		if(regexec(&vi->re, buf, 0, NULL, 0) == 0)
+		char *const line = text_index_get_line(vi->text, l);
+		int offset = 0;
+		int match = -1;
+		int height;
+
+		if(line == NULL)
+		{
+			break;
+		}
+
+		height = get_text_height(line);
+		for(i = 0; i <= vl && i < height; i++)
+		{
+			offset = get_part(line, offset, vi->view->window_width - 1, buf);
+			if(regexec(&vi->re, buf, 0, NULL, 0) == 0)
+			{
+				match = i;
+			}
+		}
+		free(line);
+
+		if(match >= 0)
 		{
-			vi->linev = vl;
 			vi->line = l;
+			vi->linev = match;
+			found = 1;
 			break;
 		}
-		if(l > 0 && vl - 1 < vi->widths[l][0])
+
+		if(text_index_prev(vi->text, l, &l) != 0)
 		{
-			l--;
-			offset = 0;
-			for(i = 0; i <= vl - 1 - vi->widths[l][0]; i++)
-				offset = get_part(vi->lines[l], offset, vi->view->window_width - 1,
-						buf);
+			break;
 		}
-		else
-			offset = get_part(vi->lines[l], offset, vi->view->window_width - 1, buf);
-		vl--;
+		vl = INT_MAX;
 	}
 	draw();
-	if(vi->line != l)
+	if(!found)
 	{
 		display_error("Pattern not found");
 	}
@@ -1238,41 +1305,42 @@ find_previous(int vline_offset)
 static void
 find_next(void)
 {
-	int i;
-	int offset = 0;
 	char buf[(vi->view->window_width - 1)*4];
-	int vl, l;
-
-	vl = vi->linev + 1;
-	l = vi->line;
+	size_t l = vi->line;
+	int vl = vi->linev + 1;
+	int found = 0;
 
-	if(l < vi->nlines - 1 && vl == vi->widths[l + 1][0])
-		l++;
-
-	for(i = 0; i <= vl - vi->widths[l][0]; i++)
-		offset = get_part(vi->lines[l], offset, vi->view->window_width - 1, buf);
-
-	while(l < vi->nlines)
+	do
 	{
-		if(regexec(&vi->re, buf, 0, NULL, 0) == 0)
+		char *const line = text_index_get_line(vi->text, l);
+		int offset = 0;
+		int height;
+		int i;
+
+		if(line == NULL)
 		{
-			vi->linev = vl;
-			vi->line = l;
 			break;
 		}
-		if(l < vi->nlines && (l == vi->nlines - 1 ||
-				vl + 1 >= vi->widths[l + 1][0]))
+
+		height = get_text_height(line);
+		for(i = 0; i < height; i++)
 		{
-			if(l == vi->nlines - 1)
+			offset = get_part(line, offset, vi->view->window_width - 1, buf);
+			if(i >= vl && regexec(&vi->re, buf, 0, NULL, 0) == 0)
+			{
+				vi->line = l;
+				vi->linev = i;
+				found = 1;
 				break;
-			l++;
-			offset = 0;
+			}
 		}
-		offset = get_part(vi->lines[l], offset, vi->view->window_width - 1, buf);
-		vl++;
+		free(line);
+
+		vl = 0;
 	}
+	while(!found && text_index_next(vi->text, l, &l) == 0);
 	draw();
-	if(vi->line != l)
+	if(!found)
 	{
 		display_error("Pattern not found");
 	}
@@ -1336,9 +1404,11 @@ static void
 cmd_v(key_info_t key_info, keys_info_t *keys_info)
 {
 	char buf[PATH_MAX];
+	int line;
 	snprintf(buf, sizeof(buf), "%s/%s", curr_view->curr_dir,
 			curr_view->dir_entry[curr_view->list_pos].name);
-	(void)view_file(buf, vi->line + (vi->view->window_rows - 1)/2, -1, 1);
+	(void)text_index_number(vi->text, vi->line, &line);
+	(void)view_file(buf, line + (vi->view->window_rows - 1)/2, -1, 1);
 	/* In some cases two redraw operations are needed, otherwise TUI is not fully
 	 * redrawn. */
 	update_screen(UT_REDRAW);
@@ -258,6 +258,9 @@ enter_visual_mode(VisualSubmodes sub_mode)
 		return;
 	}
 
+	/* Selection is stored by positions, which change while list is loaded. */
+	finish_dir_list_loading(curr_view);
+
 	view = curr_view;
 	start_pos = view->list_pos;
 	vle_mode_set(VISUAL_MODE, VMT_PRIMARY);
@@ -27,6 +27,7 @@
 
 #include <assert.h> /* assert() */
 #include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uint64_t */
 #include <stdio.h> /* snprintf() */
 #include <stdlib.h> /* calloc() free() */
 #include <string.h> /* strdup() */
@@ -41,8 +42,10 @@
 #include "utils/log.h"
 #include "utils/macros.h"
 #include "utils/path.h"
+#include "utils/string_array.h"
 #include "utils/utils.h"
 #include "background.h"
+#include "fileops.h"
 #include "status.h"
 #include "trash.h"
 #include "undo.h"
@@ -152,6 +155,9 @@ ops_describe(const ops_t *ops)
 void
 ops_enqueue(ops_t *ops, const char src[], const char dst[])
 {
+	uint64_t size;
+	uint64_t items;
+
 	++ops->total;
 
 	if(ops->estim == NULL)
@@ -160,7 +166,7 @@ ops_enqueue(ops_t *ops, const char src[], const char dst[])
 	}
 
 	/* Check once and cache result, it should be the same for each invocation. */
-	if(ops->estim->total_items == 0)
+	if(ops->total == 1)
 	{
 		switch(ops->main_op)
 		{
@@ -196,11 +202,38 @@ ops_enqueue(ops_t *ops, const char src[], const char dst[])
 		}
 	}
 
+	if(ops->shallow_eta)
+	{
+		ioeta_calculate(ops->estim, src, 1);
+		return;
+	}
+
+	if(!is_symlink(src) && get_dir_estimate(src, &size, &items) == 0)
+	{
+		ioeta_add_known(ops->estim, src, items, size);
+		return;
+	}
+
+	/* Deep estimation is postponed until the operation is started and is then
+	 * performed concurrently with it. */
+	if(add_to_string_array(&ops->eta_paths, ops->eta_count, 1, src) ==
+			ops->eta_count + 1)
+	{
+		++ops->eta_count;
+		return;
+	}
+
 	ui_cancellation_enable();
-	ioeta_calculate(ops->estim, src, ops->shallow_eta);
+	ioeta_calculate(ops->estim, src, 0);
 	ui_cancellation_disable();
 }
 
+void
+ops_enqueue_cheap(ops_t *ops)
+{
+	++ops->total;
+}
+
 void
 ops_advance(ops_t *ops, int succeeded)
 {
@@ -222,6 +255,7 @@ ops_free(ops_t *ops)
 	}
 
 	ioeta_free(ops->estim);
+	free_string_array(ops->eta_paths, ops->eta_count);
 	free(ops->base_dir);
 	free(ops);
 }
@@ -230,6 +264,16 @@ int
 perform_operation(OPS op, ops_t *ops, void *data, const char src[],
 		const char dst[])
 {
+	if(ops != NULL && ops->eta_count != 0)
+	{
+		/* Operation goes on with estimates available so far, they are updated as
+		 * estimation in background progresses. */
+		ioeta_calculate_bg(ops->estim, ops->eta_paths, ops->eta_count);
+		free_string_array(ops->eta_paths, ops->eta_count);
+		ops->eta_paths = NULL;
+		ops->eta_count = 0;
+	}
+
 	return op_funcs[op](ops, data, src, dst);
 }
 
@@ -68,6 +68,9 @@ typedef struct
 	const char *descr;    /* Description of operations. */
 	int shallow_eta;      /* Count only top level items, without recursion. */
 	char *base_dir;       /* Base directory in which operation is taking place. */
+	char **eta_paths;     /* Items whose estimation is postponed until operation
+	                         starts. */
+	int eta_count;        /* Number of elements in eta_paths. */
 }
 ops_t;
 
@@ -81,6 +84,10 @@ const char * ops_describe(const ops_t *ops);
  * estimating performance, it can be NULL. */
 void ops_enqueue(ops_t *ops, const char src[], const char dst[]);
 
+/* Puts new item to the ops without estimating its size.  Meant for operations
+ * whose cost doesn't depend on size of items (e.g. renames). */
+void ops_enqueue_cheap(ops_t *ops);
+
 /* Advances ops to the next item. */
 void ops_advance(ops_t *ops, int succeeded);
 
@@ -98,6 +98,7 @@ static const char * pick_out_decoration(const char classify_item[],
 static void columns_handler(OPT_OP op, optval_t val);
 static void confirm_handler(OPT_OP op, optval_t val);
 static void cpoptions_handler(OPT_OP op, optval_t val);
+static void dirsizecache_handler(OPT_OP op, optval_t val);
 static void dotdirs_handler(OPT_OP op, optval_t val);
 static void fastrun_handler(OPT_OP op, optval_t val);
 static void fillchars_handler(OPT_OP op, optval_t val);
@@ -141,12 +142,14 @@ static void add_column(columns_t columns, column_info_t column_info);
 static int map_name(const char *name);
 static void resort_view(FileView * view);
 static void statusline_handler(OPT_OP op, optval_t val);
+static void statworkers_handler(OPT_OP op, optval_t val);
 static void syscalls_handler(OPT_OP op, optval_t val);
 static void tabstop_handler(OPT_OP op, optval_t val);
 static void timefmt_handler(OPT_OP op, optval_t val);
 static void timeoutlen_handler(OPT_OP op, optval_t val);
 static void trash_handler(OPT_OP op, optval_t val);
 static void trashdir_handler(OPT_OP op, optval_t val);
+static void trashrate_handler(OPT_OP op, optval_t val);
 static void tuioptions_handler(OPT_OP op, optval_t val);
 static void undolevels_handler(OPT_OP op, optval_t val);
 static void vicmd_handler(OPT_OP op, optval_t val);
@@ -298,6 +301,10 @@ options[] =
 	  OPT_CHARSET, cpoptions_count, &cpoptions_vals, &cpoptions_handler,
 	  { .init = &init_cpoptions },
 	},
+	{ "dirsizecache", "",
+	  OPT_INT, 0, NULL, &dirsizecache_handler,
+	  { .ref.int_val = &cfg.dir_size_cache },
+	},
 	{ "dotdirs", "",
 	  OPT_SET, ARRAY_LEN(dotdirs_vals), dotdirs_vals, &dotdirs_handler,
 	  { .ref.set_items = &cfg.dot_dirs },
@@ -404,6 +411,10 @@ options[] =
 	  OPT_STR, 0, NULL, &statusline_handler,
 	  { .ref.str_val = &cfg.status_line },
 	},
+	{ "statworkers", "",
+	  OPT_INT, 0, NULL, &statworkers_handler,
+	  { .ref.int_val = &cfg.stat_workers },
+	},
 	{ "syscalls", "",
 	  OPT_BOOL, 0, NULL, &syscalls_handler,
 	  { .ref.bool_val = &cfg.use_system_calls },
@@ -428,6 +439,10 @@ options[] =
 	  OPT_STRLIST, 0, NULL, &trashdir_handler,
 	  { .init = &init_trash_dir },
 	},
+	{ "trashrate", "",
+	  OPT_INT, 0, NULL, &trashrate_handler,
+	  { .ref.int_val = &cfg.trash_rate },
+	},
 	{ "tuioptions", "to",
 	  OPT_CHARSET, tuioptions_count, &tuioptions_vals, &tuioptions_handler,
 	  { .init = &init_tuioptions },
@@ -944,6 +959,21 @@ cpoptions_handler(OPT_OP op, optval_t val)
 	}
 }
 
+static void
+dirsizecache_handler(OPT_OP op, optval_t val)
+{
+	if(val.int_val < 0)
+	{
+		text_buffer_addf("Argument must be >= 0: %d", val.int_val);
+		error = 1;
+		val.int_val = cfg.dir_size_cache;
+		set_option("dirsizecache", val);
+		return;
+	}
+
+	cfg.dir_size_cache = val.int_val;
+}
+
 static void
 dotdirs_handler(OPT_OP op, optval_t val)
 {
@@ -1477,6 +1507,22 @@ statusline_handler(OPT_OP op, optval_t val)
 	(void)replace_string(&cfg.status_line, val.str_val);
 }
 
+/* Sets number of threads used to query information about files of large
+ * directories. */
+static void
+statworkers_handler(OPT_OP op, optval_t val)
+{
+	if(val.int_val <= 0)
+	{
+		text_buffer_addf("Argument must be positive: %d", val.int_val);
+		error = 1;
+		reset_option_to_default("statworkers");
+		return;
+	}
+
+	cfg.stat_workers = val.int_val;
+}
+
 /* Makes vifm prefer to perform file-system operations with external
  * applications on rather then with system calls.  The option will be eventually
  * removed.  Mostly *nix-like systems are affected. */
@@ -1546,6 +1592,21 @@ trashdir_handler(OPT_OP op, optval_t val)
 	free(expanded_path);
 }
 
+static void
+trashrate_handler(OPT_OP op, optval_t val)
+{
+	if(val.int_val < 0)
+	{
+		text_buffer_addf("Argument must be >= 0: %d", val.int_val);
+		error = 1;
+		val.int_val = 0;
+		set_option("trashrate", val);
+		return;
+	}
+
+	cfg.trash_rate = val.int_val;
+}
+
 /* Parses set of TUI flags and changes appearance configuration accordingly. */
 static void
 tuioptions_handler(OPT_OP op, optval_t val)
@@ -81,6 +81,7 @@ void
 quick_view_file(FileView *view)
 {
 	char buf[PATH_MAX];
+	const dir_entry_t *entry;
 
 	if(curr_stats.load_stage < 2)
 	{
@@ -104,10 +105,10 @@ quick_view_file(FileView *view)
 
 	werase(other_view->win);
 
-	snprintf(buf, sizeof(buf), "%s/%s", view->curr_dir,
-			view->dir_entry[view->list_pos].name);
+	entry = &view->dir_entry[view->list_pos];
+	snprintf(buf, sizeof(buf), "%s/%s", view->curr_dir, entry->name);
 
-	switch(view->dir_entry[view->list_pos].type)
+	switch(entry->type)
 	{
 		case CHARACTER_DEVICE:
 			mvwaddstr(other_view->win, LINE, COL, "File is a Character Device");
@@ -129,7 +130,7 @@ quick_view_file(FileView *view)
 				mvwaddstr(other_view->win, LINE, COL, "Cannot resolve Link");
 				break;
 			}
-			if(!ends_with_slash(buf) && is_dir(buf))
+			if(!ends_with_slash(buf) && entry->link_type == SLT_DIR)
 			{
 				strncat(buf, "/", sizeof(buf) - strlen(buf) - 1);
 			}
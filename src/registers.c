@@ -22,14 +22,17 @@
 #include <sys/stat.h>
 
 #include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uintptr_t */
 #include <stdio.h> /* snprintf() */
 #include <stdlib.h> /* free() realloc() */
 #include <string.h>
 
 #include "utils/fs.h"
+#include "utils/fs_limits.h"
 #include "utils/macros.h"
 #include "utils/str.h"
 #include "utils/string_array.h"
+#include "utils/trie.h"
 #include "utils/utils.h"
 #include "trash.h"
 
@@ -42,9 +45,20 @@
 /* Number of all available registers (excludes 26 uppercase letters). */
 #define NUM_REGISTERS (2 + NUM_LETTER_REGISTERS)
 
+static void append_file(int key, const char file[], int check_existence);
+static int find_in_register(const registers_t *reg, const char file[]);
+static void index_file(const registers_t *reg, int i);
+static void unindex_file(const registers_t *reg, const char file[]);
+static void reindex_register(const registers_t *reg);
+static const char * get_path_key(const char path[], char buf[], size_t buf_len);
+
 /* Data of all registers. */
 static registers_t registers[NUM_REGISTERS];
 
+/* Indexes of registers, which map paths to positions of files in corresponding
+ * registers plus one (zero means absence of the file). */
+static trie_t indexes[NUM_REGISTERS];
+
 /* Names of registers + names of 26 uppercase register names + termination null
  * character. */
 const char valid_registers[] = {
@@ -97,23 +111,25 @@ find_register(int key)
 	return NULL;
 }
 
-static int
-check_for_duplicate_file_names(registers_t *reg, const char file[])
+void
+append_to_register(int key, const char file[])
 {
-	int x;
-	for(x = 0; x < reg->num_files; x++)
-	{
-		if(stroscmp(file, reg->files[x]) == 0)
-			return 1;
-	}
-	return 0;
+	append_file(key, file, 1);
 }
 
 void
-append_to_register(int key, const char file[])
+append_existing_to_register(int key, const char file[])
+{
+	append_file(key, file, 0);
+}
+
+/* Appends the file to the register unless it's already there. */
+static void
+append_file(int key, const char file[], int check_existence)
 {
 	registers_t *reg;
 	struct stat st;
+	int new_len;
 
 	if(key == BLACKHOLE_REG_NAME)
 		return;
@@ -121,13 +137,110 @@ append_to_register(int key, const char file[])
 	if((reg = find_register(key)) == NULL)
 		return;
 
-	if(lstat(file, &st) != 0)
+	if(check_existence && lstat(file, &st) != 0)
 		return;
 
-	if(check_for_duplicate_file_names(reg, file))
+	if(find_in_register(reg, file) >= 0)
 		return;
 
-	reg->num_files = add_to_string_array(&reg->files, reg->num_files, 1, file);
+	new_len = add_to_string_array(&reg->files, reg->num_files, 1, file);
+	if(new_len != reg->num_files)
+	{
+		index_file(reg, reg->num_files);
+		reg->num_files = new_len;
+	}
+}
+
+/* Looks up the file in the register.  Returns its position or -1 if there is
+ * no such file. */
+static int
+find_in_register(const registers_t *reg, const char file[])
+{
+	const trie_t index = indexes[reg - registers];
+	char buf[PATH_MAX];
+	void *data;
+	int i;
+
+	if(index == NULL_TRIE ||
+			trie_get(index, get_path_key(file, buf, sizeof(buf)), &data) != 0)
+	{
+		return -1;
+	}
+
+	i = (int)(uintptr_t)data - 1;
+	/* The file might have been taken out of the register by resetting its entry
+	 * to NULL without packing the register yet. */
+	if(i < 0 || i >= reg->num_files || reg->files[i] == NULL)
+	{
+		return -1;
+	}
+	return i;
+}
+
+/* Makes i-th file of the register searchable. */
+static void
+index_file(const registers_t *reg, int i)
+{
+	trie_t *const index = &indexes[reg - registers];
+	char buf[PATH_MAX];
+
+	if(*index == NULL_TRIE)
+	{
+		*index = trie_create();
+		if(*index == NULL_TRIE)
+		{
+			return;
+		}
+	}
+
+	/* Missing entry in index can't be handled in any meaningful way. */
+	(void)trie_set(*index, get_path_key(reg->files[i], buf, sizeof(buf)),
+			(void *)(uintptr_t)(i + 1));
+}
+
+/* Makes the file of the register unsearchable. */
+static void
+unindex_file(const registers_t *reg, const char file[])
+{
+	const trie_t index = indexes[reg - registers];
+	char buf[PATH_MAX];
+
+	if(index != NULL_TRIE)
+	{
+		(void)trie_set(index, get_path_key(file, buf, sizeof(buf)), NULL);
+	}
+}
+
+/* Builds index of the register from scratch. */
+static void
+reindex_register(const registers_t *reg)
+{
+	int i;
+
+	trie_free(indexes[reg - registers]);
+	indexes[reg - registers] = NULL_TRIE;
+
+	for(i = 0; i < reg->num_files; ++i)
+	{
+		if(reg->files[i] != NULL)
+		{
+			index_file(reg, i);
+		}
+	}
+}
+
+/* Makes key for looking up paths, which accounts for case insensitive file
+ * systems.  Returns either the path or the buf. */
+static const char *
+get_path_key(const char path[], char buf[], size_t buf_len)
+{
+#ifndef _WIN32
+	return path;
+#else
+	copy_str(buf, buf_len, path);
+	strtolower(buf);
+	return buf;
+#endif
 }
 
 void
@@ -151,6 +264,9 @@ clear_register(int key)
 	free_string_array(reg->files, reg->num_files);
 	reg->files = NULL;
 	reg->num_files = 0;
+
+	trie_free(indexes[reg - registers]);
+	indexes[reg - registers] = NULL_TRIE;
 }
 
 void
@@ -166,7 +282,12 @@ pack_register(int key)
 	for(y = 0; y < reg->num_files; y++)
 		if(reg->files[y] != NULL)
 			reg->files[x++] = reg->files[y];
-	reg->num_files = x;
+
+	if(x != reg->num_files)
+	{
+		reg->num_files = x;
+		reindex_register(reg);
+	}
 }
 
 char **
@@ -207,15 +328,15 @@ rename_in_registers(const char old[], const char new[])
 	int x;
 	for(x = 0; x < NUM_REGISTERS; x++)
 	{
-		int y, n;
-		n = registers[x].num_files;
-		for(y = 0; y < n; y++)
-		{
-			if(stroscmp(registers[x].files[y], old) != 0)
-				continue;
+		registers_t *const reg = &registers[x];
+		const int y = find_in_register(reg, old);
+		if(y < 0)
+			continue;
 
-			(void)replace_string(&registers[x].files[y], new);
-			break; /* registers don't contain duplicates */
+		if(replace_string(&reg->files[y], new) == 0)
+		{
+			unindex_file(reg, old);
+			index_file(reg, y);
 		}
 	}
 }
@@ -266,6 +387,8 @@ update_unnamed_reg(int key)
 			unnamed->num_files*sizeof(char *));
 	for(i = 0; i < unnamed->num_files; i++)
 		unnamed->files[i] = strdup(reg->files[i]);
+
+	reindex_register(unnamed);
 }
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
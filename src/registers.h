@@ -38,7 +38,12 @@ void init_registers(void);
  * Returns non-zero if it exists, otherwise zero is returned. */
 int register_exists(int key);
 registers_t * find_register(int key);
+/* Appends the file to the register if the file exists and isn't already in
+ * the register. */
 void append_to_register(int reg, const char file[]);
+/* Same as append_to_register(), but skips checking for file existence, which is
+ * useful when file is known to exist (e.g. it's just been listed). */
+void append_existing_to_register(int reg, const char file[]);
 /* Clears all registers. */
 void clear_registers(void);
 void clear_register(int reg);
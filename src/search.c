@@ -109,6 +109,9 @@ find_pattern(FileView *view, const char pattern[], int backward, int move,
 	regex_t re;
 	int err;
 
+	/* Search is performed on the whole list of files. */
+	finish_dir_list_loading(view);
+
 	if(move && cfg.hl_search)
 	{
 		clean_selected_files(view);
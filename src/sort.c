@@ -21,8 +21,10 @@
 
 #include <assert.h> /* assert() */
 #include <ctype.h>
-#include <stdlib.h> /* abs() qsort() */
-#include <string.h> /* strrchr() */
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+#include <stdlib.h> /* abs() free() malloc() */
+#include <string.h> /* memcpy() strcmp() strdup() strrchr() */
 
 #include "cfg/config.h"
 #include "utils/fs_limits.h"
@@ -36,267 +38,486 @@
 #include "types.h"
 #include "ui.h"
 
-static FileView* view;
-static int sort_descending;
-static int sort_type;
+/* Number of items below which merge sort switches to insertion sort. */
+#define INSERTION_SORT_THRESHOLD 16
 
-static void sort_by_key(char key);
-static int sort_dir_list(const void *one, const void *two);
+/* Sorting keys of a view in order of their priority along with description of
+ * values that need to be computed for entries to compare them. */
+typedef struct
+{
+	char keys[SK_COUNT + 1]; /* Sorting keys, possibly with implicit type key. */
+	int count;               /* Number of keys. */
+	int (*name_cmp)(const char s[], const char t[]); /* Compares file names. */
+	int fold_names;          /* Whether lowercased names are needed. */
+	int need_ext;            /* Whether extensions are needed. */
+	int need_size;           /* Whether sizes (of directories too) are needed. */
+#ifndef _WIN32
+	int need_perms;          /* Whether permission strings are needed. */
+#endif
+}
+sort_spec_t;
+
+/* Entry being sorted along with precomputed values of its sorting keys. */
+typedef struct
+{
+	dir_entry_t *entry; /* Entry itself. */
+	const char *name;   /* Name of the entry. */
+	int index;          /* Position of the entry before sorting. */
+	int is_parent;      /* Whether entry is the ".." directory. */
+	int is_dir;         /* Whether entry is a directory or a link to one. */
+	char *folded_name;  /* Lowercased name or NULL if not needed. */
+	const char *ext;    /* Extension (without the dot) or NULL if there is none. */
+	uint64_t size;      /* Size, for directories it's taken from the cache. */
+#ifndef _WIN32
+	char perms[11];     /* Permissions string. */
+#endif
+}
+sort_item_t;
+
+static void init_spec(sort_spec_t *spec, const FileView *view);
+static int init_item(sort_item_t *item, dir_entry_t *entry, int index,
+		const sort_spec_t *spec);
+static void merge_sort(sort_item_t *items[], sort_item_t *buf[], size_t count,
+		const sort_spec_t *spec);
+static void insertion_sort(sort_item_t *items[], size_t count,
+		const sort_spec_t *spec);
+static void permute_entries(dir_entry_t entries[], int order[], int count);
+static int compare_items(const sort_item_t *first, const sort_item_t *second,
+		const sort_spec_t *spec);
+static int compare_by_key(const sort_item_t *first, const sort_item_t *second,
+		int key, const sort_spec_t *spec);
 TSTATIC int strnumcmp(const char s[], const char t[]);
 #if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
 static int vercmp(const char s[], const char t[]);
 #else
 static char * skip_leading_zeros(const char str[]);
 #endif
-static int compare_file_names(const char s[], const char t[],
-		int ignore_case);
 
 void
 sort_view(FileView *v)
 {
+	sort_entries(v, v->dir_entry, v->list_rows);
+}
+
+void
+sort_entries(FileView *v, dir_entry_t entries[], int count)
+{
+	sort_spec_t spec;
+	sort_item_t *items;
+	sort_item_t **ptrs;
+	int *order;
 	int i;
 
-	view = v;
-	i = SK_COUNT;
-	while(--i >= 0)
+	if(count < 2)
 	{
-		const char sorting_key = view->sort[i];
+		return;
+	}
 
-		if(abs(sorting_key) > SK_LAST)
-		{
-			continue;
-		}
+	init_spec(&spec, v);
 
-		sort_by_key(sorting_key);
+	items = malloc(sizeof(*items)*count);
+	ptrs = malloc(sizeof(*ptrs)*count*2);
+	order = malloc(sizeof(*order)*count);
+	if(items == NULL || ptrs == NULL || order == NULL)
+	{
+		free(items);
+		free(ptrs);
+		free(order);
+		return;
 	}
 
-	if(!ui_view_sort_list_contains(v->sort, SK_BY_TYPE))
+	for(i = 0; i < count; ++i)
 	{
-		sort_by_key(SK_BY_TYPE);
+		(void)init_item(&items[i], &entries[i], i, &spec);
+		ptrs[i] = &items[i];
 	}
+
+	merge_sort(ptrs, ptrs + count, count, &spec);
+
+	for(i = 0; i < count; ++i)
+	{
+		order[i] = ptrs[i]->index;
+		free(items[i].folded_name);
+	}
+	permute_entries(entries, order, count);
+
+	free(order);
+	free(ptrs);
+	free(items);
+}
+
+int
+sort_compare_entries(FileView *v, dir_entry_t *first, dir_entry_t *second)
+{
+	sort_spec_t spec;
+	sort_item_t first_item, second_item;
+	int result;
+
+	init_spec(&spec, v);
+	(void)init_item(&first_item, first, 0, &spec);
+	(void)init_item(&second_item, second, 1, &spec);
+
+	result = compare_items(&first_item, &second_item, &spec);
+
+	free(first_item.folded_name);
+	free(second_item.folded_name);
+	return result;
 }
 
-/* Sorts view by the key in a stable way. */
+/* Collects sorting keys of the view and determines what needs to be computed
+ * to compare entries by them. */
 static void
-sort_by_key(char key)
+init_spec(sort_spec_t *spec, const FileView *view)
 {
-	int j;
+	int i;
 
-	sort_descending = (key < 0);
-	sort_type = abs(key);
+	spec->count = 0;
+	spec->fold_names = 0;
+	spec->need_ext = 0;
+	spec->need_size = 0;
+#ifndef _WIN32
+	spec->need_perms = 0;
+#endif
+	spec->name_cmp = cfg.sort_numbers ? &strnumcmp : &strcmp;
 
-	for(j = 0; j < view->list_rows; j++)
+	/* Type is the most significant key unless it's specified explicitly. */
+	if(!ui_view_sort_list_contains(view->sort, SK_BY_TYPE))
 	{
-		view->dir_entry[j].list_num = j;
+		spec->keys[spec->count++] = SK_BY_TYPE;
 	}
 
-	qsort(view->dir_entry, view->list_rows, sizeof(dir_entry_t), sort_dir_list);
-}
+	for(i = 0; i < SK_COUNT; ++i)
+	{
+		const char sorting_key = view->sort[i];
 
-/* Compares file names containing numbers correctly. */
-TSTATIC int
-strnumcmp(const char s[], const char t[])
-{
-#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
-	return vercmp(s, t);
-#else
-	const char *new_s = skip_leading_zeros(s);
-	const char *new_t = skip_leading_zeros(t);
-	return strverscmp(new_s, new_t);
+		if(abs(sorting_key) > SK_LAST)
+		{
+			continue;
+		}
+
+		spec->keys[spec->count++] = sorting_key;
+		switch(abs(sorting_key))
+		{
+			case SK_BY_INAME:
+				spec->fold_names = 1;
+				break;
+			case SK_BY_EXTENSION:
+				spec->need_ext = 1;
+				break;
+			case SK_BY_SIZE:
+				spec->need_size = 1;
+				break;
+#ifndef _WIN32
+			case SK_BY_PERMISSIONS:
+				spec->need_perms = 1;
+				break;
 #endif
+		}
+	}
 }
 
-#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
+/* Computes values of sorting keys of the entry once so that comparisons don't
+ * need to.  Returns non-zero on memory allocation error, in which case
+ * case-insensitive comparison falls back to using original name. */
 static int
-vercmp(const char s[], const char t[])
+init_item(sort_item_t *item, dir_entry_t *entry, int index,
+		const sort_spec_t *spec)
 {
-	while(*s != '\0' && *t != '\0')
+	item->entry = entry;
+	item->name = entry->name;
+	item->index = index;
+	item->is_parent = is_parent_dir(entry->name);
+	item->is_dir = is_directory_entry(entry);
+	item->folded_name = NULL;
+	item->ext = NULL;
+	item->size = entry->size;
+
+	if(spec->need_ext)
 	{
-		if(isdigit(*s) && isdigit(*t))
-		{
-			int num_a, num_b;
-			const char *os = s, *ot = t;
-			char *p;
+		const char *const dot = strrchr(entry->name, '.');
+		item->ext = (dot == NULL) ? NULL : (dot + 1);
+	}
 
-			num_a = strtol(s, &p, 10);
-			s = p;
+	if(spec->need_size && item->is_dir)
+	{
+		tree_get_data(curr_stats.dirsize_cache, entry->name, &entry->size);
+		item->size = entry->size;
+	}
 
-			num_b = strtol(t, &p, 10);
-			t = p;
+#ifndef _WIN32
+	if(spec->need_perms)
+	{
+		get_perm_string(item->perms, sizeof(item->perms), entry->mode);
+	}
+#endif
 
-			if(num_a != num_b)
-				return num_a - num_b;
-			else if(*os != *ot)
-				return *os - *ot;
+	if(spec->fold_names)
+	{
+		item->folded_name = strdup(entry->name);
+		if(item->folded_name == NULL)
+		{
+			return 1;
 		}
-		else if(*s == *t)
+		strtolower(item->folded_name);
+	}
+
+	return 0;
+}
+
+/* Sorts array of items in a stable way using buf of the same size as temporary
+ * storage. */
+static void
+merge_sort(sort_item_t *items[], sort_item_t *buf[], size_t count,
+		const sort_spec_t *spec)
+{
+	const size_t half = count/2;
+	size_t l, r, out;
+
+	if(count <= INSERTION_SORT_THRESHOLD)
+	{
+		insertion_sort(items, count, spec);
+		return;
+	}
+
+	merge_sort(items, buf, half, spec);
+	merge_sort(items + half, buf, count - half, spec);
+
+	/* Halves might be in order already. */
+	if(compare_items(items[half - 1], items[half], spec) <= 0)
+	{
+		return;
+	}
+
+	memcpy(buf, items, sizeof(*items)*half);
+
+	l = 0;
+	r = half;
+	out = 0;
+	while(l < half && r < count)
+	{
+		if(compare_items(items[r], buf[l], spec) < 0)
 		{
-			s++;
-			t++;
+			items[out++] = items[r++];
 		}
 		else
-			break;
+		{
+			items[out++] = buf[l++];
+		}
+	}
+	while(l < half)
+	{
+		items[out++] = buf[l++];
 	}
+}
 
-	return *s - *t;
+/* Sorts small array of items in a stable way. */
+static void
+insertion_sort(sort_item_t *items[], size_t count, const sort_spec_t *spec)
+{
+	size_t i;
+	for(i = 1; i < count; ++i)
+	{
+		sort_item_t *const item = items[i];
+		size_t j = i;
+		while(j > 0 && compare_items(item, items[j - 1], spec) < 0)
+		{
+			items[j] = items[j - 1];
+			--j;
+		}
+		items[j] = item;
+	}
 }
-#else
-/* Skips all zeros in front of numbers (correctly handles zero).  Returns str, a
- * pointer to '0' or a pointer to non-zero digit. */
-static char *
-skip_leading_zeros(const char str[])
+
+/* Reorders entries in place so that i-th entry becomes the one that was at
+ * order[i] position.  Destroys contents of the order array. */
+static void
+permute_entries(dir_entry_t entries[], int order[], int count)
 {
-	while(str[0] == '0' && isdigit(str[1]))
+	int i;
+	for(i = 0; i < count; ++i)
 	{
-		str++;
+		dir_entry_t tmp;
+		int j;
+
+		if(order[i] == i)
+		{
+			continue;
+		}
+
+		/* Follow the cycle that starts at i moving entries along it. */
+		tmp = entries[i];
+		j = i;
+		while(order[j] != i)
+		{
+			const int next = order[j];
+			entries[j] = entries[next];
+			order[j] = j;
+			j = next;
+		}
+		entries[j] = tmp;
+		order[j] = j;
 	}
-	return (char *)str;
 }
-#endif
 
+/* Compares two items by all sorting keys.  Returns positive value if first
+ * should go after second, zero if order doesn't matter, otherwise negative
+ * value is returned. */
 static int
-sort_dir_list(const void *one, const void *two)
+compare_items(const sort_item_t *first, const sort_item_t *second,
+		const sort_spec_t *spec)
 {
-	int retval;
-	char *pfirst, *psecond;
-	dir_entry_t *const first = (dir_entry_t *)one;
-	dir_entry_t *const second = (dir_entry_t *)two;
-	int first_is_dir;
-	int second_is_dir;
-
-	if(is_parent_dir(first->name))
+	int i;
+
+	if(first->is_parent)
 	{
 		return -1;
 	}
-	else if(is_parent_dir(second->name))
+	else if(second->is_parent)
 	{
 		return 1;
 	}
 
-	first_is_dir = is_directory_entry(first);
-	second_is_dir = is_directory_entry(second);
+	for(i = 0; i < spec->count; ++i)
+	{
+		const int key = spec->keys[i];
+		const int retval = compare_by_key(first, second, abs(key), spec);
+		if(retval != 0)
+		{
+			return (key < 0) ? -retval : retval;
+		}
+	}
+
+	return 0;
+}
+
+/* Compares two items by a single sorting key in ascending order.  Returns
+ * positive value if first is greater than second, zero if they are equal,
+ * otherwise negative value is returned. */
+static int
+compare_by_key(const sort_item_t *first, const sort_item_t *second, int key,
+		const sort_spec_t *spec)
+{
+	const dir_entry_t *const a = first->entry;
+	const dir_entry_t *const b = second->entry;
 
-	retval = 0;
-	switch(sort_type)
+	switch(key)
 	{
 		case SK_BY_NAME:
 		case SK_BY_INAME:
 			if(first->name[0] == '.' && second->name[0] != '.')
-				retval = -1;
+				return -1;
 			else if(first->name[0] != '.' && second->name[0] == '.')
-				retval = 1;
+				return 1;
+			else if(key == SK_BY_INAME && first->folded_name != NULL &&
+					second->folded_name != NULL)
+				return spec->name_cmp(first->folded_name, second->folded_name);
 			else
-				retval = compare_file_names(first->name, second->name,
-						sort_type == SK_BY_INAME);
-			break;
+				return spec->name_cmp(first->name, second->name);
 
 		case SK_BY_TYPE:
-			if(first_is_dir != second_is_dir)
-			{
-				retval = first_is_dir ? -1 : 1;
-			}
-			break;
+			return (first->is_dir == second->is_dir) ? 0 : (first->is_dir ? -1 : 1);
 
 		case SK_BY_EXTENSION:
-			pfirst  = strrchr(first->name,  '.');
-			psecond = strrchr(second->name, '.');
-
-			if(pfirst && psecond)
-				retval = compare_file_names(++pfirst, ++psecond, 0);
-			else if(pfirst || psecond)
-				retval = pfirst ? -1 : 1;
+			if(first->ext != NULL && second->ext != NULL)
+				return spec->name_cmp(first->ext, second->ext);
+			else if(first->ext != NULL || second->ext != NULL)
+				return (first->ext != NULL) ? -1 : 1;
 			else
-				retval = compare_file_names(first->name, second->name, 0);
-			break;
+				return spec->name_cmp(first->name, second->name);
 
 		case SK_BY_SIZE:
-			{
-				if(first_is_dir)
-					tree_get_data(curr_stats.dirsize_cache, first->name, &first->size);
-
-				if(second_is_dir)
-					tree_get_data(curr_stats.dirsize_cache, second->name, &second->size);
-
-				retval = (first->size < second->size) ?
-						-1 : (first->size > second->size);
-			}
-			break;
+			return (first->size > second->size) - (first->size < second->size);
 
 		case SK_BY_TIME_MODIFIED:
-			retval = first->mtime - second->mtime;
-			break;
+			return (a->mtime > b->mtime) - (a->mtime < b->mtime);
 
 		case SK_BY_TIME_ACCESSED:
-			retval = first->atime - second->atime;
-			break;
+			return (a->atime > b->atime) - (a->atime < b->atime);
 
 		case SK_BY_TIME_CHANGED:
-			retval = first->ctime - second->ctime;
-			break;
+			return (a->ctime > b->ctime) - (a->ctime < b->ctime);
 #ifndef _WIN32
 		case SK_BY_MODE:
-			retval = first->mode - second->mode;
-			break;
+			return (a->mode > b->mode) - (a->mode < b->mode);
 
 		case SK_BY_OWNER_NAME: /* FIXME */
 		case SK_BY_OWNER_ID:
-			retval = first->uid - second->uid;
-			break;
+			return (a->uid > b->uid) - (a->uid < b->uid);
 
 		case SK_BY_GROUP_NAME: /* FIXME */
 		case SK_BY_GROUP_ID:
-			retval = first->gid - second->gid;
-			break;
+			return (a->gid > b->gid) - (a->gid < b->gid);
 
 		case SK_BY_PERMISSIONS:
-			{
-				char first_perm[11], second_perm[11];
-				get_perm_string(first_perm, sizeof(first_perm), first->mode);
-				get_perm_string(second_perm, sizeof(second_perm), second->mode);
-				retval = strcmp(first_perm, second_perm);
-			}
-			break;
+			return strcmp(first->perms, second->perms);
 #endif
 
 		default:
 			assert(0 && "All possible sort options should be handled");
-			break;
-	}
-
-	if(retval == 0)
-	{
-		retval = first->list_num - second->list_num;
-	}
-	else if(sort_descending)
-	{
-		retval = -retval;
+			return 0;
 	}
+}
 
-	return retval;
+/* Compares file names containing numbers correctly. */
+TSTATIC int
+strnumcmp(const char s[], const char t[])
+{
+#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
+	return vercmp(s, t);
+#else
+	const char *new_s = skip_leading_zeros(s);
+	const char *new_t = skip_leading_zeros(t);
+	return strverscmp(new_s, new_t);
+#endif
 }
 
-/* Compares two filenames.  Returns positive value if s greater than t, zero if
- * they are equal, otherwise negative value is returned. */
+#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
 static int
-compare_file_names(const char s[], const char t[], int ignore_case)
+vercmp(const char s[], const char t[])
 {
-	char s_buf[NAME_MAX];
-	char t_buf[NAME_MAX];
-
-	if(ignore_case)
+	while(*s != '\0' && *t != '\0')
 	{
-		copy_str(s_buf, sizeof(s_buf), s);
-		s = s_buf;
+		if(isdigit(*s) && isdigit(*t))
+		{
+			int num_a, num_b;
+			const char *os = s, *ot = t;
+			char *p;
+
+			num_a = strtol(s, &p, 10);
+			s = p;
 
-		copy_str(t_buf, sizeof(t_buf), t);
-		t = t_buf;
+			num_b = strtol(t, &p, 10);
+			t = p;
 
-		strtolower(s_buf);
-		strtolower(t_buf);
+			if(num_a != num_b)
+				return num_a - num_b;
+			else if(*os != *ot)
+				return *os - *ot;
+		}
+		else if(*s == *t)
+		{
+			s++;
+			t++;
+		}
+		else
+			break;
 	}
 
-	return cfg.sort_numbers ? strnumcmp(s, t) : strcmp(s, t);
+	return *s - *t;
 }
+#else
+/* Skips all zeros in front of numbers (correctly handles zero).  Returns str, a
+ * pointer to '0' or a pointer to non-zero digit. */
+static char *
+skip_leading_zeros(const char str[])
+{
+	while(str[0] == '0' && isdigit(str[1]))
+	{
+		str++;
+	}
+	return (char *)str;
+}
+#endif
 
 int
 get_secondary_key(int primary_key)
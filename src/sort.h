@@ -24,6 +24,14 @@
 #include "ui.h"
 
 void sort_view(FileView *view);
+/* Sorts count entries located at the entries array according to sorting keys
+ * of the view. */
+void sort_entries(FileView *view, dir_entry_t entries[], int count);
+/* Compares two entries according to all sorting keys of the view.  Returns
+ * positive value if first should go after second, zero if order of entries
+ * doesn't matter, otherwise negative value is returned. */
+int sort_compare_entries(FileView *view, dir_entry_t *first,
+		dir_entry_t *second);
 /* Maps primary sort key to second column type. */
 int get_secondary_key(int primary_key);
 
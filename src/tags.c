@@ -32,6 +32,7 @@ const char *tags[] = {
 	"vifm-'confirm'",
 	"vifm-'cpo'",
 	"vifm-'cpoptions'",
+	"vifm-'dirsizecache'",
 	"vifm-'dotdirs'",
 	"vifm-'fastrun'",
 	"vifm-'fcs'",
@@ -79,6 +80,7 @@ const char *tags[] = {
 	"vifm-'sortnumbers'",
 	"vifm-'sortorder'",
 	"vifm-'statusline'",
+	"vifm-'statworkers'",
 	"vifm-'stl'",
 	"vifm-'syscalls'",
 	"vifm-'tabstop'",
@@ -88,6 +90,7 @@ const char *tags[] = {
 	"vifm-'to'",
 	"vifm-'trash'",
 	"vifm-'trashdir'",
+	"vifm-'trashrate'",
 	"vifm-'ts'",
 	"vifm-'tuioptions'",
 	"vifm-'ul'",
@@ -19,13 +19,15 @@
 #include "trash.h"
 
 #include <sys/stat.h> /* stat */
+#include <sys/time.h> /* timeval gettimeofday() */
 #include <unistd.h> /* lstat */
 
 #include <assert.h> /* assert() */
 #include <errno.h> /* errno */
 #include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uintptr_t */
 #include <stdio.h> /* snprintf() */
-#include <stdlib.h> /* free() */
+#include <stdlib.h> /* free() realloc() strtol() */
 #include <string.h> /* strchr() strcmp() strdup() strlen() strspn() */
 
 #include "cfg/config.h"
@@ -37,6 +39,7 @@
 #include "utils/path.h"
 #include "utils/str.h"
 #include "utils/string_array.h"
+#include "utils/trie.h"
 #include "utils/utils.h"
 #include "background.h"
 #include "ops.h"
@@ -61,6 +64,15 @@ TrashResidentType;
 typedef int (*traverser)(const char base_dir[], const char trash_dir[],
 		void *arg);
 
+/* State of emptying single trash directory in background. */
+typedef struct
+{
+	job_t *job;            /* Job to report progress to or NULL. */
+	int removed;           /* Number of files removed in current period. */
+	uint64_t period_start; /* Start of current rate limiting period (in ms). */
+}
+empty_state_t;
+
 /* List of trash directories. */
 typedef struct
 {
@@ -82,7 +94,20 @@ static int create_trash_dir(const char trash_dir[]);
 static void empty_trash_dirs(void);
 static void empty_trash_dir(const char trash_dir[]);
 static void empty_trash_in_bg(void *arg);
+static void make_empty_step(const char path[], void *arg);
+static void limit_rate(empty_state_t *state);
+static uint64_t get_time_ms(void);
 static void empty_trash_list(void);
+static int find_in_trash(const char trash_name[]);
+static void index_entry(int i);
+static void compact_trash_list(int check_files);
+static void note_trash_name(const char trash_name[]);
+static void forget_trash_name(const char trash_name[]);
+static int parse_trash_name(const char trash_name[], char path[],
+		size_t path_len);
+static int get_name_counter(const char path[]);
+static void set_name_counter(const char path[], int counter);
+static const char * get_path_key(const char path[], char buf[], size_t buf_len);
 static trashes_list get_list_of_trashes(void);
 static int get_list_of_trashes_traverser(struct mntent *entry, void *arg);
 static int is_trash_valid(const char trash_dir[]);
@@ -101,6 +126,21 @@ static char * format_root_spec(const char spec[], const char mount_point[]);
 static char **specs;
 static int nspecs;
 
+/* Number of elements trash_list has space for. */
+static int trash_list_size;
+
+/* Number of removed entries of trash_list (with NULL fields) that weren't
+ * compacted yet. */
+static int ntombstones;
+
+/* Maps trash names to indexes of their entries in trash_list plus one (zero
+ * means that there is no such entry). */
+static trie_t trash_index = NULL_TRIE;
+
+/* Maps paths in trash directories without numeric prefix to prefix number
+ * that should be tried first for the next file of the same name. */
+static trie_t name_counters = NULL_TRIE;
+
 int
 set_trash_dir(const char new_specs[])
 {
@@ -249,17 +289,76 @@ empty_trash_dir(const char trash_dir[])
 }
 
 /* Entry point for a background task that removes files in a single trash
- * directory. */
+ * directory.  Files are removed one by one, which allows reporting progress,
+ * limiting rate of removal and pausing the job. */
 static void
 empty_trash_in_bg(void *arg)
 {
 	char *const trash_dir = arg;
+	empty_state_t state = {
+		.job = bg_get_current_job(),
+		.removed = 0,
+		.period_start = get_time_ms(),
+	};
 
-	remove_dir_content(trash_dir);
+	bg_enable_pausing();
+
+	if(state.job != NULL)
+	{
+		state.job->total = count_dir_items(trash_dir);
+	}
+
+	remove_dir_content(trash_dir, &make_empty_step, &state);
 
 	free(trash_dir);
 }
 
+/* Accounts for removal of a single file.  arg is pointer to empty_state_t. */
+static void
+make_empty_step(const char path[], void *arg)
+{
+	empty_state_t *const state = arg;
+
+	/* Files might have been added after they were counted. */
+	if(state->job != NULL && state->job->done + 1 < state->job->total)
+	{
+		inner_bg_next();
+	}
+
+	limit_rate(state);
+	bg_wait_while_paused();
+}
+
+/* Sleeps if files are being removed faster than 'trashrate' allows. */
+static void
+limit_rate(empty_state_t *state)
+{
+	uint64_t elapsed;
+
+	if(cfg.trash_rate <= 0 || ++state->removed < cfg.trash_rate)
+	{
+		return;
+	}
+
+	elapsed = get_time_ms() - state->period_start;
+	if(elapsed < 1000U)
+	{
+		sleep_ms(1000 - (int)elapsed);
+	}
+
+	state->removed = 0;
+	state->period_start = get_time_ms();
+}
+
+/* Retrieves current time.  Returns the time in milliseconds. */
+static uint64_t
+get_time_ms(void)
+{
+	struct timeval tv = {0};
+	(void)gettimeofday(&tv, NULL);
+	return tv.tv_sec*1000ULL + tv.tv_usec/1000;
+}
+
 static void
 empty_trash_list(void)
 {
@@ -273,13 +372,18 @@ empty_trash_list(void)
 	free(trash_list);
 	trash_list = NULL;
 	nentries = 0;
+	trash_list_size = 0;
+	ntombstones = 0;
+
+	trie_free(trash_index);
+	trash_index = NULL_TRIE;
+	trie_free(name_counters);
+	name_counters = NULL_TRIE;
 }
 
 int
 add_to_trash(const char path[], const char trash_name[])
 {
-	void *p;
-
 	if(!exists_in_trash(trash_name))
 	{
 		return -1;
@@ -290,11 +394,17 @@ add_to_trash(const char path[], const char trash_name[])
 		return 0;
 	}
 
-	if((p = realloc(trash_list, sizeof(*trash_list)*(nentries + 1))) == NULL)
+	if(nentries == trash_list_size)
 	{
-		return -1;
+		const int new_size = (trash_list_size == 0) ? 16 : trash_list_size*2;
+		void *const p = realloc(trash_list, sizeof(*trash_list)*new_size);
+		if(p == NULL)
+		{
+			return -1;
+		}
+		trash_list = p;
+		trash_list_size = new_size;
 	}
-	trash_list = p;
 
 	trash_list[nentries].path = strdup(path);
 	trash_list[nentries].trash_name = strdup(trash_name);
@@ -306,6 +416,9 @@ add_to_trash(const char path[], const char trash_name[])
 		return -1;
 	}
 
+	index_entry(nentries);
+	note_trash_name(trash_name);
+
 	nentries++;
 	return 0;
 }
@@ -313,13 +426,143 @@ add_to_trash(const char path[], const char trash_name[])
 int
 is_in_trash(const char trash_name[])
 {
-	int i;
-	for(i = 0; i < nentries; i++)
+	return find_in_trash(trash_name) >= 0;
+}
+
+/* Looks up entry of trash_list by its trash name.  Returns index of the entry
+ * or -1 if there is no such entry. */
+static int
+find_in_trash(const char trash_name[])
+{
+	char buf[PATH_MAX];
+	void *data;
+
+	if(trash_index == NULL_TRIE)
 	{
-		if(stroscmp(trash_list[i].trash_name, trash_name) == 0)
-			return 1;
+		return -1;
 	}
-	return 0;
+
+	if(trie_get(trash_index, get_path_key(trash_name, buf, sizeof(buf)),
+				&data) != 0)
+	{
+		return -1;
+	}
+
+	return (int)(uintptr_t)data - 1;
+}
+
+/* Associates trash name of i-th element of trash_list with its index. */
+static void
+index_entry(int i)
+{
+	char buf[PATH_MAX];
+
+	if(trash_index == NULL_TRIE)
+	{
+		trash_index = trie_create();
+	}
+
+	/* Failure to index an entry can't be handled in a meaningful way. */
+	(void)trie_set(trash_index,
+			get_path_key(trash_list[i].trash_name, buf, sizeof(buf)),
+			(void *)(uintptr_t)(i + 1));
+}
+
+/* Updates counter of file name in trash directory so that generated trash
+ * names don't collide with the trash_name. */
+static void
+note_trash_name(const char trash_name[])
+{
+	char path[PATH_MAX];
+	const int counter = parse_trash_name(trash_name, path, sizeof(path)) + 1;
+
+	if(counter > 0 && counter > get_name_counter(path))
+	{
+		set_name_counter(path, counter);
+	}
+}
+
+/* Makes counter of file name in trash directory point at the number of
+ * trash_name if it was the last one generated, so that the number is reused. */
+static void
+forget_trash_name(const char trash_name[])
+{
+	char path[PATH_MAX];
+	const int number = parse_trash_name(trash_name, path, sizeof(path));
+
+	if(number >= 0 && get_name_counter(path) == number + 1)
+	{
+		set_name_counter(path, number);
+	}
+}
+
+/* Splits trash name into numeric prefix and path without the prefix.  Returns
+ * the number or -1 if trash_name has no numeric prefix. */
+static int
+parse_trash_name(const char trash_name[], char path[], size_t path_len)
+{
+	const char *const name = after_last(trash_name, '/');
+	const size_t prefix_len = strspn(name, "0123456789");
+
+	if(prefix_len == 0U || name[prefix_len] != '_')
+	{
+		return -1;
+	}
+
+	snprintf(path, path_len, "%.*s%s", (int)(name - trash_name), trash_name,
+			name + prefix_len + 1);
+	return strtol(name, NULL, 10);
+}
+
+/* Retrieves prefix number to start with for the path in a trash directory.
+ * Returns the number. */
+static int
+get_name_counter(const char path[])
+{
+	char buf[PATH_MAX];
+	void *data;
+
+	if(name_counters == NULL_TRIE)
+	{
+		return 0;
+	}
+
+	if(trie_get(name_counters, get_path_key(path, buf, sizeof(buf)), &data) != 0)
+	{
+		return 0;
+	}
+
+	return (int)(uintptr_t)data;
+}
+
+/* Remembers prefix number to start with for the path in a trash directory. */
+static void
+set_name_counter(const char path[], int counter)
+{
+	char buf[PATH_MAX];
+
+	if(name_counters == NULL_TRIE)
+	{
+		name_counters = trie_create();
+	}
+
+	/* Not remembering the counter just makes next lookup slower. */
+	(void)trie_set(name_counters, get_path_key(path, buf, sizeof(buf)),
+			(void *)(uintptr_t)counter);
+}
+
+/* Makes key for looking up paths, which accounts for case insensitive file
+ * systems.  Returns either the path or the buf. */
+static const char *
+get_path_key(const char path[], char buf[], size_t buf_len)
+{
+#ifndef _WIN32
+	return path;
+#else
+	copy_str(buf, buf_len, path);
+	strtolower(buf);
+	return buf;
+#endif
 }
 
 char **
@@ -401,16 +644,11 @@ exists_in_trash(const char trash_name[])
 int
 restore_from_trash(const char trash_name[])
 {
-	int i;
+	const int i = find_in_trash(trash_name);
 	char full[PATH_MAX];
 	char buf[PATH_MAX];
 
-	for(i = 0; i < nentries; i++)
-	{
-		if(stroscmp(trash_list[i].trash_name, trash_name) == 0)
-			break;
-	}
-	if(i >= nentries)
+	if(i < 0)
 		return -1;
 
 	copy_str(buf, sizeof(buf), trash_list[i].path);
@@ -446,21 +684,28 @@ restore_from_trash(const char trash_name[])
 int
 remove_from_trash(const char trash_name[])
 {
-	int i;
-	for(i = 0; i < nentries; i++)
-	{
-		if(stroscmp(trash_list[i].trash_name, trash_name) == 0)
-			break;
-	}
-	if(i >= nentries)
+	char buf[PATH_MAX];
+	int i = find_in_trash(trash_name);
+	if(i < 0)
 		return -1;
 
+	(void)trie_set(trash_index, get_path_key(trash_name, buf, sizeof(buf)),
+			NULL);
+	forget_trash_name(trash_name);
+
+	/* Leave a tombstone in place of the entry, so that indexes of other entries
+	 * stay valid.  Tombstones are compacted once they make up half of the
+	 * list, which keeps removal amortized constant time. */
 	free(trash_list[i].path);
 	free(trash_list[i].trash_name);
-	memmove(trash_list + i, trash_list + i + 1,
-			sizeof(*trash_list)*((nentries - 1) - i));
+	trash_list[i].path = NULL;
+	trash_list[i].trash_name = NULL;
+
+	if(++ntombstones > nentries/2)
+	{
+		compact_trash_list(0);
+	}
 
-	nentries--;
 	return 0;
 }
 
@@ -469,6 +714,7 @@ gen_trash_name(const char base_dir[], const char name[])
 {
 	struct stat st;
 	char buf[PATH_MAX];
+	char path[PATH_MAX];
 	int i;
 	char *const trash_dir = pick_trash_dir(base_dir);
 
@@ -477,7 +723,12 @@ gen_trash_name(const char base_dir[], const char name[])
 		return NULL;
 	}
 
-	i = 0;
+	snprintf(path, sizeof(path), "%s/%s", trash_dir, name);
+	chosp(path);
+
+	/* Start right after the last used number, so that usually only one check is
+	 * needed. */
+	i = get_name_counter(path);
 	do
 	{
 		snprintf(buf, sizeof(buf), "%s/%03d_%s", trash_dir, i++, name);
@@ -485,6 +736,8 @@ gen_trash_name(const char base_dir[], const char name[])
 	}
 	while(lstat(buf, &st) == 0);
 
+	set_name_counter(path, i);
+
 	free(trash_dir);
 
 	return strdup(buf);
@@ -659,22 +912,40 @@ get_real_name_from_trash_name(const char trash_path[])
 
 void
 trash_prune_dead_entries(void)
+{
+	compact_trash_list(1);
+}
+
+/* Drops tombstones from the trash_list and optionally entries that correspond
+ * to nonexistent files.  Reindexes the list. */
+static void
+compact_trash_list(int check_files)
 {
 	int i, j;
 
+	trie_free(trash_index);
+	trash_index = NULL_TRIE;
+
 	j = 0;
 	for(i = 0; i < nentries; ++i)
 	{
-		if(!path_exists(trash_list[i].trash_name))
+		if(trash_list[i].trash_name == NULL)
+		{
+			continue;
+		}
+
+		if(check_files && !path_exists(trash_list[i].trash_name))
 		{
 			free(trash_list[i].path);
 			free(trash_list[i].trash_name);
 			continue;
 		}
 
-		trash_list[j++] = trash_list[i];
+		trash_list[j] = trash_list[i];
+		index_entry(j++);
 	}
 	nentries = j;
+	ntombstones = 0;
 }
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
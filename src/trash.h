@@ -27,7 +27,8 @@ typedef struct
 }
 trash_entry_t;
 
-/* List of items in trashes. */
+/* List of items in trashes.  Removed items might be left in the list with both
+ * fields set to NULL until trash_prune_dead_entries() is called. */
 trash_entry_t *trash_list;
 
 /* Number of items in the trash_list. */
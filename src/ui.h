@@ -22,6 +22,8 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <dirent.h> /* DIR */
 #endif
 
 #include <curses.h>
@@ -32,6 +34,7 @@
 #include <time.h> /* time_t timespec */
 
 #include "utils/filter.h"
+#include "utils/fs.h"
 #include "utils/fs_limits.h"
 #include "color_scheme.h"
 #include "column_view.h"
@@ -142,12 +145,14 @@ typedef struct
 	char date[16];
 	FileType type;
 
+	/* Information about target of LINK entries, resolved on loading. */
+	SymLinkType link_type; /* Type of the target. */
+	int link_broken;       /* Whether target doesn't exist. */
+
 	int selected;
 	int was_selected; /* Temporary field to store previous selection state. */
 
 	int search_match;
-
-	int list_num; /* Used by sorting comparer to perform stable sort. */
 }
 dir_entry_t;
 
@@ -162,6 +167,18 @@ typedef struct
 #else
 	time_t dir_mtime;
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+	int dir_watcher; /* inotify descriptor, valid if watched_dir isn't empty. */
+	char watched_dir[PATH_MAX]; /* Directory watched via dir_watcher. */
+	/* Changes of watched_dir, which weren't applied to the list yet. */
+	struct
+	{
+		char **names; /* Names of changed files (might repeat). */
+		int count;    /* Number of elements in names. */
+		int reload;   /* Whether list of files needs to be reloaded as a whole. */
+	}
+	dir_changes;
+#endif
 #else
 	FILETIME dir_mtime;
 	HANDLE dir_watcher;
@@ -169,6 +186,18 @@ typedef struct
 #endif
 	char last_dir[PATH_MAX];
 
+#ifndef _WIN32
+	/* State of reading of a large directory, which is continued in portions from
+	 * the main loop after first portion of files is displayed. */
+	struct
+	{
+		DIR *dir;        /* Directory being read or NULL. */
+		size_t capacity; /* Number of entries dir_entry has room for. */
+		int with_parent; /* Whether ".." entry was already read. */
+	}
+	loading;
+#endif
+
 	char regexp[256]; /* regular expression pattern for / and ? searching */
 	int matches;
 
@@ -229,6 +258,16 @@ typedef struct
 		int *poshist;
 		/* Number of elements in the poshist field. */
 		size_t poshist_len;
+
+		/* Sorted positions of entries in the unfiltered array that pass the
+		 * filter. */
+		size_t *matches;
+		/* Number of elements in the matches field. */
+		size_t matches_count;
+		/* Value of the filter that produced matches or NULL. */
+		char *matched;
+		/* Regular expression flags that produced matches. */
+		int matched_cflags;
 	}
 	local_filter;
 
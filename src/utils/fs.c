@@ -47,6 +47,9 @@
 
 static int is_dir_fast(const char path[]);
 static int path_exists_internal(const char *path, const char *filename);
+static void count_dir_item(const char path[], void *arg);
+static void visit_dir_content(const char path[], int remove_items,
+		dir_entry_func cb, void *arg);
 
 #ifndef _WIN32
 static int is_directory(const char path[], int dereference_links);
@@ -500,7 +503,32 @@ rename_file(const char src[], const char dst[])
 }
 
 void
-remove_dir_content(const char path[])
+remove_dir_content(const char path[], dir_entry_func cb, void *arg)
+{
+	visit_dir_content(path, 1, cb, arg);
+}
+
+int
+count_dir_items(const char path[])
+{
+	int count = 0;
+	visit_dir_content(path, 0, &count_dir_item, &count);
+	return count;
+}
+
+/* Implementation of count_dir_items().  Counts an entry. */
+static void
+count_dir_item(const char path[], void *arg)
+{
+	int *const count = arg;
+	++*count;
+}
+
+/* Walks directory tree invoking callback for each entry after its children
+ * were visited.  Optionally removes entries before invoking the callback. */
+static void
+visit_dir_content(const char path[], int remove_items, dir_entry_func cb,
+		void *arg)
 {
 	DIR *dir;
 	struct dirent *d;
@@ -518,9 +546,16 @@ remove_dir_content(const char path[])
 			char *const full_path = format_str("%s/%s", path, d->d_name);
 			if(entry_is_dir(full_path, d))
 			{
-				remove_dir_content(full_path);
+				visit_dir_content(full_path, remove_items, cb, arg);
+			}
+			if(remove_items)
+			{
+				(void)remove(full_path);
+			}
+			if(cb != NULL)
+			{
+				cb(full_path, arg);
 			}
-			(void)remove(full_path);
 			free(full_path);
 		}
 	}
@@ -101,8 +101,16 @@ int is_regular_file(const char path[]);
  * error, otherwise zero is returned. */
 int rename_file(const char src[], const char dst[]);
 
-/* Removes directory content. */
-void remove_dir_content(const char path[]);
+/* Callback invoked for each entry of a directory tree.  path is full path to
+ * the entry. */
+typedef void (*dir_entry_func)(const char path[], void *arg);
+
+/* Removes directory content.  Invokes callback (if it's not NULL) after each
+ * removal. */
+void remove_dir_content(const char path[], dir_entry_func cb, void *arg);
+
+/* Counts files in the directory recursively.  Returns the number. */
+int count_dir_items(const char path[]);
 
 struct dirent;
 
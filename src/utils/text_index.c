@@ -0,0 +1,746 @@
+/* vifm
+ * Copyright (C) 2014 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "text_index.h"
+
+#ifndef _WIN32
+#include <sys/mman.h> /* MAP_* PROT_READ mmap() munmap() */
+#include <unistd.h> /* _SC_PAGESIZE sysconf() */
+#endif
+#include <sys/stat.h> /* fstat() stat */
+#include <pthread.h>
+
+#include <signal.h> /* SIGBUS sigaction siginfo_t sigaction() */
+#include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uintptr_t */
+#include <stdio.h> /* FILE fclose() fileno() fopen() fread() */
+#include <stdlib.h> /* calloc() free() malloc() realloc() */
+#include <string.h> /* memcpy() */
+
+/* Number of lines to index at once, which limits how often indexing thread
+ * needs to lock the index. */
+#define INDEX_CHUNK 65536
+
+/* Average length of a line assumed when there is nothing to compute it from. */
+#define DEFAULT_LINE_LEN 64
+
+/* Maximum number of files mapped at the same time, the rest is read into
+ * memory. */
+#define MAX_MAPPINGS 16
+
+#if !defined(_WIN32) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+struct text_index_t
+{
+	const char *data; /* Text itself. */
+	size_t size;      /* Size of the text. */
+	int mapped;       /* Whether data is mapped file rather than allocated. */
+
+	pthread_mutex_t mutex; /* Protects all fields below. */
+	pthread_cond_t cond;   /* Signaled when indexing of a chunk is done. */
+	size_t *lines;         /* Beginnings of indexed lines (elements past nlines
+	                          are filled by indexing thread without locking). */
+	int nlines;            /* Number of elements in lines. */
+	int capacity;          /* Number of allocated elements of lines. */
+	int indexing;          /* Whether some thread is indexing a chunk. */
+	int complete;          /* Whether all lines were indexed. */
+	int failed;            /* Whether indexing was stopped by an error. */
+	int stop;              /* Whether background thread should quit. */
+
+	pthread_t thread; /* Thread that builds index in background. */
+	int in_bg;        /* Whether thread was started. */
+};
+
+static text_index_t * read_text(FILE *fp, size_t size_hint);
+static const char * map_text(int fd, size_t size);
+static void unmap_text(const char data[], size_t size);
+#ifndef _WIN32
+static void install_sigbus_guard(void);
+static void handle_sigbus(int sig, siginfo_t *info, void *context);
+#endif
+static text_index_t * alloc_text_index(void);
+static int is_eol(char c);
+static size_t line_end(const text_index_t *ti, size_t line);
+static size_t find_line_start(const text_index_t *ti, size_t end);
+static void * index_in_bg(void *arg);
+static int index_chunk(text_index_t *ti);
+static int find_indexed(const text_index_t *ti, size_t line);
+static int estimate_number(const text_index_t *ti, size_t pos);
+
+#ifndef _WIN32
+
+/* Registered region of a mapped file. */
+typedef struct
+{
+	const char *volatile start; /* Beginning of the region or NULL if unused. */
+	volatile size_t size;       /* Size of the region. */
+}
+mapping_t;
+
+/* Mapped files, which are looked up by SIGBUS handler. */
+static mapping_t mappings[MAX_MAPPINGS];
+/* Serializes registration of mappings. */
+static pthread_mutex_t mappings_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Makes sure that SIGBUS handler is installed only once. */
+static pthread_once_t sigbus_once = PTHREAD_ONCE_INIT;
+/* Whether SIGBUS handler is installed, files aren't mapped otherwise. */
+static volatile sig_atomic_t sigbus_guarded;
+/* Handler of SIGBUS that was replaced, it's restored on foreign signals. */
+static struct sigaction prev_sigbus;
+/* Size of memory page. */
+static uintptr_t page_size;
+
+#endif
+
+text_index_t *
+text_index_open(const char path[])
+{
+	text_index_t *ti;
+	struct stat st;
+	const char *data;
+	FILE *const fp = fopen(path, "rb");
+	if(fp == NULL)
+	{
+		return NULL;
+	}
+
+	if(fstat(fileno(fp), &st) != 0)
+	{
+		st.st_size = 0;
+	}
+
+	data = map_text(fileno(fp), st.st_size);
+	if(data == NULL)
+	{
+		ti = read_text(fp, st.st_size);
+		fclose(fp);
+		return ti;
+	}
+	fclose(fp);
+
+	ti = alloc_text_index();
+	if(ti == NULL)
+	{
+		unmap_text(data, st.st_size);
+		return NULL;
+	}
+
+	ti->data = data;
+	ti->size = st.st_size;
+	ti->mapped = 1;
+	return ti;
+}
+
+text_index_t *
+text_index_read(FILE *fp)
+{
+	return read_text(fp, 0U);
+}
+
+/* Reads stream until its end.  size_hint is expected size of the stream, which
+ * is used to avoid reallocations.  Returns NULL on error. */
+static text_index_t *
+read_text(FILE *fp, size_t size_hint)
+{
+	enum { PIECE_LEN = 4096 };
+
+	text_index_t *ti;
+	size_t len = 0U, piece_len;
+	/* One extra byte lets detect end of the stream without reallocation. */
+	size_t capacity = (size_hint < PIECE_LEN) ? PIECE_LEN : size_hint + 1U;
+	char *text = malloc(capacity);
+	if(text == NULL)
+	{
+		return NULL;
+	}
+
+	while((piece_len = fread(text + len, 1, capacity - len, fp)) != 0U)
+	{
+		len += piece_len;
+		if(len == capacity)
+		{
+			char *const new_text = realloc(text, capacity*2U);
+			if(new_text == NULL)
+			{
+				free(text);
+				return NULL;
+			}
+			text = new_text;
+			capacity *= 2U;
+		}
+	}
+
+	ti = alloc_text_index();
+	if(ti == NULL)
+	{
+		free(text);
+		return NULL;
+	}
+
+	ti->data = text;
+	ti->size = len;
+	ti->complete = (ti->size == 0U);
+	return ti;
+}
+
+/* Maps file of the specified size into memory.  Truncation of the file while it
+ * stays mapped makes its removed part read as null characters instead of
+ * raising SIGBUS.  Returns the mapping or NULL if the file can't be mapped. */
+static const char *
+map_text(int fd, size_t size)
+{
+#ifndef _WIN32
+	void *data;
+	int i;
+
+	/* Empty files can't be mapped. */
+	if(size == 0U || pthread_once(&sigbus_once, &install_sigbus_guard) != 0 ||
+			!sigbus_guarded)
+	{
+		return NULL;
+	}
+
+	pthread_mutex_lock(&mappings_lock);
+	for(i = 0; i < MAX_MAPPINGS && mappings[i].start != NULL; ++i)
+	{
+		/* Look for a free slot. */
+	}
+	data = MAP_FAILED;
+	if(i < MAX_MAPPINGS)
+	{
+		data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data != MAP_FAILED)
+		{
+			/* Size goes first, so that SIGBUS handler never sees stale one. */
+			mappings[i].size = size;
+			mappings[i].start = data;
+		}
+	}
+	pthread_mutex_unlock(&mappings_lock);
+
+	return (data == MAP_FAILED) ? NULL : data;
+#else
+	return NULL;
+#endif
+}
+
+/* Unmaps file mapped by map_text(). */
+static void
+unmap_text(const char data[], size_t size)
+{
+#ifndef _WIN32
+	int i;
+
+	pthread_mutex_lock(&mappings_lock);
+	for(i = 0; i < MAX_MAPPINGS; ++i)
+	{
+		if(mappings[i].start == data)
+		{
+			mappings[i].start = NULL;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mappings_lock);
+
+	(void)munmap((void *)data, size);
+#endif
+}
+
+#ifndef _WIN32
+
+/* Installs handler of SIGBUS, which is raised on accessing part of a mapping
+ * past the end of truncated file. */
+static void
+install_sigbus_guard(void)
+{
+	struct sigaction sa;
+	const long size = sysconf(_SC_PAGESIZE);
+	if(size <= 0)
+	{
+		return;
+	}
+	page_size = size;
+
+	sa.sa_sigaction = &handle_sigbus;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_SIGINFO;
+	sigbus_guarded = (sigaction(SIGBUS, &sa, &prev_sigbus) == 0);
+}
+
+/* Replaces page of a mapping, which is no longer backed by the file, with a
+ * page of zeroes, so that reading it can be retried. */
+static void
+handle_sigbus(int sig, siginfo_t *info, void *context)
+{
+	const char *const addr = info->si_addr;
+	int i;
+
+	for(i = 0; i < MAX_MAPPINGS; ++i)
+	{
+		const char *const start = mappings[i].start;
+		if(start != NULL && addr >= start && addr < start + mappings[i].size)
+		{
+			void *const page = (void *)((uintptr_t)addr & ~(page_size - 1U));
+			if(mmap(page, page_size, PROT_READ,
+						MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED)
+			{
+				return;
+			}
+			break;
+		}
+	}
+
+	/* The signal isn't caused by a truncated file or it can't be handled, let
+	 * the access fail again with the previous handler in place. */
+	sigbus_guarded = 0;
+	(void)sigaction(SIGBUS, &prev_sigbus, NULL);
+}
+
+#endif
+
+/* Allocates text index structure with empty text.  Returns the structure or
+ * NULL on error. */
+static text_index_t *
+alloc_text_index(void)
+{
+	text_index_t *const ti = calloc(1, sizeof(*ti));
+	if(ti == NULL)
+	{
+		return NULL;
+	}
+
+	if(pthread_mutex_init(&ti->mutex, NULL) != 0)
+	{
+		free(ti);
+		return NULL;
+	}
+
+	if(pthread_cond_init(&ti->cond, NULL) != 0)
+	{
+		pthread_mutex_destroy(&ti->mutex);
+		free(ti);
+		return NULL;
+	}
+
+	return ti;
+}
+
+void
+text_index_free(text_index_t *ti)
+{
+	if(ti == NULL)
+	{
+		return;
+	}
+
+	if(ti->in_bg)
+	{
+		pthread_mutex_lock(&ti->mutex);
+		ti->stop = 1;
+		pthread_mutex_unlock(&ti->mutex);
+		(void)pthread_join(ti->thread, NULL);
+	}
+
+	if(ti->mapped)
+	{
+		unmap_text(ti->data, ti->size);
+	}
+	else
+	{
+		free((void *)ti->data);
+	}
+	free(ti->lines);
+	pthread_cond_destroy(&ti->cond);
+	pthread_mutex_destroy(&ti->mutex);
+	free(ti);
+}
+
+int
+text_index_start_bg(text_index_t *ti)
+{
+	if(ti->in_bg)
+	{
+		return 0;
+	}
+
+	ti->in_bg = (pthread_create(&ti->thread, NULL, &index_in_bg, ti) == 0);
+	return !ti->in_bg;
+}
+
+int
+text_index_is_empty(const text_index_t *ti)
+{
+	return ti->size == 0U;
+}
+
+char *
+text_index_get_line(const text_index_t *ti, size_t line)
+{
+	const size_t len = line_end(ti, line) - line;
+	char *const copy = malloc(len + 1U);
+	if(copy != NULL)
+	{
+		memcpy(copy, ti->data + line, len);
+		copy[len] = '\0';
+	}
+	return copy;
+}
+
+int
+text_index_next(const text_index_t *ti, size_t line, size_t *next)
+{
+	size_t pos = line_end(ti, line);
+
+	if(pos == ti->size)
+	{
+		return 1;
+	}
+
+	if(ti->data[pos] == '\0')
+	{
+		/* Sequence of null characters is a single line break. */
+		while(pos < ti->size && ti->data[pos] == '\0')
+		{
+			++pos;
+		}
+	}
+	else if(ti->data[pos] == '\r' && pos + 1U < ti->size &&
+			ti->data[pos + 1U] == '\n')
+	{
+		pos += 2U;
+	}
+	else
+	{
+		++pos;
+	}
+
+	if(pos == ti->size)
+	{
+		return 1;
+	}
+
+	*next = pos;
+	return 0;
+}
+
+int
+text_index_prev(const text_index_t *ti, size_t line, size_t *prev)
+{
+	size_t pos = line;
+
+	if(pos == 0U)
+	{
+		return 1;
+	}
+
+	/* Skip line break of the previous line. */
+	if(ti->data[pos - 1U] == '\0')
+	{
+		while(pos > 0U && ti->data[pos - 1U] == '\0')
+		{
+			--pos;
+		}
+		/* Null characters at the beginning of a line make an empty line. */
+		if(pos == 0U || ti->data[pos - 1U] == '\n' || ti->data[pos - 1U] == '\r')
+		{
+			*prev = pos;
+			return 0;
+		}
+	}
+	else if(ti->data[pos - 1U] == '\n' && pos > 1U && ti->data[pos - 2U] == '\r')
+	{
+		pos -= 2U;
+	}
+	else
+	{
+		--pos;
+	}
+
+	*prev = find_line_start(ti, pos);
+	return 0;
+}
+
+size_t
+text_index_last(const text_index_t *ti)
+{
+	return text_index_line_at(ti, ti->size);
+}
+
+size_t
+text_index_line_at(const text_index_t *ti, size_t pos)
+{
+	if(ti->size == 0U)
+	{
+		return 0U;
+	}
+
+	if(pos >= ti->size)
+	{
+		pos = ti->size - 1U;
+	}
+
+	if(ti->data[pos] == '\0')
+	{
+		while(pos > 0U && ti->data[pos - 1U] == '\0')
+		{
+			--pos;
+		}
+		if(pos == 0U || ti->data[pos - 1U] == '\n' || ti->data[pos - 1U] == '\r')
+		{
+			return pos;
+		}
+	}
+	else if(ti->data[pos] == '\n' && pos > 0U && ti->data[pos - 1U] == '\r')
+	{
+		--pos;
+	}
+
+	return find_line_start(ti, pos);
+}
+
+size_t
+text_index_at_percent(text_index_t *ti, int percent)
+{
+	size_t line;
+
+	pthread_mutex_lock(&ti->mutex);
+	if(ti->complete && ti->nlines != 0)
+	{
+		const int n = (int)(((long long)percent*ti->nlines)/100);
+		line = ti->lines[(n < ti->nlines) ? n : (ti->nlines - 1)];
+		pthread_mutex_unlock(&ti->mutex);
+		return line;
+	}
+	pthread_mutex_unlock(&ti->mutex);
+
+	return text_index_line_at(ti, (ti->size/100U)*percent +
+			((ti->size%100U)*percent)/100U);
+}
+
+int
+text_index_find(text_index_t *ti, int number, size_t *line)
+{
+	int n;
+
+	pthread_mutex_lock(&ti->mutex);
+
+	while(number >= ti->nlines && index_chunk(ti) == 0)
+	{
+		/* Keep indexing. */
+	}
+
+	if(number < ti->nlines)
+	{
+		*line = ti->lines[number];
+		pthread_mutex_unlock(&ti->mutex);
+		return 0;
+	}
+
+	/* Either there is no such line or the index is incomplete. */
+	n = ti->nlines - 1;
+	*line = (n < 0) ? 0U : ti->lines[n];
+	pthread_mutex_unlock(&ti->mutex);
+
+	while(n < number && text_index_next(ti, *line, line) == 0)
+	{
+		++n;
+	}
+	return n != number;
+}
+
+int
+text_index_number(text_index_t *ti, size_t line, int *number)
+{
+	int estimated;
+
+	pthread_mutex_lock(&ti->mutex);
+	estimated = (line != 0U &&
+			(ti->nlines == 0 || line > ti->lines[ti->nlines - 1]));
+	*number = estimated ? estimate_number(ti, line) : find_indexed(ti, line);
+	pthread_mutex_unlock(&ti->mutex);
+
+	return estimated;
+}
+
+int
+text_index_count(text_index_t *ti, int *count)
+{
+	int estimated;
+
+	pthread_mutex_lock(&ti->mutex);
+	estimated = !ti->complete;
+	*count = estimated ? estimate_number(ti, ti->size) + 1 : ti->nlines;
+	pthread_mutex_unlock(&ti->mutex);
+
+	return estimated;
+}
+
+/* Checks whether character ends a line.  Returns non-zero if so, otherwise
+ * zero is returned. */
+static int
+is_eol(char c)
+{
+	return c == '\n' || c == '\r' || c == '\0';
+}
+
+/* Finds end of the line (position of its line break or end of the text).
+ * Returns the position. */
+static size_t
+line_end(const text_index_t *ti, size_t line)
+{
+	const char *p = ti->data + line;
+	const char *const end = ti->data + ti->size;
+	while(p != end && !is_eol(*p))
+	{
+		++p;
+	}
+	return p - ti->data;
+}
+
+/* Finds beginning of the line which ends at the end position.  Returns the
+ * beginning. */
+static size_t
+find_line_start(const text_index_t *ti, size_t end)
+{
+	while(end > 0U && !is_eol(ti->data[end - 1U]))
+	{
+		--end;
+	}
+	return end;
+}
+
+/* Entry point of background thread that indexes the whole text. */
+static void *
+index_in_bg(void *arg)
+{
+	text_index_t *const ti = arg;
+	int done;
+
+	do
+	{
+		pthread_mutex_lock(&ti->mutex);
+		done = ti->stop || index_chunk(ti) != 0;
+		pthread_mutex_unlock(&ti->mutex);
+	}
+	while(!done);
+
+	return NULL;
+}
+
+/* Extends index by a bunch of lines.  Text is scanned with the mutex unlocked
+ * and only one thread scans it at a time.  Should be called with the mutex
+ * locked.  Returns zero if there is more to index, otherwise non-zero is
+ * returned. */
+static int
+index_chunk(text_index_t *ti)
+{
+	size_t *lines;
+	size_t pos;
+	int first, i;
+
+	while(ti->indexing)
+	{
+		pthread_cond_wait(&ti->cond, &ti->mutex);
+	}
+
+	if(ti->complete || ti->failed)
+	{
+		return 1;
+	}
+
+	if(ti->capacity - ti->nlines < INDEX_CHUNK + 1)
+	{
+		int capacity = (ti->capacity == 0) ? 1024 : ti->capacity*2;
+		if(capacity < ti->nlines + INDEX_CHUNK + 1)
+		{
+			capacity = ti->nlines + INDEX_CHUNK + 1;
+		}
+
+		lines = realloc(ti->lines, sizeof(*lines)*capacity);
+		if(lines == NULL)
+		{
+			ti->failed = 1;
+			return 1;
+		}
+		ti->lines = lines;
+		ti->capacity = capacity;
+	}
+
+	if(ti->nlines == 0)
+	{
+		ti->lines[ti->nlines++] = 0U;
+	}
+
+	ti->indexing = 1;
+	lines = ti->lines;
+	first = ti->nlines;
+	pos = lines[first - 1];
+	pthread_mutex_unlock(&ti->mutex);
+
+	for(i = 0; i < INDEX_CHUNK && text_index_next(ti, pos, &pos) == 0; ++i)
+	{
+		lines[first + i] = pos;
+	}
+
+	pthread_mutex_lock(&ti->mutex);
+	ti->nlines += i;
+	ti->complete = (i < INDEX_CHUNK);
+	ti->indexing = 0;
+	pthread_cond_broadcast(&ti->cond);
+
+	return ti->complete;
+}
+
+/* Finds number of indexed line by its beginning.  Should be called with the
+ * mutex locked.  Returns the number. */
+static int
+find_indexed(const text_index_t *ti, size_t line)
+{
+	int l = 0, r = ti->nlines - 1;
+	while(l < r)
+	{
+		const int m = l + (r - l + 1)/2;
+		if(ti->lines[m] <= line)
+		{
+			l = m;
+		}
+		else
+		{
+			r = m - 1;
+		}
+	}
+	return l;
+}
+
+/* Estimates number of the line at the pos offset, which is past the indexed
+ * part of the text, using average length of indexed lines.  Should be called
+ * with the mutex locked.  Returns the estimate. */
+static int
+estimate_number(const text_index_t *ti, size_t pos)
+{
+	const int last = ti->nlines - 1;
+	const size_t base = (last < 0) ? 0U : ti->lines[last];
+	const size_t avg = (last > 0) ? base/last : DEFAULT_LINE_LEN;
+	const size_t estimate = (last < 0 ? 0 : last) + (pos - base)/(avg ? avg : 1);
+	return (estimate > (size_t)ti->nlines) ? (int)estimate : ti->nlines;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */
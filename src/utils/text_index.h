@@ -0,0 +1,91 @@
+/* vifm
+ * Copyright (C) 2014 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__UTILS__TEXT_INDEX_H__
+#define VIFM__UTILS__TEXT_INDEX_H__
+
+#include <stddef.h> /* size_t */
+#include <stdio.h> /* FILE */
+
+/* Text of a file or a stream with lazily built index of line offsets.  Lines
+ * are separated in the same way as by read_file_lines() and lines are
+ * identified by offsets of their first bytes, which makes navigation possible
+ * before the index is built.  Line numbers start with zero. */
+
+typedef struct text_index_t text_index_t;
+
+/* Maps file into memory or reads it if it can't be mapped.  Part of mapped file
+ * that is removed by truncating it reads as null characters.  Returns NULL on
+ * error. */
+text_index_t * text_index_open(const char path[]);
+
+/* Reads stream that doesn't need to be seekable (e.g. a pipe) until its end.
+ * Returns NULL on error. */
+text_index_t * text_index_read(FILE *fp);
+
+/* Stops indexing and frees all resources of the text.  The ti can be NULL. */
+void text_index_free(text_index_t *ti);
+
+/* Starts indexing line offsets in a separate thread.  Returns zero on success,
+ * otherwise non-zero is returned. */
+int text_index_start_bg(text_index_t *ti);
+
+/* Checks whether the text has no lines.  Returns non-zero if so, otherwise
+ * zero is returned. */
+int text_index_is_empty(const text_index_t *ti);
+
+/* Makes null terminated copy of the line without line terminator.  Returns
+ * newly allocated string or NULL on error. */
+char * text_index_get_line(const text_index_t *ti, size_t line);
+
+/* Finds line that follows the line.  Returns zero on success and non-zero if
+ * the line is the last one. */
+int text_index_next(const text_index_t *ti, size_t line, size_t *next);
+
+/* Finds line that precedes the line.  Returns zero on success and non-zero if
+ * the line is the first one. */
+int text_index_prev(const text_index_t *ti, size_t line, size_t *prev);
+
+/* Finds beginning of the last line of the text. */
+size_t text_index_last(const text_index_t *ti);
+
+/* Finds beginning of the line that contains byte at the pos offset (position
+ * past the end of the text is treated as the last byte). */
+size_t text_index_line_at(const text_index_t *ti, size_t pos);
+
+/* Finds beginning of the line at specified fraction of the text, which is
+ * computed by line count for indexed text and by size otherwise. */
+size_t text_index_at_percent(text_index_t *ti, int percent);
+
+/* Finds beginning of line by its number indexing the text up to it if needed.
+ * Returns zero on success and non-zero if there is no such line, in which case
+ * *line is set to the last line. */
+int text_index_find(text_index_t *ti, int number, size_t *line);
+
+/* Retrieves number of the line.  Returns zero if the number is exact and
+ * non-zero if it's estimated because the text isn't indexed that far yet. */
+int text_index_number(text_index_t *ti, size_t line, int *number);
+
+/* Retrieves number of lines in the text.  Returns zero if the number is exact
+ * and non-zero if it's estimated. */
+int text_index_count(text_index_t *ti, int *count);
+
+#endif /* VIFM__UTILS__TEXT_INDEX_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */
@@ -0,0 +1,150 @@
+/* vifm
+ * Copyright (C) 2014 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "trie.h"
+
+#include <stddef.h> /* NULL */
+#include <stdlib.h> /* calloc() free() */
+
+/* Node of the ternary search tree. */
+typedef struct node_t
+{
+	struct node_t *left;     /* Nodes with smaller characters. */
+	struct node_t *right;    /* Nodes with greater characters. */
+	struct node_t *children; /* Nodes for the next character. */
+	char value;              /* Character of the node. */
+	int exists;              /* Whether the node ends a string. */
+	void *data;              /* Data associated with the string. */
+}
+node_t;
+
+/* Root of the trie. */
+struct trie_t
+{
+	node_t *root; /* First node or NULL for empty trie. */
+};
+
+static void free_nodes(node_t *node);
+
+trie_t
+trie_create(void)
+{
+	return calloc(1, sizeof(struct trie_t));
+}
+
+void
+trie_free(trie_t trie)
+{
+	if(trie != NULL_TRIE)
+	{
+		free_nodes(trie->root);
+		free(trie);
+	}
+}
+
+/* Frees the node and all nodes reachable from it. */
+static void
+free_nodes(node_t *node)
+{
+	while(node != NULL)
+	{
+		node_t *const right = node->right;
+		free_nodes(node->left);
+		free_nodes(node->children);
+		free(node);
+		node = right;
+	}
+}
+
+int
+trie_set(trie_t trie, const char str[], void *data)
+{
+	node_t **link = &trie->root;
+
+	while(1)
+	{
+		node_t *node = *link;
+		if(node == NULL)
+		{
+			node = calloc(1, sizeof(*node));
+			if(node == NULL)
+			{
+				return 1;
+			}
+			node->value = *str;
+			*link = node;
+		}
+
+		if(*str < node->value)
+		{
+			link = &node->left;
+		}
+		else if(*str > node->value)
+		{
+			link = &node->right;
+		}
+		else if(*str == '\0')
+		{
+			node->exists = 1;
+			node->data = data;
+			return 0;
+		}
+		else
+		{
+			link = &node->children;
+			++str;
+		}
+	}
+}
+
+int
+trie_get(trie_t trie, const char str[], void **data)
+{
+	const node_t *node = trie->root;
+
+	while(node != NULL)
+	{
+		if(*str < node->value)
+		{
+			node = node->left;
+		}
+		else if(*str > node->value)
+		{
+			node = node->right;
+		}
+		else if(*str == '\0')
+		{
+			if(!node->exists)
+			{
+				break;
+			}
+			*data = node->data;
+			return 0;
+		}
+		else
+		{
+			node = node->children;
+			++str;
+		}
+	}
+
+	return 1;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */
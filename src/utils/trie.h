@@ -0,0 +1,49 @@
+/* vifm
+ * Copyright (C) 2014 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__UTILS__TRIE_H__
+#define VIFM__UTILS__TRIE_H__
+
+#include <stddef.h> /* NULL */
+
+/* Associative array that maps strings to pointers (ternary search tree). */
+
+#define NULL_TRIE NULL
+
+struct trie_t;
+typedef struct trie_t *trie_t;
+
+/* Creates empty trie.  Returns NULL_TRIE on error. */
+trie_t trie_create(void);
+
+/* Frees memory allocated for the trie.  Data associated with strings is not
+ * freed.  The trie can be NULL_TRIE. */
+void trie_free(trie_t trie);
+
+/* Associates the data with the str replacing previous association.  Returns
+ * non-zero on memory allocation error, otherwise zero is returned. */
+int trie_set(trie_t trie, const char str[], void *data);
+
+/* Retrieves data associated with the str.  Returns non-zero if the str isn't
+ * in the trie, otherwise zero is returned and *data is set. */
+int trie_get(trie_t trie, const char str[], void **data);
+
+#endif /* VIFM__UTILS__TRIE_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */
@@ -27,18 +27,20 @@
 #include <sys/wait.h> /* waitpid */
 #include <fcntl.h> /* O_RDONLY open() close() */
 #include <grp.h> /* getgrnam() */
+#include <poll.h> /* POLLERR POLLPRI poll() */
+#include <pthread.h> /* PTHREAD_MUTEX_INITIALIZER pthread_mutex_* */
 #include <pwd.h> /* getpwnam() */
 #include <unistd.h> /* X_OK access() dup2() getpid() */
 
-#include <assert.h> /* assert() */
 #include <ctype.h> /* isdigit() */
 #include <errno.h> /* EINTR errno */
 #include <signal.h> /* signal() SIGINT SIGTSTP SIGCHLD SIG_DFL sigset_t
                        sigemptyset() sigaddset() sigprocmask() SIG_BLOCK
                        SIG_UNBLOCK */
+#include <time.h> /* timespec nanosleep() */
 #include <stddef.h> /* NULL size_t */
 #include <stdio.h> /* snprintf() */
-#include <stdlib.h> /* atoi() free() */
+#include <stdlib.h> /* atoi() free() qsort() realloc() */
 #include <string.h> /* strchr() strdup() strlen() strncmp() */
 
 #include "../cfg/config.h"
@@ -52,29 +54,49 @@
 #include "str.h"
 #include "utils.h"
 
-/* Types of mount point information for get_mount_point_traverser_state. */
-typedef enum
+/* File, which signals changes of mount table via POLLPRI. */
+#define MOUNTINFO_PATH "/proc/self/mountinfo"
+
+/* Cached entry of mount table. */
+typedef struct
 {
-	MI_MOUNT_POINT, /* Path to the mount point. */
-	MI_FS_TYPE,     /* File system name. */
+	struct mntent ent; /* Fields as read from mount table. */
+	size_t dir_len;    /* Length of ent.mnt_dir. */
 }
-mntinfo;
+mount_point_t;
 
-/* State for get_mount_point() traverser. */
+/* Cached mount table. */
 typedef struct
 {
-	mntinfo type;     /* Type of information to put into the buffer. */
-	const char *path; /* Path whose mount point we're looking for. */
-	size_t buf_len;   /* Output buffer length. */
-	char *buf;        /* Output buffer. */
-	size_t curr_len;  /* Max length among all found points (len of buf string). */
+	mount_point_t *points;  /* Mount points in order of the mount table. */
+	mount_point_t **by_len; /* Mount points sorted by length, longest first. */
+	int count;              /* Number of mount points. */
+	int loaded;             /* Whether points reflect a successful read. */
+	const char *path;       /* Mount table that was read. */
+	int mountinfo_fd;       /* Descriptor to watch for changes or -1. */
+	int initialized;        /* Whether mountinfo_fd was tried to be opened. */
 }
-get_mount_point_traverser_state;
-
-static int get_mount_info_traverser(struct mntent *entry, void *arg);
+mount_cache_t;
+
+static const mount_point_t * find_mount_point(const char path[]);
+static int update_mount_cache(void);
+static int mount_table_changed(void);
+static int load_mount_table(void);
+static int copy_mount_points(mount_point_t **points);
+static int copy_mntent(struct mntent *dst, const struct mntent *src);
+static void free_mount_table(void);
+static void free_mount_points(mount_point_t points[], int count);
+static int mount_point_len_cmp(const void *first, const void *second);
 static int starts_with_list_item(const char str[], const char list[]);
 static int find_path_prefix_index(const char path[], const char list[]);
 
+/* Path to file with mount table. */
+TSTATIC const char *mount_table_path = "/etc/mtab";
+/* Mount table, which is re-read only after it changes. */
+static mount_cache_t mount_cache = { .mountinfo_fd = -1 };
+/* Protects mount_cache, as it's accessed from background jobs. */
+static pthread_mutex_t mount_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void
 pause_shell(void)
 {
@@ -160,6 +182,16 @@ wait_for_data_from(pid_t pid, FILE *f, int fd)
 	while(select_result == 0 || (select_result == -1 && errno == EINTR));
 }
 
+void
+sleep_ms(int ms)
+{
+	struct timespec ts = { .tv_sec = ms/1000, .tv_nsec = (ms%1000)*1000000L };
+	while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+	{
+		/* Continue sleeping for the rest of the time. */
+	}
+}
+
 int
 set_sigchld(int block)
 {
@@ -291,15 +323,7 @@ refers_to_slower_fs(const char from[], const char to[])
 int
 is_on_slow_fs(const char full_path[])
 {
-	char fs_name[PATH_MAX];
-	get_mount_point_traverser_state state =
-	{
-		.type = MI_FS_TYPE,
-		.path = full_path,
-		.buf_len = sizeof(fs_name),
-		.buf = fs_name,
-		.curr_len = 0UL,
-	};
+	int on_slow_fs = 0;
 
 	/* Empty list optimization. */
 	if(cfg.slow_fs_list[0] == '\0')
@@ -307,83 +331,278 @@ is_on_slow_fs(const char full_path[])
 		return 0;
 	}
 
-	if(traverse_mount_points(&get_mount_info_traverser, &state) == 0)
+	pthread_mutex_lock(&mount_cache_lock);
+	if(update_mount_cache() == 0)
+	{
+		const mount_point_t *const point = find_mount_point(full_path);
+		on_slow_fs = point != NULL &&
+			starts_with_list_item(point->ent.mnt_type, cfg.slow_fs_list);
+	}
+	pthread_mutex_unlock(&mount_cache_lock);
+
+	return on_slow_fs ||
+		find_path_prefix_index(full_path, cfg.slow_fs_list) != -1;
+}
+
+int
+get_mount_point(const char path[], size_t buf_len, char buf[])
+{
+	int result;
+
+	pthread_mutex_lock(&mount_cache_lock);
+	result = update_mount_cache();
+	if(result == 0)
 	{
-		if(state.curr_len > 0)
+		const mount_point_t *const point = find_mount_point(path);
+		if(point != NULL)
 		{
-			if(starts_with_list_item(fs_name, cfg.slow_fs_list))
-			{
-				return 1;
-			}
+			copy_str(buf, buf_len, point->ent.mnt_dir);
 		}
 	}
+	pthread_mutex_unlock(&mount_cache_lock);
 
-	return find_path_prefix_index(full_path, cfg.slow_fs_list) != -1;
+	return result;
 }
 
 int
-get_mount_point(const char path[], size_t buf_len, char buf[])
+traverse_mount_points(mptraverser client, void *arg)
+{
+	mount_point_t *points;
+	int count;
+	int i;
+
+	/* Clients might access file system, so they are given a copy of the table to
+	 * not block other users of the cache meanwhile. */
+	pthread_mutex_lock(&mount_cache_lock);
+	count = (update_mount_cache() == 0) ? copy_mount_points(&points) : -1;
+	pthread_mutex_unlock(&mount_cache_lock);
+
+	if(count < 0)
+	{
+		return 1;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		client(&points[i].ent, arg);
+	}
+
+	free_mount_points(points, count);
+	return 0;
+}
+
+/* Finds mount point that contains the path.  Should be called after successful
+ * update_mount_cache().  Returns the mount point or NULL if nothing is
+ * found. */
+static const mount_point_t *
+find_mount_point(const char path[])
 {
-	get_mount_point_traverser_state state =
+	int i;
+	for(i = 0; i < mount_cache.count; ++i)
 	{
-		.type = MI_MOUNT_POINT,
-		.path = path,
-		.buf_len = buf_len,
-		.buf = buf,
-		.curr_len = 0UL,
-	};
-	return traverse_mount_points(&get_mount_info_traverser, &state);
+		if(path_starts_with(path, mount_cache.by_len[i]->ent.mnt_dir))
+		{
+			return mount_cache.by_len[i];
+		}
+	}
+	return NULL;
 }
 
-/* traverse_mount_points client that gets mount point info for a given path. */
+/* Makes sure that cached mount table is up to date.  Mount table is re-read on
+ * each call if there is no way to get notified about its changes.  Returns
+ * non-zero on error, otherwise zero is returned. */
 static int
-get_mount_info_traverser(struct mntent *entry, void *arg)
+update_mount_cache(void)
 {
-	get_mount_point_traverser_state *const state = arg;
-	if(path_starts_with(state->path, entry->mnt_dir))
+	if(!mount_cache.initialized)
 	{
-		const size_t new_len = strlen(entry->mnt_dir);
-		if(new_len > state->curr_len)
+		mount_cache.mountinfo_fd = open(MOUNTINFO_PATH, O_RDONLY);
+		if(mount_cache.mountinfo_fd != -1)
 		{
-			state->curr_len = new_len;
-			switch(state->type)
-			{
-				case MI_MOUNT_POINT:
-					copy_str(state->buf, state->buf_len, entry->mnt_dir);
-					break;
-				case MI_FS_TYPE:
-					copy_str(state->buf, state->buf_len, entry->mnt_type);
-					break;
-
-				default:
-					assert(0 && "Unknown mount information type.");
-					break;
-			}
+			(void)fcntl(mount_cache.mountinfo_fd, F_SETFD, FD_CLOEXEC);
 		}
+		mount_cache.initialized = 1;
 	}
-	return 0;
+
+	if(mount_cache.loaded && mount_cache.path == mount_table_path &&
+			!mount_table_changed())
+	{
+		return 0;
+	}
+
+	return load_mount_table();
 }
 
-int
-traverse_mount_points(mptraverser client, void *arg)
+/* Checks whether mount table might have changed since previous call.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+mount_table_changed(void)
+{
+	struct pollfd pfd = { .fd = mount_cache.mountinfo_fd, .events = POLLPRI };
+
+	if(mount_cache.mountinfo_fd == -1)
+	{
+		return 1;
+	}
+
+	if(poll(&pfd, 1, 0) < 0)
+	{
+		return 1;
+	}
+
+	return (pfd.revents & (POLLPRI | POLLERR)) != 0;
+}
+
+/* Reads mount table into the cache.  Returns non-zero on error, otherwise zero
+ * is returned. */
+static int
+load_mount_table(void)
 {
 	FILE *f;
 	struct mntent *ent;
+	int i;
 
-	if((f = setmntent("/etc/mtab", "r")) == NULL)
+	free_mount_table();
+
+	if((f = setmntent(mount_table_path, "r")) == NULL)
 	{
 		return 1;
 	}
+	mount_cache.path = mount_table_path;
 
 	while((ent = getmntent(f)) != NULL)
 	{
-		client(ent, arg);
+		mount_point_t *const points = realloc(mount_cache.points,
+				sizeof(*points)*(mount_cache.count + 1));
+		mount_point_t *point;
+		if(points == NULL)
+		{
+			break;
+		}
+		mount_cache.points = points;
+
+		point = &points[mount_cache.count];
+		if(copy_mntent(&point->ent, ent) != 0)
+		{
+			break;
+		}
+		point->dir_len = strlen(point->ent.mnt_dir);
+		++mount_cache.count;
 	}
 
 	endmntent(f);
+
+	mount_cache.by_len = malloc(sizeof(*mount_cache.by_len)*mount_cache.count);
+	if(mount_cache.by_len == NULL && mount_cache.count != 0)
+	{
+		free_mount_table();
+		return 1;
+	}
+
+	for(i = 0; i < mount_cache.count; ++i)
+	{
+		mount_cache.by_len[i] = &mount_cache.points[i];
+	}
+	qsort(mount_cache.by_len, mount_cache.count, sizeof(*mount_cache.by_len),
+			&mount_point_len_cmp);
+
+	mount_cache.loaded = 1;
+	return 0;
+}
+
+/* Makes a copy of mount points of the cache.  Should be called after
+ * successful update_mount_cache().  Returns number of points in *points, which
+ * should be freed with free_mount_points(), or -1 on error. */
+static int
+copy_mount_points(mount_point_t **points)
+{
+	int i;
+
+	*points = malloc(sizeof(**points)*mount_cache.count);
+	if(*points == NULL && mount_cache.count != 0)
+	{
+		return -1;
+	}
+
+	for(i = 0; i < mount_cache.count; ++i)
+	{
+		(*points)[i].dir_len = mount_cache.points[i].dir_len;
+		if(copy_mntent(&(*points)[i].ent, &mount_cache.points[i].ent) != 0)
+		{
+			free_mount_points(*points, i);
+			return -1;
+		}
+	}
+
+	return mount_cache.count;
+}
+
+/* Copies mount table entry duplicating its strings.  Returns non-zero on error,
+ * otherwise zero is returned. */
+static int
+copy_mntent(struct mntent *dst, const struct mntent *src)
+{
+	*dst = *src;
+	dst->mnt_fsname = strdup(src->mnt_fsname);
+	dst->mnt_dir = strdup(src->mnt_dir);
+	dst->mnt_type = strdup(src->mnt_type);
+	dst->mnt_opts = strdup(src->mnt_opts);
+	if(dst->mnt_fsname == NULL || dst->mnt_dir == NULL ||
+			dst->mnt_type == NULL || dst->mnt_opts == NULL)
+	{
+		free(dst->mnt_fsname);
+		free(dst->mnt_dir);
+		free(dst->mnt_type);
+		free(dst->mnt_opts);
+		return 1;
+	}
 	return 0;
 }
 
+/* Frees cached mount table and marks it as not loaded. */
+static void
+free_mount_table(void)
+{
+	free_mount_points(mount_cache.points, mount_cache.count);
+	free(mount_cache.by_len);
+
+	mount_cache.points = NULL;
+	mount_cache.by_len = NULL;
+	mount_cache.count = 0;
+	mount_cache.loaded = 0;
+}
+
+/* Frees count mount points and the array that holds them. */
+static void
+free_mount_points(mount_point_t points[], int count)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		struct mntent *const ent = &points[i].ent;
+		free(ent->mnt_fsname);
+		free(ent->mnt_dir);
+		free(ent->mnt_type);
+		free(ent->mnt_opts);
+	}
+	free(points);
+}
+
+/* Orders mount points by length of their paths, longest first.  Mount points of
+ * the same length retain order of the mount table. */
+static int
+mount_point_len_cmp(const void *first, const void *second)
+{
+	const mount_point_t *const a = *(const mount_point_t **)first;
+	const mount_point_t *const b = *(const mount_point_t **)second;
+
+	if(a->dir_len != b->dir_len)
+	{
+		return (a->dir_len < b->dir_len) ? 1 : -1;
+	}
+	return (a < b) ? -1 : (a > b);
+}
+
 /* Checks that the str has at least one of comma separated list (the list) items
  * as a prefix.  Returns non-zero if so, otherwise zero is returned. */
 static int
@@ -21,6 +21,7 @@
 #define VIFM__UTILS__UTILS_NIX_H__
 
 #include "macros.h"
+#include "test_helpers.h"
 
 #include <sys/types.h> /* gid_t mode_t pid_t uid_t */
 #include <sys/wait.h> /* WEXITSTATUS() WIFEXITED() */
@@ -47,6 +48,10 @@ int get_gid(const char group[], gid_t *gid);
 
 int S_ISEXE(mode_t mode);
 
+TSTATIC_DEFS(
+	extern const char *mount_table_path;
+)
+
 #endif /* VIFM__UTILS__UTILS_NIX_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -117,6 +117,12 @@ wait_for_data_from(pid_t pid, FILE *f, int fd)
 	/* Do nothing.  No need to wait for anything on this platform. */
 }
 
+void
+sleep_ms(int ms)
+{
+	Sleep(ms);
+}
+
 int
 set_sigchld(int block)
 {
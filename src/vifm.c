@@ -62,6 +62,7 @@
 #include "commands.h"
 #include "commands_completion.h"
 #include "dir_stack.h"
+#include "file_magic.h"
 #include "filelist.h"
 #include "fileops.h"
 #include "filetype.h"
@@ -365,6 +366,8 @@ main(int argc, char *argv[])
 
 	init_fileops();
 
+	init_magic_handlers();
+
 	set_view_path(&lwin, lwin_path);
 	set_view_path(&rwin, rwin_path);
 
@@ -758,6 +761,7 @@ vifm_try_leave(int write_info, int force)
 	if(write_info)
 	{
 		write_info_file();
+		write_dir_sizes_file();
 	}
 
 	if(curr_stats.file_picker_mode)
@@ -807,6 +811,7 @@ vifm_return_file_list(const FileView *view, int nfiles, char *files[])
 	}
 
 	write_info_file();
+	write_dir_sizes_file();
 
 	endwin();
 	exit(exit_code);
@@ -865,6 +870,7 @@ vifm_finish(const char message[])
 {
 	endwin();
 	write_info_file();
+	write_dir_sizes_file();
 	fprintf(stderr, "%s\n", message);
 	LOG_ERROR_MSG("Finishing: %s", message);
 	exit(EXIT_FAILURE);
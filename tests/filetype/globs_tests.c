@@ -0,0 +1,104 @@
+#include "seatest.h"
+
+#include "../../src/globals.h"
+
+static void
+test_suffix_and_exact_globs(void)
+{
+	globs_t *const globs = globs_alloc();
+
+	assert_int_equal(0, globs_add(globs, "*.tar.gz"));
+	assert_int_equal(0, globs_add(globs, "Makefile"));
+	assert_int_equal(0, globs_add(globs, "*.gz"));
+
+	assert_int_equal(0, globs_find(globs, "file.TAR.GZ", 0));
+	assert_int_equal(2, globs_find(globs, "file.TAR.GZ", 1));
+	assert_int_equal(1, globs_find(globs, "makefile", 0));
+	assert_int_equal(-1, globs_find(globs, "GNUmakefile", 0));
+	assert_int_equal(-1, globs_find(globs, ".gz", 0));
+	assert_int_equal(-1, globs_find(globs, "file.tar", 0));
+
+	globs_free(globs);
+}
+
+static void
+test_star_does_not_match_hidden_files(void)
+{
+	globs_t *const globs = globs_alloc();
+
+	assert_int_equal(0, globs_add(globs, "*"));
+	assert_int_equal(0, globs_add(globs, ".*"));
+
+	assert_int_equal(0, globs_find(globs, "file", 0));
+	assert_int_equal(1, globs_find(globs, ".file", 0));
+	assert_int_equal(-1, globs_find(globs, "", 0));
+
+	globs_free(globs);
+}
+
+static void
+test_order_of_globs_of_different_kinds_is_kept(void)
+{
+	globs_t *const globs = globs_alloc();
+
+	assert_int_equal(0, globs_add(globs, "*.[ch]"));
+	assert_int_equal(0, globs_add(globs, "*.c"));
+	assert_int_equal(0, globs_add(globs, "a?c.c"));
+
+	assert_int_equal(0, globs_find(globs, "abc.c", 0));
+	assert_int_equal(1, globs_find(globs, "abc.c", 1));
+	assert_int_equal(2, globs_find(globs, "abc.c", 2));
+	assert_int_equal(-1, globs_find(globs, "abc.c", 3));
+	assert_int_equal(0, globs_find(globs, "abc.h", 0));
+	assert_int_equal(-1, globs_find(globs, "abc.h", 1));
+
+	globs_free(globs);
+}
+
+static void
+test_globs_agree_with_global_matches(void)
+{
+	static const char *const patterns[] = {
+		"*.c", "*/", "*.TXT", "{a}", "a+b", "*.tar.*", "*", "?", "x[!a-c]y",
+		".*", "abc",
+	};
+	static const char *const files[] = {
+		"a.c", ".c", "dir/", "b.txt", "{a}", "a+b", "f.tar.bz2", "x", "xdy",
+		"xay", ".hidden", "ABC", "abcd", "",
+	};
+
+	globs_t *const globs = globs_alloc();
+	size_t i, j;
+
+	for(i = 0; i < sizeof(patterns)/sizeof(patterns[0]); ++i)
+	{
+		assert_int_equal(0, globs_add(globs, patterns[i]));
+	}
+
+	for(i = 0; i < sizeof(files)/sizeof(files[0]); ++i)
+	{
+		for(j = 0; j < sizeof(patterns)/sizeof(patterns[0]); ++j)
+		{
+			const int expected = global_matches(patterns[j], files[i]);
+			assert_int_equal(expected, globs_find(globs, files[i], j) == (int)j);
+		}
+	}
+
+	globs_free(globs);
+}
+
+void
+globs_tests(void)
+{
+	test_fixture_start();
+
+	run_test(test_suffix_and_exact_globs);
+	run_test(test_star_does_not_match_hidden_files);
+	run_test(test_order_of_globs_of_different_kinds_is_kept);
+	run_test(test_globs_agree_with_global_matches);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */
@@ -11,6 +11,7 @@ void classes_tests(void);
 void replace_double_comma_tests(void);
 void description_tests(void);
 void find_program_tests(void);
+void globs_tests(void);
 
 static void
 setup(void)
@@ -33,6 +34,7 @@ all_tests(void)
 	replace_double_comma_tests();
 	description_tests();
 	find_program_tests();
+	globs_tests();
 }
 
 int
@@ -1,5 +1,7 @@
 #include "seatest.h"
 
+#include <unistd.h> /* usleep() */
+
 #include <stddef.h> /* NULL */
 
 #include "../../src/io/private/ioeta.h"
@@ -67,6 +69,55 @@ test_shallow_estimation_does_not_recur(void)
 	ioeta_free(estim);
 }
 
+static void
+test_background_estimation_can_be_stopped(void)
+{
+	char *paths[] = { "test-data/existing-files", "test-data/various-sizes" };
+	ioeta_estim_t *const estim = ioeta_alloc(NULL);
+
+	ioeta_calculate_bg(estim, paths, 2);
+	ioeta_stop_bg(estim);
+
+	/* Stopping can interrupt estimation, but not cancel what's counted. */
+	assert_true(estim->total_items <= 10);
+	assert_true(estim->total_bytes <= 73728);
+
+	ioeta_free(estim);
+}
+
+static void
+test_background_estimation_finishes_on_its_own(void)
+{
+	char *paths[] = { "test-data/existing-files", "test-data/various-sizes" };
+	ioeta_estim_t *const estim = ioeta_alloc(NULL);
+
+	ioeta_calculate_bg(estim, paths, 2);
+	while(estim->in_background)
+	{
+		usleep(1000);
+	}
+
+	assert_int_equal(10, estim->total_items);
+	assert_int_equal(0, estim->current_item);
+	assert_int_equal(73728, estim->total_bytes);
+	assert_int_equal(0, estim->current_byte);
+
+	ioeta_free(estim);
+}
+
+static void
+test_known_size_is_added_without_examining_path(void)
+{
+	ioeta_estim_t *const estim = ioeta_alloc(NULL);
+
+	ioeta_add_known(estim, "does-not-exist:;", 5, 100);
+
+	assert_int_equal(5, estim->total_items);
+	assert_int_equal(100, estim->total_bytes);
+
+	ioeta_free(estim);
+}
+
 #ifndef _WIN32
 
 static void
@@ -112,6 +163,9 @@ calculate_tests(void)
 	run_test(test_empty_files_are_ok);
 	run_test(test_non_empty_files_are_ok);
 	run_test(test_shallow_estimation_does_not_recur);
+	run_test(test_background_estimation_can_be_stopped);
+	run_test(test_background_estimation_finishes_on_its_own);
+	run_test(test_known_size_is_added_without_examining_path);
 
 #ifndef _WIN32
 	/* Creating symbolic links on Windows requires administrator rights. */
@@ -1,7 +1,10 @@
 #include "seatest.h"
 
+#include <pthread.h>
+
 #include <stddef.h> /* NULL */
 
+#include "../../src/cfg/config.h"
 #include "../../src/io/ioeta.h"
 #include "../../src/io/ionotif.h"
 #include "../../src/io/iop.h"
@@ -9,12 +12,19 @@
 
 static int invoked_eta;
 static int invoked_progress;
+static int invoked_from_other_threads;
 
 static ioeta_estim_t *estim;
+static pthread_t main_thread;
 
 static void
 progress_changed(const io_progress_t *const progress)
 {
+	if(!pthread_equal(pthread_self(), main_thread))
+	{
+		++invoked_from_other_threads;
+	}
+
 	switch(progress->stage)
 	{
 		case IO_PS_ESTIMATING:
@@ -33,6 +43,8 @@ setup(void)
 
 	invoked_eta = 0;
 	invoked_progress = 0;
+	invoked_from_other_threads = 0;
+	main_thread = pthread_self();
 
 	ionotif_register(&progress_changed);
 }
@@ -109,6 +121,7 @@ test_cp_dir_invokes_ionotif(void)
 {
 	ioeta_calculate(estim, "../read", 0);
 
+	cfg.stat_workers = 4;
 	{
 		io_args_t args =
 		{
@@ -119,9 +132,14 @@ test_cp_dir_invokes_ionotif(void)
 		};
 		assert_int_equal(0, ior_cp(&args));
 	}
+	cfg.stat_workers = 0;
 
 	assert_int_equal(6, invoked_eta);
 	assert_true(invoked_progress >= 1);
+	/* Files are copied by several threads, but progress is reported only from
+	 * the one that started copying. */
+	assert_int_equal(0, invoked_from_other_threads);
+	assert_true(estim->current_byte == estim->total_bytes);
 }
 
 static void
@@ -2,10 +2,15 @@
 
 #include <stdio.h> /* EOF FILE fclose() fopen() fread() */
 
+#include <fcntl.h> /* O_CREAT O_TRUNC O_WRONLY open() */
 #include <sys/types.h> /* stat */
 #include <sys/stat.h> /* stat */
-#include <unistd.h> /* lstat() */
+#include <unistd.h> /* close() ftruncate() lseek() lstat() write() */
 
+#include <stdint.h> /* uint64_t */
+
+#include "../../src/io/private/ioeta.h"
+#include "../../src/io/ioeta.h"
 #include "../../src/io/iop.h"
 #include "../../src/utils/fs.h"
 #include "../../src/utils/fs_limits.h"
@@ -311,6 +316,40 @@ test_appending_does_not_shrink_files(void)
 	}
 }
 
+static void
+test_appending_continues_copying_of_partial_file(void)
+{
+	char block[100];
+	FILE *in, *out;
+
+	in = fopen("../read/binary-data", "rb");
+	out = fopen("partial", "wb");
+	assert_int_equal(sizeof(block), fread(block, 1, sizeof(block), in));
+	assert_int_equal(sizeof(block), fwrite(block, 1, sizeof(block), out));
+	fclose(out);
+	fclose(in);
+
+	{
+		io_args_t args =
+		{
+			.arg1.src = "../read/binary-data",
+			.arg2.dst = "partial",
+			.arg3.crs = IO_CRS_APPEND_TO_FILES,
+		};
+		assert_int_equal(0, iop_cp(&args));
+	}
+
+	assert_true(files_are_identical("../read/binary-data", "partial"));
+
+	{
+		io_args_t args =
+		{
+			.arg1.path = "partial",
+		};
+		assert_int_equal(0, iop_rmfile(&args));
+	}
+}
+
 #ifndef WIN32
 
 static void
@@ -364,6 +403,69 @@ test_file_permissions_are_preserved(void)
 	}
 }
 
+static void
+test_holes_in_files_are_preserved(void)
+{
+	const off_t size = 16*1024*1024;
+	const off_t data_offset = 8*1024*1024;
+	struct stat src;
+	struct stat dst;
+	int fd;
+
+	fd = open("sparse", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	assert_true(fd >= 0);
+	assert_int_equal(0, ftruncate(fd, size));
+	assert_true(lseek(fd, data_offset, SEEK_SET) == data_offset);
+	assert_int_equal(4, write(fd, "data", 4));
+	close(fd);
+
+	{
+		io_args_t args =
+		{
+			.arg1.src = "sparse",
+			.arg2.dst = "sparse-copy",
+
+			.estim = ioeta_alloc(NULL),
+		};
+		ioeta_add_file(args.estim, "sparse");
+
+		assert_int_equal(0, iop_cp(&args));
+
+		/* Holes are accounted in progress as well. */
+		assert_true(args.estim->total_bytes == (uint64_t)size);
+		assert_true(args.estim->current_byte == (uint64_t)size);
+		ioeta_free(args.estim);
+	}
+
+	assert_true(files_are_identical("sparse", "sparse-copy"));
+
+	assert_int_equal(0, lstat("sparse", &src));
+	assert_int_equal(0, lstat("sparse-copy", &dst));
+	assert_true(src.st_size == dst.st_size);
+	/* File system might not support holes, in which case only contents is
+	 * checked. */
+	if(src.st_blocks*512 < size)
+	{
+		assert_true(dst.st_blocks*512 < size);
+	}
+
+	{
+		io_args_t args =
+		{
+			.arg1.path = "sparse",
+		};
+		assert_int_equal(0, iop_rmfile(&args));
+	}
+
+	{
+		io_args_t args =
+		{
+			.arg1.path = "sparse-copy",
+		};
+		assert_int_equal(0, iop_rmfile(&args));
+	}
+}
+
 static void
 test_file_symlink_copy_is_symlink(void)
 {
@@ -493,9 +595,11 @@ cp_tests(void)
 	run_test(test_double_block_size_plus_one_file_is_copied);
 	run_test(test_appending_works_for_files);
 	run_test(test_appending_does_not_shrink_files);
+	run_test(test_appending_continues_copying_of_partial_file);
 
 #ifndef _WIN32
 	run_test(test_file_permissions_are_preserved);
+	run_test(test_holes_in_files_are_preserved);
 
 	/* Creating symbolic links on Windows requires administrator rights. */
 	run_test(test_file_symlink_copy_is_symlink);
@@ -4,6 +4,8 @@
 #include <sys/types.h> /* stat */
 #include <unistd.h> /* F_OK access() lstat() */
 
+#include <stdio.h> /* FILE fclose() fopen() snprintf() */
+
 #include "../../src/io/iop.h"
 #include "../../src/io/ior.h"
 #include "../../src/utils/fs.h"
@@ -429,6 +431,84 @@ test_permissions_are_set_in_correct_order(void)
 	}
 }
 
+static void
+test_many_files_in_read_only_dirs_are_copied(void)
+{
+	enum { NFILES = 1500 };
+
+	struct stat src;
+	struct stat dst;
+	char path[64];
+	int i;
+
+	{
+		io_args_t args =
+		{
+			.arg1.path = "dir/nested-dir",
+			.arg2.process_parents = 1,
+			.arg3.mode = 0700,
+		};
+		assert_int_equal(0, iop_mkdir(&args));
+	}
+
+	for(i = 0; i < NFILES; ++i)
+	{
+		FILE *f;
+		snprintf(path, sizeof(path), "dir/%snum-%d", (i%2 ? "nested-dir/" : ""),
+				i);
+		f = fopen(path, "w");
+		assert_true(f != NULL);
+		fclose(f);
+	}
+
+	assert_int_equal(0, chmod("dir/nested-dir", 0500));
+	assert_int_equal(0, chmod("dir", 0500));
+
+	{
+		io_args_t args =
+		{
+			.arg1.src = "dir",
+			.arg2.dst = "dir-copy",
+		};
+		assert_int_equal(0, ior_cp(&args));
+	}
+
+	for(i = 0; i < NFILES; ++i)
+	{
+		snprintf(path, sizeof(path), "dir-copy/%snum-%d",
+				(i%2 ? "nested-dir/" : ""), i);
+		assert_int_equal(0, access(path, F_OK));
+	}
+
+	assert_int_equal(0, lstat("dir/nested-dir", &src));
+	assert_int_equal(0, lstat("dir-copy/nested-dir", &dst));
+	assert_int_equal(src.st_mode & 0777, dst.st_mode & 0777);
+	assert_int_equal(0, lstat("dir", &src));
+	assert_int_equal(0, lstat("dir-copy", &dst));
+	assert_int_equal(src.st_mode & 0777, dst.st_mode & 0777);
+
+	assert_int_equal(0, chmod("dir", 0700));
+	assert_int_equal(0, chmod("dir/nested-dir", 0700));
+	assert_int_equal(0, chmod("dir-copy", 0700));
+	assert_int_equal(0, chmod("dir-copy/nested-dir", 0700));
+
+	{
+		io_args_t args =
+		{
+			.arg1.path = "dir",
+		};
+		assert_int_equal(0, ior_rm(&args));
+	}
+
+	{
+		io_args_t args =
+		{
+			.arg1.path = "dir-copy",
+		};
+		assert_int_equal(0, ior_rm(&args));
+	}
+}
+
 static void
 test_symlink_to_file_is_symlink_after_copy(void)
 {
@@ -537,6 +617,7 @@ cp_tests(void)
 #ifndef WIN32
 	run_test(test_dir_permissions_are_preserved);
 	run_test(test_permissions_are_set_in_correct_order);
+	run_test(test_many_files_in_read_only_dirs_are_copied);
 
 	/* Creating symbolic links on Windows requires administrator rights. */
 	run_test(test_symlink_to_file_is_symlink_after_copy);
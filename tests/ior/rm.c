@@ -1,11 +1,13 @@
 #include "seatest.h"
 
 #include <stdio.h> /* FILE fopen() fclose() */
+#include <string.h> /* memset() */
 
 #include <unistd.h> /* F_OK access() */
 
 #include "../../src/io/ior.h"
 #include "../../src/utils/fs.h"
+#include "../../src/utils/fs_limits.h"
 
 static const char *const FILE_NAME = "file-to-remove";
 static const char *const DIRECTORY_NAME = "directory-to-remove";
@@ -72,6 +74,47 @@ test_non_empty_directory_is_removed(void)
 	assert_int_equal(-1, access(DIRECTORY_NAME, F_OK));
 }
 
+#ifndef _WIN32
+
+static void
+test_tree_deeper_than_path_max_is_removed(void)
+{
+	char name[201];
+	int i;
+
+	memset(name, 'x', sizeof(name) - 1U);
+	name[sizeof(name) - 1U] = '\0';
+
+	make_dir(DIRECTORY_NAME, 0700);
+	assert_int_equal(0, chdir(DIRECTORY_NAME));
+	for(i = 0; i < PATH_MAX/200 + 1; ++i)
+	{
+		make_dir(name, 0700);
+		assert_int_equal(0, chdir(name));
+	}
+	{
+		FILE *const f = fopen(FILE_NAME, "w");
+		fclose(f);
+		assert_int_equal(0, access(FILE_NAME, F_OK));
+	}
+	for(i = 0; i < PATH_MAX/200 + 2; ++i)
+	{
+		assert_int_equal(0, chdir(".."));
+	}
+
+	{
+		io_args_t args =
+		{
+			.arg1.src = DIRECTORY_NAME,
+		};
+		assert_int_equal(0, ior_rm(&args));
+	}
+
+	assert_int_equal(-1, access(DIRECTORY_NAME, F_OK));
+}
+
+#endif
+
 void
 rm_tests(void)
 {
@@ -80,6 +123,9 @@ rm_tests(void)
 	run_test(test_file_is_removed);
 	run_test(test_empty_directory_is_removed);
 	run_test(test_non_empty_directory_is_removed);
+#ifndef _WIN32
+	run_test(test_tree_deeper_than_path_max_is_removed);
+#endif
 
 	test_fixture_end();
 }
@@ -0,0 +1,152 @@
+#include <sys/stat.h> /* mkdir() */
+#include <unistd.h> /* getcwd() rmdir() */
+#include <utime.h> /* utime() utimbuf */
+
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() snprintf() */
+
+#include "seatest.h"
+
+#include "../../src/utils/fs_limits.h"
+#include "../../src/desktop.h"
+#include "../../src/filetype.h"
+
+static void create_desktop_file(const char name[], const char contents[]);
+static void remove_file(const char name[]);
+static void make_dir_old(const char name[]);
+
+static char sandbox[PATH_MAX];
+static char apps_dir[PATH_MAX];
+static const char *dirs[] = { apps_dir, NULL };
+
+static void
+setup(void)
+{
+	char cwd[PATH_MAX];
+	assert_true(getcwd(cwd, sizeof(cwd)) != NULL);
+	snprintf(sandbox, sizeof(sandbox), "%s/test-data/sandbox", cwd);
+	snprintf(apps_dir, sizeof(apps_dir), "%s/apps", sandbox);
+
+	assert_int_equal(0, mkdir(apps_dir, 0700));
+	create_desktop_file("apps/editor.desktop",
+			"Name=Editor\nExec=editor %f\nMimeType=text/plain;text/x-csrc;\n");
+	create_desktop_file("apps/viewer.desktop",
+			"Name=Viewer\nExec=viewer\nMimeType=text/plain;\n");
+
+	desktop_index_init(dirs, 0);
+}
+
+static void
+teardown(void)
+{
+	remove_file("apps/editor.desktop");
+	remove_file("apps/viewer.desktop");
+	assert_int_equal(0, rmdir(apps_dir));
+
+	desktop_index_init(NULL, 0);
+}
+
+static void
+test_handlers_are_found_by_mime_type(void)
+{
+	assoc_records_t handlers = desktop_index_get("text/plain");
+	assert_int_equal(2, handlers.count);
+	free_assoc_records(&handlers);
+
+	handlers = desktop_index_get("text/x-csrc");
+	assert_int_equal(1, handlers.count);
+	if(handlers.count == 1)
+	{
+		assert_string_equal("editor %f", handlers.list[0].command);
+		assert_string_equal("Editor", handlers.list[0].description);
+	}
+	free_assoc_records(&handlers);
+}
+
+static void
+test_mime_type_is_not_matched_partially(void)
+{
+	assoc_records_t handlers = desktop_index_get("text/plai");
+	assert_int_equal(0, handlers.count);
+	free_assoc_records(&handlers);
+
+	handlers = desktop_index_get("text/x-c");
+	assert_int_equal(0, handlers.count);
+	free_assoc_records(&handlers);
+}
+
+static void
+test_index_is_rebuilt_on_directory_change(void)
+{
+	assoc_records_t handlers;
+
+	make_dir_old("apps");
+
+	handlers = desktop_index_get("image/png");
+	assert_int_equal(0, handlers.count);
+	free_assoc_records(&handlers);
+
+	create_desktop_file("apps/image.desktop",
+			"Name=Image\nExec=image %u\nMimeType=image/png;\n");
+
+	handlers = desktop_index_get("image/png");
+	assert_int_equal(1, handlers.count);
+	if(handlers.count == 1)
+	{
+		assert_string_equal("image %f", handlers.list[0].command);
+	}
+	free_assoc_records(&handlers);
+
+	remove_file("apps/image.desktop");
+}
+
+static void
+create_desktop_file(const char name[], const char contents[])
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", sandbox, name);
+	f = fopen(path, "w");
+	assert_true(f != NULL);
+	if(f != NULL)
+	{
+		fputs(contents, f);
+		fclose(f);
+	}
+}
+
+static void
+remove_file(const char name[])
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", sandbox, name);
+	assert_int_equal(0, remove(path));
+}
+
+/* Sets modification time of the directory to the past, so that its changes
+ * within the same second are noticed. */
+static void
+make_dir_old(const char name[])
+{
+	char path[PATH_MAX];
+	struct utimbuf times = { .actime = 1, .modtime = 1 };
+	snprintf(path, sizeof(path), "%s/%s", sandbox, name);
+	assert_int_equal(0, utime(path, &times));
+}
+
+void
+desktop_tests(void)
+{
+	test_fixture_start();
+
+	fixture_setup(setup);
+	fixture_teardown(teardown);
+
+	run_test(test_handlers_are_found_by_mime_type);
+	run_test(test_mime_type_is_not_matched_partially);
+	run_test(test_index_is_rebuilt_on_directory_change);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab : */
@@ -0,0 +1,200 @@
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() snprintf() */
+#include <stdlib.h> /* calloc() free() */
+#include <string.h> /* strdup() */
+#include <sys/stat.h> /* mkdir() */
+#include <unistd.h> /* chdir() getcwd() rmdir() */
+
+#include "seatest.h"
+
+#include "../../src/utils/filter.h"
+#include "../../src/utils/fs_limits.h"
+#include "../../src/filelist.h"
+#include "../../src/ui.h"
+
+static void create_file(const char name[], const char content[]);
+static void remove_file(const char name[]);
+static dir_entry_t * find_entry(const char name[]);
+
+static char cwd[PATH_MAX];
+static char dir[PATH_MAX];
+
+static void
+setup(void)
+{
+	int i;
+
+	assert_true(getcwd(cwd, sizeof(cwd)) != NULL);
+	snprintf(dir, sizeof(dir), "%s/test-data/sandbox/reload", cwd);
+	assert_int_equal(0, mkdir(dir, 0700));
+
+	create_file("b", "");
+	create_file("c", "");
+	create_file("d", "");
+
+	snprintf(lwin.curr_dir, sizeof(lwin.curr_dir), "%s", dir);
+	filter_init(&lwin.manual_filter, 1);
+	filter_init(&lwin.auto_filter, 1);
+	filter_init(&lwin.local_filter.filter, 1);
+	lwin.sort[0] = SK_BY_NAME;
+	for(i = 1; i < SK_COUNT; ++i)
+	{
+		lwin.sort[i] = SK_NONE;
+	}
+
+	/* Same state as before initial loading. */
+	lwin.list_rows = 1;
+	lwin.dir_entry = calloc(1, sizeof(*lwin.dir_entry));
+	lwin.dir_entry[0].name = strdup("");
+	lwin.list_pos = 0;
+	lwin.selected_files = 0;
+
+	populate_dir_list(&lwin, 1);
+}
+
+static void
+teardown(void)
+{
+	int i;
+
+	for(i = 0; i < lwin.list_rows; ++i)
+	{
+		free(lwin.dir_entry[i].name);
+	}
+	free(lwin.dir_entry);
+	lwin.dir_entry = NULL;
+	lwin.list_rows = 0;
+
+	filter_dispose(&lwin.manual_filter);
+	filter_dispose(&lwin.auto_filter);
+	filter_dispose(&lwin.local_filter.filter);
+
+	for(i = 0; i < 4; ++i)
+	{
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%c", dir, 'a' + i);
+		(void)remove(path);
+	}
+
+	assert_int_equal(0, chdir(cwd));
+	assert_int_equal(0, rmdir(dir));
+}
+
+static void
+test_unchanged_entries_keep_their_state(void)
+{
+	lwin.list_pos = find_file_pos_in_list(&lwin, "c");
+	lwin.dir_entry[lwin.list_pos].selected = 1;
+	lwin.dir_entry[lwin.list_pos].search_match = 1;
+	lwin.selected_files = 1;
+
+	populate_dir_list(&lwin, 1);
+
+	assert_string_equal("c", lwin.dir_entry[lwin.list_pos].name);
+	assert_true(lwin.dir_entry[lwin.list_pos].selected);
+	assert_true(lwin.dir_entry[lwin.list_pos].search_match);
+	assert_int_equal(1, lwin.selected_files);
+}
+
+static void
+test_added_entries_are_sorted_in(void)
+{
+	lwin.list_pos = find_file_pos_in_list(&lwin, "c");
+	lwin.dir_entry[lwin.list_pos].selected = 1;
+	lwin.selected_files = 1;
+
+	create_file("a", "");
+	populate_dir_list(&lwin, 1);
+
+	assert_true(find_file_pos_in_list(&lwin, "a") >= 0);
+	assert_int_equal(find_file_pos_in_list(&lwin, "a") + 1,
+			find_file_pos_in_list(&lwin, "b"));
+	assert_false(find_entry("a")->selected);
+
+	assert_string_equal("c", lwin.dir_entry[lwin.list_pos].name);
+	assert_true(lwin.dir_entry[lwin.list_pos].selected);
+	assert_int_equal(1, lwin.selected_files);
+}
+
+static void
+test_removed_entries_are_dropped(void)
+{
+	lwin.list_pos = find_file_pos_in_list(&lwin, "d");
+	find_entry("b")->selected = 1;
+	find_entry("c")->selected = 1;
+	lwin.selected_files = 2;
+
+	remove_file("b");
+	populate_dir_list(&lwin, 1);
+
+	assert_int_equal(-1, find_file_pos_in_list(&lwin, "b"));
+	assert_true(find_entry("c")->selected);
+	assert_int_equal(1, lwin.selected_files);
+	assert_string_equal("d", lwin.dir_entry[lwin.list_pos].name);
+}
+
+static void
+test_changed_entries_are_updated(void)
+{
+	lwin.list_pos = find_file_pos_in_list(&lwin, "c");
+	find_entry("c")->selected = 1;
+	lwin.selected_files = 1;
+	assert_int_equal(0, find_entry("c")->size);
+
+	create_file("c", "content");
+	populate_dir_list(&lwin, 1);
+
+	assert_int_equal(7, find_entry("c")->size);
+	assert_true(find_entry("c")->selected);
+	assert_string_equal("c", lwin.dir_entry[lwin.list_pos].name);
+}
+
+static void
+create_file(const char name[], const char content[])
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	assert_true(f != NULL);
+	if(f != NULL)
+	{
+		fputs(content, f);
+		fclose(f);
+	}
+}
+
+static void
+remove_file(const char name[])
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	assert_int_equal(0, remove(path));
+}
+
+/* Finds entry of the lwin by its name.  Returns pointer to the entry or NULL if
+ * there is no such entry. */
+static dir_entry_t *
+find_entry(const char name[])
+{
+	const int pos = find_file_pos_in_list(&lwin, name);
+	return (pos < 0) ? NULL : &lwin.dir_entry[pos];
+}
+
+void
+dir_reload_tests(void)
+{
+	test_fixture_start();
+
+	fixture_setup(setup);
+	fixture_teardown(teardown);
+
+	run_test(test_unchanged_entries_keep_their_state);
+	run_test(test_added_entries_are_sorted_in);
+	run_test(test_removed_entries_are_dropped);
+	run_test(test_changed_entries_are_updated);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab : */
@@ -0,0 +1,88 @@
+#include <unistd.h> /* getcwd() */
+#include <utime.h> /* utime() utimbuf */
+
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() snprintf() */
+#include <string.h> /* strcmp() strcpy() */
+
+#include "seatest.h"
+
+#include "../../src/utils/fs_limits.h"
+#include "../../src/file_magic.h"
+
+static void write_file(const char contents[]);
+static void set_mtime(time_t mtime);
+
+static char path[PATH_MAX];
+
+static void
+setup(void)
+{
+	char cwd[PATH_MAX];
+	assert_true(getcwd(cwd, sizeof(cwd)) != NULL);
+	snprintf(path, sizeof(path), "%s/test-data/sandbox/magic", cwd);
+}
+
+static void
+teardown(void)
+{
+	assert_int_equal(0, remove(path));
+}
+
+static void
+test_mimetype_is_cached_until_file_changes(void)
+{
+	char mimetype[128];
+	const char *result;
+
+	write_file("plain text\n");
+	set_mtime(100);
+
+	result = get_mimetype(path);
+	assert_true(result != NULL);
+	if(result == NULL)
+	{
+		return;
+	}
+	strcpy(mimetype, result);
+
+	write_file("\x89PNG\r\n\x1a\n");
+	set_mtime(100);
+	assert_string_equal(mimetype, get_mimetype(path));
+
+	set_mtime(200);
+	assert_false(strcmp(mimetype, get_mimetype(path)) == 0);
+}
+
+static void
+write_file(const char contents[])
+{
+	FILE *const f = fopen(path, "w");
+	assert_true(f != NULL);
+	if(f != NULL)
+	{
+		fputs(contents, f);
+		fclose(f);
+	}
+}
+
+static void
+set_mtime(time_t mtime)
+{
+	struct utimbuf times = { .actime = mtime, .modtime = mtime };
+	assert_int_equal(0, utime(path, &times));
+}
+
+void
+file_magic_tests(void)
+{
+	test_fixture_start();
+
+	fixture_setup(setup);
+	fixture_teardown(teardown);
+
+	run_test(test_mimetype_is_cached_until_file_changes);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab : */
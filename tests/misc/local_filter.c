@@ -0,0 +1,147 @@
+#include <stdio.h> /* snprintf() */
+#include <stdlib.h> /* atoi() calloc() free() */
+#include <string.h> /* strcpy() strdup() strstr() */
+
+#include "seatest.h"
+
+#include "../../src/utils/filter.h"
+#include "../../src/filelist.h"
+#include "../../src/ui.h"
+
+static void init_view(int count);
+
+static void
+teardown(void)
+{
+	int i;
+
+	local_filter_cancel(&lwin);
+
+	for(i = 0; i < lwin.list_rows; ++i)
+	{
+		free(lwin.dir_entry[i].name);
+	}
+	free(lwin.dir_entry);
+	lwin.dir_entry = NULL;
+	lwin.list_rows = 0;
+
+	filter_dispose(&lwin.local_filter.filter);
+}
+
+static void
+test_narrowing_and_widening(void)
+{
+	init_view(0);
+
+	local_filter_set(&lwin, "a");
+	assert_int_equal(3, lwin.list_rows);
+
+	local_filter_set(&lwin, "ab");
+	assert_int_equal(2, lwin.list_rows);
+	assert_string_equal("ab", lwin.dir_entry[0].name);
+	assert_string_equal("abc", lwin.dir_entry[1].name);
+
+	local_filter_set(&lwin, "abc");
+	assert_int_equal(1, lwin.list_rows);
+	assert_string_equal("abc", lwin.dir_entry[0].name);
+
+	local_filter_set(&lwin, "a");
+	assert_int_equal(3, lwin.list_rows);
+
+	local_filter_set(&lwin, "a|b");
+	assert_int_equal(4, lwin.list_rows);
+}
+
+static void
+test_quantifiers_do_not_narrow(void)
+{
+	init_view(0);
+
+	local_filter_set(&lwin, "ab");
+	assert_int_equal(2, lwin.list_rows);
+
+	local_filter_set(&lwin, "ab?");
+	assert_int_equal(3, lwin.list_rows);
+}
+
+static void
+test_invalid_regex_shows_everything(void)
+{
+	init_view(0);
+
+	local_filter_set(&lwin, "abc");
+	assert_int_equal(1, lwin.list_rows);
+
+	local_filter_set(&lwin, "abc[");
+	assert_int_equal(5, lwin.list_rows);
+}
+
+static void
+test_large_list_is_filtered(void)
+{
+	int i;
+
+	init_view(20000);
+
+	local_filter_set(&lwin, "1");
+	local_filter_set(&lwin, "12");
+
+	for(i = 0; i < lwin.list_rows; ++i)
+	{
+		assert_true(strstr(lwin.dir_entry[i].name, "12") != NULL);
+		if(i > 0)
+		{
+			/* Order of entries is preserved. */
+			assert_true(atoi(lwin.dir_entry[i - 1].name) <
+					atoi(lwin.dir_entry[i].name));
+		}
+	}
+	/* Number of integers in [0; 20000) that contain "12". */
+	assert_int_equal(1578, lwin.list_rows);
+}
+
+/* Fills the view with five short names and count numbered names. */
+static void
+init_view(int count)
+{
+	static const char *const names[] = { "a", "ab", "abc", "b", "c" };
+	int i;
+
+	lwin.list_rows = 5 + count;
+	lwin.list_pos = 0;
+	lwin.filtered = 0;
+	lwin.dir_entry = calloc(lwin.list_rows, sizeof(*lwin.dir_entry));
+	strcpy(lwin.curr_dir, "/some/dir");
+
+	for(i = 0; i < 5; ++i)
+	{
+		lwin.dir_entry[i].name = strdup(names[i]);
+		lwin.dir_entry[i].type = REGULAR;
+	}
+	for(i = 0; i < count; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "%d", i);
+		lwin.dir_entry[5 + i].name = strdup(name);
+		lwin.dir_entry[5 + i].type = REGULAR;
+	}
+
+	filter_init(&lwin.local_filter.filter, 1);
+}
+
+void
+local_filter_tests(void)
+{
+	test_fixture_start();
+
+	fixture_teardown(teardown);
+
+	run_test(test_narrowing_and_widening);
+	run_test(test_quantifiers_do_not_narrow);
+	run_test(test_invalid_regex_shows_everything);
+	run_test(test_large_list_is_filtered);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab : */
@@ -0,0 +1,135 @@
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() snprintf() */
+#include <stdlib.h> /* free() */
+#include <string.h> /* strdup() */
+#include <unistd.h> /* getcwd() */
+
+#include "seatest.h"
+
+#include "../../src/cfg/config.h"
+#include "../../src/utils/fs_limits.h"
+#include "../../src/utils/mntent.h"
+#include "../../src/utils/utils.h"
+
+#ifndef _WIN32
+
+static char mtab[PATH_MAX];
+static char *saved_slow_fs_list;
+
+static void
+setup(void)
+{
+	char cwd[PATH_MAX];
+	FILE *f;
+
+	assert_true(getcwd(cwd, sizeof(cwd)) != NULL);
+	snprintf(mtab, sizeof(mtab), "%s/test-data/sandbox/mtab", cwd);
+
+	f = fopen(mtab, "w");
+	assert_true(f != NULL);
+	if(f != NULL)
+	{
+		fputs("rootfs / ext4 rw 0 0\n", f);
+		fputs("proc /proc proc rw 0 0\n", f);
+		fputs("server:/export /mnt/nfs nfs rw 0 0\n", f);
+		fputs("/dev/sdb1 /mnt/nfs/usb vfat rw 0 0\n", f);
+		fclose(f);
+	}
+	mount_table_path = mtab;
+
+	saved_slow_fs_list = cfg.slow_fs_list;
+	cfg.slow_fs_list = strdup("");
+}
+
+static void
+teardown(void)
+{
+	free(cfg.slow_fs_list);
+	cfg.slow_fs_list = saved_slow_fs_list;
+
+	mount_table_path = "/etc/mtab";
+	assert_int_equal(0, remove(mtab));
+}
+
+static int
+count_traverser(struct mntent *entry, void *arg)
+{
+	++*(int *)arg;
+	return 0;
+}
+
+static void
+test_mount_point_of_root_is_root(void)
+{
+	char mount_point[PATH_MAX] = "";
+	assert_int_equal(0, get_mount_point("/", sizeof(mount_point), mount_point));
+	assert_string_equal("/", mount_point);
+}
+
+static void
+test_longest_mount_point_is_found(void)
+{
+	char mount_point[PATH_MAX] = "";
+
+	assert_int_equal(0, get_mount_point("/mnt/nfs/usb/file",
+				sizeof(mount_point), mount_point));
+	assert_string_equal("/mnt/nfs/usb", mount_point);
+
+	assert_int_equal(0, get_mount_point("/mnt/nfs/file", sizeof(mount_point),
+				mount_point));
+	assert_string_equal("/mnt/nfs", mount_point);
+
+	assert_int_equal(0, get_mount_point("/mnt/nfsx", sizeof(mount_point),
+				mount_point));
+	assert_string_equal("/", mount_point);
+}
+
+static void
+test_cached_mount_table_is_stable(void)
+{
+	int first = 0;
+	int second = 0;
+	assert_int_equal(0, traverse_mount_points(&count_traverser, &first));
+	assert_int_equal(0, traverse_mount_points(&count_traverser, &second));
+	assert_int_equal(4, first);
+	assert_int_equal(first, second);
+}
+
+static void
+test_slow_fs_is_detected_by_type(void)
+{
+	free(cfg.slow_fs_list);
+	cfg.slow_fs_list = strdup("nfs");
+
+	assert_true(is_on_slow_fs("/mnt/nfs"));
+	assert_true(is_on_slow_fs("/mnt/nfs/dir/file"));
+	assert_false(is_on_slow_fs("/mnt/nfs/usb/file"));
+	assert_false(is_on_slow_fs("/"));
+
+	free(cfg.slow_fs_list);
+	cfg.slow_fs_list = strdup("no-such-fs-type");
+
+	assert_false(is_on_slow_fs("/mnt/nfs"));
+}
+
+#endif
+
+void
+mount_points_tests(void)
+{
+	test_fixture_start();
+
+#ifndef _WIN32
+	fixture_setup(setup);
+	fixture_teardown(teardown);
+
+	run_test(test_mount_point_of_root_is_root);
+	run_test(test_longest_mount_point_is_found);
+	run_test(test_cached_mount_table_is_stable);
+	run_test(test_slow_fs_is_detected_by_type);
+#endif
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */
@@ -0,0 +1,88 @@
+#include "seatest.h"
+
+#include <stdlib.h> /* free() */
+
+#include "../../src/registers.h"
+
+static void
+setup(void)
+{
+	init_registers();
+}
+
+static void
+teardown(void)
+{
+	clear_registers();
+}
+
+static void
+test_duplicates_are_skipped(void)
+{
+	registers_t *const reg = find_register('a');
+
+	append_existing_to_register('a', "/path/a");
+	append_existing_to_register('a', "/path/b");
+	append_existing_to_register('a', "/path/a");
+
+	assert_int_equal(2, reg->num_files);
+	assert_string_equal("/path/a", reg->files[0]);
+	assert_string_equal("/path/b", reg->files[1]);
+}
+
+static void
+test_rename_changes_the_file(void)
+{
+	registers_t *const reg = find_register('a');
+
+	append_existing_to_register('a', "/path/a");
+	append_existing_to_register('a', "/path/b");
+	rename_in_registers("/path/b", "/path/c");
+
+	assert_int_equal(2, reg->num_files);
+	assert_string_equal("/path/c", reg->files[1]);
+
+	append_existing_to_register('a', "/path/b");
+	append_existing_to_register('a', "/path/c");
+	assert_int_equal(3, reg->num_files);
+	assert_string_equal("/path/b", reg->files[2]);
+}
+
+static void
+test_packed_register_is_searchable(void)
+{
+	registers_t *const reg = find_register('a');
+
+	append_existing_to_register('a', "/path/a");
+	append_existing_to_register('a', "/path/b");
+	append_existing_to_register('a', "/path/c");
+
+	free(reg->files[0]);
+	reg->files[0] = NULL;
+	pack_register('a');
+
+	assert_int_equal(2, reg->num_files);
+
+	rename_in_registers("/path/c", "/path/d");
+	assert_string_equal("/path/d", reg->files[1]);
+
+	append_existing_to_register('a', "/path/a");
+	assert_int_equal(3, reg->num_files);
+}
+
+void
+registers_tests(void)
+{
+	test_fixture_start();
+
+	fixture_setup(setup);
+	fixture_teardown(teardown);
+
+	run_test(test_duplicates_are_skipped);
+	run_test(test_rename_changes_the_file);
+	run_test(test_packed_register_is_searchable);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab : */
@@ -53,6 +53,40 @@ test_special_chars_ignore_case_sort(void)
 	assert_string_equal("_", lwin.dir_entry[0].name);
 }
 
+static void
+test_compare_entries_matches_sorting(void)
+{
+	int i;
+
+	lwin.sort[0] = SK_BY_NAME;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+	lwin.dir_entry[1].type = DIRECTORY;
+
+	sort_view(&lwin);
+
+	assert_string_equal("_", lwin.dir_entry[0].name);
+	for(i = 1; i < lwin.list_rows; ++i)
+	{
+		assert_true(sort_compare_entries(&lwin, &lwin.dir_entry[i - 1],
+				&lwin.dir_entry[i]) < 0);
+		assert_true(sort_compare_entries(&lwin, &lwin.dir_entry[i],
+				&lwin.dir_entry[i - 1]) > 0);
+	}
+}
+
+static void
+test_sort_entries_sorts_only_range(void)
+{
+	lwin.sort[0] = -SK_BY_NAME;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+
+	sort_entries(&lwin, &lwin.dir_entry[1], lwin.list_rows - 1);
+
+	assert_string_equal("a", lwin.dir_entry[0].name);
+	assert_string_equal("_", lwin.dir_entry[1].name);
+	assert_string_equal("A", lwin.dir_entry[2].name);
+}
+
 /* Windows is really bad at handling links. */
 #ifndef _WIN32
 
@@ -67,6 +101,7 @@ test_symlink_to_dir(void)
 
 	replace_string(&lwin.dir_entry[2].name, "self");
 	lwin.dir_entry[2].type = LINK;
+	lwin.dir_entry[2].link_type = SLT_DIR;
 
 	cfg.slow_fs_list = strdup("");
 
@@ -277,6 +312,8 @@ sort_tests(void)
 	fixture_teardown(teardown);
 
 	run_test(test_special_chars_ignore_case_sort);
+	run_test(test_compare_entries_matches_sorting);
+	run_test(test_sort_entries_sorts_only_range);
 
 #ifndef _WIN32
 	/* Windows is really bad at handling links. */
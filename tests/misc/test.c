@@ -51,6 +51,15 @@ void is_dir_tests(void);
 void builtin_functions_tests(void);
 void get_ext_tests(void);
 void commands_tests(void);
+void mount_points_tests(void);
+void trie_tests(void);
+void trash_tests(void);
+void registers_tests(void);
+void local_filter_tests(void);
+void desktop_tests(void);
+void file_magic_tests(void);
+void text_index_tests(void);
+void dir_reload_tests(void);
 
 void
 all_tests(void)
@@ -106,6 +115,15 @@ all_tests(void)
 	builtin_functions_tests();
 	get_ext_tests();
 	commands_tests();
+	mount_points_tests();
+	trie_tests();
+	trash_tests();
+	registers_tests();
+	local_filter_tests();
+	desktop_tests();
+	file_magic_tests();
+	text_index_tests();
+	dir_reload_tests();
 }
 
 int
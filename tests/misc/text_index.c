@@ -0,0 +1,249 @@
+#include <unistd.h> /* truncate() */
+
+#include <stdio.h> /* FILE fclose() fopen() fwrite() remove() rewind() tmpfile() */
+#include <stdlib.h> /* free() malloc() */
+#include <string.h> /* memset() strlen() */
+
+#include "seatest.h"
+
+#include "../../src/utils/string_array.h"
+#include "../../src/utils/text_index.h"
+
+static text_index_t * make_text(const char text[], size_t len);
+static void check_lines(const char text[], size_t len);
+
+static void
+test_line_breaks_are_the_same_as_for_string_arrays(void)
+{
+	static const char text1[] = "a\nbc\r\nd\re\n\nf";
+	static const char text2[] = "a\r\r\n\nb\r\n";
+	static const char text3[] = "a\0\0b\n\0c\0";
+	static const char text4[] = "\0\0x\r\0\n";
+
+	check_lines(text1, sizeof(text1) - 1);
+	check_lines(text2, sizeof(text2) - 1);
+	check_lines(text3, sizeof(text3) - 1);
+	check_lines(text4, sizeof(text4) - 1);
+}
+
+static void
+test_empty_text_has_no_lines(void)
+{
+	text_index_t *const ti = make_text("", 0);
+	int count;
+
+	assert_true(text_index_is_empty(ti));
+	assert_int_equal(0, text_index_count(ti, &count));
+	assert_int_equal(0, count);
+
+	text_index_free(ti);
+}
+
+static void
+test_numbers_are_estimated_before_indexing(void)
+{
+	static const char text[] = "1\n2\n3\n4\n5\n";
+	text_index_t *const ti = make_text(text, sizeof(text) - 1);
+	size_t line;
+	int number, count;
+
+	assert_true(text_index_number(ti, 4, &number) != 0);
+
+	assert_int_equal(0, text_index_find(ti, 3, &line));
+	assert_int_equal(6, line);
+	assert_int_equal(0, text_index_number(ti, 4, &number));
+	assert_int_equal(2, number);
+
+	assert_int_equal(1, text_index_find(ti, 5, &line));
+	assert_int_equal(8, line);
+	assert_int_equal(0, text_index_count(ti, &count));
+	assert_int_equal(5, count);
+
+	text_index_free(ti);
+}
+
+static void
+test_background_indexing_completes(void)
+{
+	static const char text[] = "a\nb\nc";
+	text_index_t *const ti = make_text(text, sizeof(text) - 1);
+	int count;
+
+	assert_int_equal(0, text_index_start_bg(ti));
+	/* Freeing waits for the thread, so do the search to wait for the index. */
+	(void)text_index_find(ti, 10, &(size_t){0});
+	assert_int_equal(0, text_index_count(ti, &count));
+	assert_int_equal(3, count);
+
+	text_index_free(ti);
+}
+
+static void
+test_search_and_background_indexing_share_index(void)
+{
+	enum { NLINES = 200000 };
+	char *const text = malloc(NLINES*2);
+	text_index_t *ti;
+	size_t line;
+	int i, count;
+
+	assert_true(text != NULL);
+	for(i = 0; i < NLINES; ++i)
+	{
+		text[i*2] = 'x';
+		text[i*2 + 1] = '\n';
+	}
+	ti = make_text(text, NLINES*2);
+	free(text);
+
+	assert_int_equal(0, text_index_start_bg(ti));
+	assert_int_equal(0, text_index_find(ti, 150000, &line));
+	assert_int_equal(300000, line);
+	assert_int_equal(1, text_index_find(ti, NLINES, &line));
+	assert_int_equal((NLINES - 1)*2, line);
+	assert_int_equal(0, text_index_count(ti, &count));
+	assert_int_equal(NLINES, count);
+
+	text_index_free(ti);
+}
+
+static void
+test_percent_uses_line_count_when_indexed(void)
+{
+	static const char text[] = "long line\n1\n2\n3\n";
+	text_index_t *const ti = make_text(text, sizeof(text) - 1);
+	size_t line;
+
+	assert_int_equal(0, text_index_at_percent(ti, 0));
+	assert_int_equal(10, text_index_at_percent(ti, 70));
+
+	(void)text_index_find(ti, 10, &line);
+	assert_int_equal(12, text_index_at_percent(ti, 50));
+	assert_int_equal(14, text_index_at_percent(ti, 100));
+
+	text_index_free(ti);
+}
+
+static void
+test_truncated_file_reads_as_null_characters(void)
+{
+	enum { SIZE = 3*65536 };
+	static const char path[] = "test-data/sandbox/text_index";
+	char *const text = malloc(SIZE);
+	text_index_t *ti;
+	FILE *fp;
+	char *line;
+	size_t pos;
+	int count;
+
+	assert_true(text != NULL);
+	memset(text, 'x', SIZE);
+
+	fp = fopen(path, "wb");
+	assert_true(fp != NULL);
+	assert_int_equal(SIZE, fwrite(text, 1, SIZE, fp));
+	fclose(fp);
+	free(text);
+
+	ti = text_index_open(path);
+	assert_true(ti != NULL);
+	assert_int_equal(0, truncate(path, SIZE/3));
+
+	line = text_index_get_line(ti, 0);
+	assert_true(line != NULL);
+	assert_int_equal(SIZE/3, strlen(line));
+	free(line);
+
+	assert_int_equal(1, text_index_next(ti, 0, &pos));
+
+	(void)text_index_find(ti, 10, &pos);
+	assert_int_equal(0, text_index_count(ti, &count));
+	assert_int_equal(1, count);
+
+	text_index_free(ti);
+	assert_int_equal(0, remove(path));
+}
+
+/* Builds text index for the text.  Returns the index. */
+static text_index_t *
+make_text(const char text[], size_t len)
+{
+	text_index_t *ti;
+	FILE *const fp = tmpfile();
+	assert_true(fp != NULL);
+	assert_int_equal(len, fwrite(text, 1, len, fp));
+	rewind(fp);
+	ti = text_index_read(fp);
+	fclose(fp);
+	assert_true(ti != NULL);
+	return ti;
+}
+
+/* Compares lines of the text index with lines produced by read_file_lines(). */
+static void
+check_lines(const char text[], size_t len)
+{
+	text_index_t *const ti = make_text(text, len);
+	FILE *const fp = tmpfile();
+	char **lines;
+	int nlines = 0;
+	size_t starts[16];
+	size_t line = 0, pos;
+	int i, count;
+
+	assert_int_equal(len, fwrite(text, 1, len, fp));
+	rewind(fp);
+	lines = read_file_lines(fp, &nlines);
+	fclose(fp);
+
+	for(i = 0; i < nlines; ++i)
+	{
+		char *const copy = text_index_get_line(ti, line);
+		assert_string_equal(lines[i], copy);
+		free(copy);
+		starts[i] = line;
+		assert_int_equal(i == nlines - 1, text_index_next(ti, line, &line));
+	}
+	assert_int_equal(starts[nlines - 1], text_index_last(ti));
+
+	for(i = nlines - 1; i > 0; --i)
+	{
+		assert_int_equal(0, text_index_prev(ti, starts[i], &line));
+		assert_int_equal(starts[i - 1], line);
+	}
+	assert_int_equal(1, text_index_prev(ti, starts[0], &line));
+
+	for(pos = 0, i = 0; pos < len; ++pos)
+	{
+		if(i + 1 < nlines && pos >= starts[i + 1])
+		{
+			++i;
+		}
+		assert_int_equal(starts[i], text_index_line_at(ti, pos));
+	}
+
+	(void)text_index_find(ti, nlines, &line);
+	assert_int_equal(0, text_index_count(ti, &count));
+	assert_int_equal(nlines, count);
+
+	free_string_array(lines, nlines);
+	text_index_free(ti);
+}
+
+void
+text_index_tests(void)
+{
+	test_fixture_start();
+
+	run_test(test_line_breaks_are_the_same_as_for_string_arrays);
+	run_test(test_empty_text_has_no_lines);
+	run_test(test_numbers_are_estimated_before_indexing);
+	run_test(test_background_indexing_completes);
+	run_test(test_search_and_background_indexing_share_index);
+	run_test(test_percent_uses_line_count_when_indexed);
+	run_test(test_truncated_file_reads_as_null_characters);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab : */
@@ -0,0 +1,178 @@
+#include <stdio.h> /* FILE fclose() fopen() remove() snprintf() */
+#include <stdlib.h> /* free() */
+#include <string.h> /* strlen() */
+#include <unistd.h> /* getcwd() */
+
+#include "seatest.h"
+
+#include "../../src/utils/fs_limits.h"
+#include "../../src/trash.h"
+
+static void create_file(const char name[]);
+static void remove_file(const char name[]);
+
+static char sandbox[PATH_MAX];
+
+static void
+setup(void)
+{
+	char cwd[PATH_MAX];
+	assert_true(getcwd(cwd, sizeof(cwd)) != NULL);
+	snprintf(sandbox, sizeof(sandbox), "%s/test-data/sandbox", cwd);
+	assert_int_equal(0, set_trash_dir(sandbox));
+}
+
+static void
+teardown(void)
+{
+	trash_prune_dead_entries();
+}
+
+static void
+test_generated_names_skip_registered_ones(void)
+{
+	char path[PATH_MAX];
+	char *trash_name;
+
+	create_file("005_file");
+	snprintf(path, sizeof(path), "%s/005_file", sandbox);
+	assert_int_equal(0, add_to_trash("/some/file", path));
+
+	trash_name = gen_trash_name(sandbox, "file");
+	assert_string_equal("006_file", trash_name + strlen(sandbox) + 1);
+	free(trash_name);
+
+	remove_file("005_file");
+}
+
+static void
+test_removal_keeps_other_entries_reachable(void)
+{
+	char path[PATH_MAX];
+
+	create_file("000_a");
+	create_file("000_b");
+	create_file("000_c");
+	snprintf(path, sizeof(path), "%s/000_a", sandbox);
+	assert_int_equal(0, add_to_trash("/a", path));
+	snprintf(path, sizeof(path), "%s/000_b", sandbox);
+	assert_int_equal(0, add_to_trash("/b", path));
+	snprintf(path, sizeof(path), "%s/000_c", sandbox);
+	assert_int_equal(0, add_to_trash("/c", path));
+
+	snprintf(path, sizeof(path), "%s/000_a", sandbox);
+	assert_int_equal(0, remove_from_trash(path));
+	assert_false(is_in_trash(path));
+
+	snprintf(path, sizeof(path), "%s/000_c", sandbox);
+	assert_true(is_in_trash(path));
+	assert_int_equal(0, remove_from_trash(path));
+	assert_false(is_in_trash(path));
+
+	snprintf(path, sizeof(path), "%s/000_b", sandbox);
+	assert_true(is_in_trash(path));
+
+	remove_file("000_a");
+	remove_file("000_b");
+	remove_file("000_c");
+}
+
+static void
+test_removal_frees_generated_number(void)
+{
+	char *trash_name;
+
+	trash_name = gen_trash_name(sandbox, "fresh");
+	assert_string_equal("000_fresh", trash_name + strlen(sandbox) + 1);
+	create_file("000_fresh");
+	assert_int_equal(0, add_to_trash("/some/fresh", trash_name));
+	assert_int_equal(0, remove_from_trash(trash_name));
+	remove_file("000_fresh");
+	free(trash_name);
+
+	trash_name = gen_trash_name(sandbox, "fresh");
+	assert_string_equal("000_fresh", trash_name + strlen(sandbox) + 1);
+	free(trash_name);
+}
+
+static void
+test_many_removals_keep_list_consistent(void)
+{
+	char name[16];
+	char path[PATH_MAX];
+	int i;
+
+	for(i = 0; i < 10; ++i)
+	{
+		snprintf(name, sizeof(name), "00%d_f", i);
+		create_file(name);
+		snprintf(path, sizeof(path), "%s/%s", sandbox, name);
+		assert_int_equal(0, add_to_trash("/f", path));
+	}
+
+	for(i = 0; i < 10; i += 2)
+	{
+		snprintf(path, sizeof(path), "%s/00%d_f", sandbox, i);
+		assert_int_equal(0, remove_from_trash(path));
+	}
+
+	for(i = 0; i < 10; ++i)
+	{
+		snprintf(path, sizeof(path), "%s/00%d_f", sandbox, i);
+		assert_int_equal(i%2 != 0, is_in_trash(path));
+	}
+
+	trash_prune_dead_entries();
+	assert_int_equal(5, nentries);
+	for(i = 0; i < nentries; ++i)
+	{
+		assert_true(trash_list[i].trash_name != NULL);
+	}
+
+	for(i = 0; i < 10; ++i)
+	{
+		snprintf(name, sizeof(name), "00%d_f", i);
+		remove_file(name);
+	}
+}
+
+static void
+create_file(const char name[])
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", sandbox, name);
+	f = fopen(path, "w");
+	assert_true(f != NULL);
+	if(f != NULL)
+	{
+		fclose(f);
+	}
+}
+
+static void
+remove_file(const char name[])
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", sandbox, name);
+	assert_int_equal(0, remove(path));
+}
+
+void
+trash_tests(void)
+{
+	test_fixture_start();
+
+	fixture_setup(setup);
+	fixture_teardown(teardown);
+
+	run_test(test_generated_names_skip_registered_ones);
+	run_test(test_removal_keeps_other_entries_reachable);
+	run_test(test_removal_frees_generated_number);
+	run_test(test_many_removals_keep_list_consistent);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab : */
@@ -0,0 +1,103 @@
+#include <stddef.h> /* NULL */
+
+#include "seatest.h"
+
+#include "../../src/utils/trie.h"
+
+static trie_t trie;
+
+static void
+setup(void)
+{
+	trie = trie_create();
+	assert_true(trie != NULL_TRIE);
+}
+
+static void
+teardown(void)
+{
+	trie_free(trie);
+}
+
+static void
+test_missing_string_is_not_found(void)
+{
+	void *data;
+	assert_false(trie_get(trie, "abc", &data) == 0);
+}
+
+static void
+test_strings_are_found(void)
+{
+	int a, b, c;
+	void *data;
+
+	assert_int_equal(0, trie_set(trie, "/usr/bin", &a));
+	assert_int_equal(0, trie_set(trie, "/usr", &b));
+	assert_int_equal(0, trie_set(trie, "/usr/lib", &c));
+
+	assert_int_equal(0, trie_get(trie, "/usr/bin", &data));
+	assert_true(data == &a);
+	assert_int_equal(0, trie_get(trie, "/usr", &data));
+	assert_true(data == &b);
+	assert_int_equal(0, trie_get(trie, "/usr/lib", &data));
+	assert_true(data == &c);
+}
+
+static void
+test_prefixes_are_not_found(void)
+{
+	int a;
+	void *data;
+
+	assert_int_equal(0, trie_set(trie, "/usr/bin", &a));
+
+	assert_false(trie_get(trie, "/usr", &data) == 0);
+	assert_false(trie_get(trie, "/usr/bin/", &data) == 0);
+	assert_false(trie_get(trie, "", &data) == 0);
+}
+
+static void
+test_data_is_replaced(void)
+{
+	int a, b;
+	void *data;
+
+	assert_int_equal(0, trie_set(trie, "name", &a));
+	assert_int_equal(0, trie_set(trie, "name", &b));
+
+	assert_int_equal(0, trie_get(trie, "name", &data));
+	assert_true(data == &b);
+}
+
+static void
+test_empty_string_can_be_stored(void)
+{
+	int a;
+	void *data;
+
+	assert_int_equal(0, trie_set(trie, "", &a));
+
+	assert_int_equal(0, trie_get(trie, "", &data));
+	assert_true(data == &a);
+}
+
+void
+trie_tests(void)
+{
+	test_fixture_start();
+
+	fixture_setup(setup);
+	fixture_teardown(teardown);
+
+	run_test(test_missing_string_is_not_found);
+	run_test(test_strings_are_found);
+	run_test(test_prefixes_are_not_found);
+	run_test(test_data_is_replaced);
+	run_test(test_empty_string_can_be_stored);
+
+	test_fixture_end();
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */